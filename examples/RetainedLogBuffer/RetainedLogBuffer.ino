@@ -0,0 +1,36 @@
+#include "platform_logger.h"
+#include <Adafruit_SleepyDog.h>
+
+static WatchdogAVR watchdog;
+static int iterations = 0;
+
+void setup() {
+  Serial.begin(115200);
+  while(!Serial) delay(10);
+  // wait for Arduino Serial Monitor (native USB boards)
+
+  // Check the retained buffer before logging anything new
+  if(PlatformLogger::inst().begin())
+  {
+    printf("Log from before the reset:\n");
+    logflush();
+  }
+
+  logdebug("This line is added to the log buffer from setup\n");
+
+  // The loop stops feeding the watchdog after a few iterations
+  watchdog.enable(4000);
+}
+
+void loop() {
+  // put your main code here, to run repeatedly:
+  loginfo("Loop iteration %d\n", iterations);
+  iterations++;
+
+  if(iterations < 5)
+  {
+    watchdog.reset();
+  }
+
+  delay(1000);
+}
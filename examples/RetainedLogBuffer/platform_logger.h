@@ -0,0 +1,8 @@
+#ifndef PLATFORM_LOGGER_HPP_
+#define PLATFORM_LOGGER_HPP_
+
+#include <RetainedLogBufferLogger.h>
+
+using PlatformLogger = PlatformLogger_t<RetainedLogBufferLogger<512>>;
+
+#endif
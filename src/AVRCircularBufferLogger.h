@@ -20,7 +20,9 @@
  *
  * @tparam TBufferSize Defines the size of the circular log buffer.
  * Set to 0 to disable logging completely (for memory constrained systems).
- * @note Size requirement: power-of-2 for optimized queue logic.
+ * @note Use a power-of-2 size for optimized queue logic (index masking instead of division).
+ * @tparam TFullPolicy Behavior when the buffer is full. By default, the oldest data is
+ * overwritten unless auto-flush is enabled. See log_full_policy.
  *
  *	@code
  *	using PlatformLogger =
@@ -29,12 +31,19 @@
  *
  * @ingroup LoggingSubsystem
  */
-template<size_t TBufferSize = (1 * 1024)>
-class AVRCircularLogBufferLogger final : public LoggerBase
+template<size_t TBufferSize = (1 * 1024),
+		 log_full_policy TFullPolicy = log_full_policy::overwrite_oldest>
+class AVRCircularLogBufferLogger final
+	: public LoggerBaseT<AVRCircularLogBufferLogger<TBufferSize, TFullPolicy>>
 {
+	friend class LoggerBaseT<AVRCircularLogBufferLogger<TBufferSize, TFullPolicy>>;
+
   public:
+	/// Behavior when the log buffer is full
+	static constexpr log_full_policy full_policy = TFullPolicy;
+
 	/// Default constructor
-	AVRCircularLogBufferLogger() : LoggerBase() {}
+	AVRCircularLogBufferLogger() : LoggerBaseT<AVRCircularLogBufferLogger>() {}
 
 	/** Initialize the circular log buffer with options
 	 *
@@ -47,7 +56,7 @@ class AVRCircularLogBufferLogger final : public LoggerBase
 	 */
 	explicit AVRCircularLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
 										bool echo = LOG_ECHO_EN_DEFAULT) noexcept
-		: LoggerBase(enable, l, echo)
+		: LoggerBaseT<AVRCircularLogBufferLogger>(enable, l, echo)
 	{
 	}
 
@@ -60,42 +69,47 @@ class AVRCircularLogBufferLogger final : public LoggerBase
 
 		if(reg & (1 << WDRF))
 		{
-			info("Watchdog reset\n");
+			this->info("Watchdog reset\n");
 		}
 
 		if(reg & (1 << BORF))
 		{
-			info("Brown-out reset\n");
+			this->info("Brown-out reset\n");
 		}
 
 		if(reg & (1 << EXTRF))
 		{
-			info("External reset\n");
+			this->info("External reset\n");
 		}
 
 		if(reg & (1 << PORF))
 		{
-			info("Power-on reset\n");
+			this->info("Power-on reset\n");
 		}
 	}
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
 		return log_buffer_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		return log_buffer_.capacity();
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
 		log_buffer_.put(c);
 	}
 
-	void flush_() noexcept final
+	void log_write(const char* str, size_t len) noexcept
+	{
+		log_buffer_.put(str, len);
+	}
+
+	void flush_() noexcept
 	{
 		while(!log_buffer_.empty())
 		{
@@ -103,7 +117,7 @@ class AVRCircularLogBufferLogger final : public LoggerBase
 		}
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
 		log_buffer_.reset();
 	}
@@ -5,6 +5,8 @@
 #include "ArduinoLogger.h"
 #include "SdFat.h"
 #include "internal/circular_buffer.hpp"
+#include "internal/sd_logging.hpp"
+#include "internal/sd_rotation.hpp"
 #include <EEPROM.h>
 #include <avr/wdt.h>
 
@@ -14,6 +16,20 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * Each call to begin() starts a new file. With a size or age limit in the rotation policy
+ * (see log_rotation_policy), a new file is also started while logging. The new file starts at
+ * a statement boundary. The logging call only marks the boundary: the file is switched by the
+ * next flush() or sync() call, so call one of them regularly (e.g., from loop()). If the buffer
+ * fills first, the boundary is dropped and a new one is marked later.
+ *
+ * The file counter is 16 bits wide, stored at EEPROM addresses 4094 (high byte) and 4095
+ * (low byte). Files are numbered 1..9999.
+ *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery). Once the card can be
+ * written again, logging continues in a new file, starting with the held data. If the card
+ * needs to be initialized again (e.g., after it was removed), call `sd.begin()`.
+ *
  *	@code
  *	using PlatformLogger =
  *		PlatformLogger_t<AVRSDRotationalLogger>;
@@ -21,106 +37,214 @@
  *
  * @ingroup LoggingSubsystem
  */
-class AVRSDRotationalLogger final : public LoggerBase
+class AVRSDRotationalLogger final
+	: public SDLoggerBaseT<AVRSDRotationalLogger, CircularBuffer<char, 512>>
 {
+	friend class LoggerBaseT<AVRSDRotationalLogger>;
+	friend class SDLoggerBaseT<AVRSDRotationalLogger, CircularBuffer<char, 512>>;
+	using BaseClass = SDLoggerBaseT<AVRSDRotationalLogger, CircularBuffer<char, 512>>;
+
   private:
-	static constexpr size_t BUFFER_SIZE = 512;
 	static constexpr size_t FILENAME_SIZE = 32;
 	static constexpr unsigned EEPROM_LOG_STORAGE_ADDR = 4095;
 
   public:
 	/// Default constructor
-	AVRSDRotationalLogger() : LoggerBase() {}
+	AVRSDRotationalLogger() : BaseClass() {}
 
 	/// Default destructor
 	~AVRSDRotationalLogger() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
 		return file_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		// size in blocks * bytes per block (512 Bytes = 2^9)
 		return fs_ ? fs_->card()->sectorCount() << 9 : 0;
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
 		print("[%u ms] ", millis());
 	}
 
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
 		fs_ = &sd_inst;
+		preallocate_size_ = preallocate;
+		rotate_pending_ = false;
 
-		set_filename();
-
-		if(!file_.open(filename_, O_WRITE | O_CREAT))
+		if(open_file())
 		{
-			errorHalt("Failed to open file");
+			recovery_.recovered();
+		}
+		else
+		{
+			// Logging continues in RAM until a file can be opened
+			card_error("Failed to open file");
 		}
-
-		// Clear current file contents
-		file_.truncate(0);
 
 		log_reset_reason();
 
 		// Manually flush, since the file is open
+		this->sync();
+	}
+
+	/// Set when a new log file is started, and how many files are kept. See log_rotation_policy.
+	void rotation_policy(const log_rotation_policy& policy) noexcept
+	{
+		rotation_.policy(policy);
+	}
+
+	/// Get the current rotation policy
+	const log_rotation_policy& rotation_policy() const noexcept
+	{
+		return rotation_.policy();
+	}
+
+	/// Write the log buffer to the current file, then continue logging in a new file
+	void rotate()
+	{
+		rotate_pending_ = true;
+		rotate_offset_ = log_buffer_.size();
 		flush();
 
-		file_.close();
+		if(rotate_pending_)
+		{
+			rotate_file();
+		}
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
+		rotate_pending_ = false;
+		flush();
+
+		if(recovery_.available())
+		{
+			write_buffer(log_buffer_.size());
+		}
+
+		if(!close_file())
+		{
+			card_error("Failed to truncate log file");
+		}
+	}
+
+	/// See SDLoggerBaseT::log(). Marks a rotation once the statement is buffered.
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		// Statements logged by flush() (e.g., the overrun report) are nested in another call
+		bool was_logging = logging_;
+		logging_ = true;
+
+		BaseClass::log(l, fmt, args...);
+
+		mark_rotation();
+		logging_ = was_logging;
+	}
+
+	/// See LoggerBaseT::begin_statement()
+	void begin_statement(log_level_e l) noexcept
+	{
+		logging_ = true;
+		BaseClass::begin_statement(l);
+	}
+
+	/// See SDLoggerBaseT::end_statement(). Marks a rotation once the statement is buffered.
+	void end_statement(log_level_e l) noexcept
+	{
+		BaseClass::end_statement(l);
+		mark_rotation();
+		logging_ = false;
+	}
+
+	/// See LoggerBaseT::flush(). Switches to a new log file if a rotation is pending.
+	void flush() noexcept
+	{
+		BaseClass::flush();
+
+		if(rotate_if_pending())
+		{
+			// Write the data which belongs to the new file
+			BaseClass::flush();
+		}
 	}
 
 	// Resets the log file counter back to 1
 	void resetFileCounter()
 	{
-		EEPROM.write(EEPROM_LOG_STORAGE_ADDR, 1);
+		log_write_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR, 1);
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
 		log_buffer_.put(c);
 	}
 
-	void flush_() noexcept final
+	void log_write(const char* str, size_t len) noexcept
+	{
+		log_buffer_.put(str, len);
+	}
+
+	void flush_() noexcept
 	{
 		writeBufferToSDFile();
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
 		log_buffer_.reset();
+		rotate_offset_ = 0;
 	}
 
-	size_t internal_size() const noexcept override
+	size_t internal_size() const noexcept
 	{
 		return log_buffer_.size();
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_capacity() const noexcept
 	{
 		return log_buffer_.capacity();
 	}
 
   private:
-	void errorHalt(const char* msg)
+	/** Called by recover()
+	 *
+	 * Logging continues in the next log file, since the end of the current file may be lost.
+	 */
+	bool reopen_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
-		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
-			{
-				printf("Try power cycling the SD card.\n");
-			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
-		}
-		while(true)
-		{
-		}
+		close_file();
+		return open_file();
+	}
+
+	/// Move the log buffer to the RAM ring. Overwritten data is reported as an overrun.
+	void hold_buffer() noexcept
+	{
+		// The held data is written to the next file, so a pending rotation is dropped
+		rotate_pending_ = false;
+		rotate_offset_ = 0;
+
+		BaseClass::hold_buffer();
 	}
 
 	/// Checks the AVR SoC's reset reason registers and logs them
@@ -152,72 +276,219 @@ class AVRSDRotationalLogger final : public LoggerBase
 
 	void set_filename()
 	{
-		uint8_t value = EEPROM.read(EEPROM_LOG_STORAGE_ADDR);
+		file_number_ = log_read_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR);
+		format_filename(filename_, file_number_);
+	}
 
-		// 0xFF indicates a byte that's been reset, or value 255. Either way, reset to 0.
-		if(value == 0xFF)
+	void format_filename(char* filename, uint16_t number)
+	{
+		snprintf(filename, FILENAME_SIZE, "log_%u.txt", static_cast<unsigned>(number));
+	}
+
+	/** Open the next log file and delete the oldest files, according to the rotation policy
+	 *
+	 * The file counter only advances once the file is open.
+	 *
+	 * @returns false if the file could not be opened.
+	 */
+	bool open_file()
+	{
+		set_filename();
+
+		if(!file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			value = 1;
+			return false;
 		}
 
-		snprintf(filename_, FILENAME_SIZE, "log_%d.txt", value);
+		log_write_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR,
+							   log_next_file_number(file_number_));
+
+		// Clear current file contents
+		file_.truncate(0);
+
+		// Reserve contiguous clusters, so appending does not need to search the FAT
+		preallocated_ = (preallocate_size_ > 0) && file_.preAllocate(preallocate_size_);
+
+		if(preallocate_size_ > 0 && !preallocated_)
+		{
+			warning("Failed to pre-allocate %lu bytes for the log file\n",
+					static_cast<unsigned long>(preallocate_size_));
+		}
+
+		rotation_.opened(millis());
+		remove_old_files();
+		return true;
+	}
+
+	/** Truncate a pre-allocated log file to the length of the log, and close it
+	 *
+	 * The file is not truncated while the card is unavailable.
+	 *
+	 * @returns false if the file could not be truncated.
+	 */
+	bool close_file()
+	{
+		bool truncated =
+			!preallocated_ || !recovery_.available() || file_.truncate(file_.curPosition());
+
+		file_.close();
+		preallocated_ = false;
 
-		EEPROM.write(EEPROM_LOG_STORAGE_ADDR, static_cast<uint8_t>(value + 1));
+		return truncated;
 	}
 
 	void writeBufferToSDFile()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(!recovery_.available() && !recover())
 		{
-			errorHalt("Failed to open file");
+			hold_buffer();
+			return;
 		}
 
-		int bytes_written = 0;
+		// Data held while the card was unavailable is written first
+		auto& fallback = recovery_.fallback();
 
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
+		if(!fallback.empty() &&
+		   !log_sd_retry([&]() { return log_write_buffer(file_, fallback, fallback.size()); },
+						 delay))
+		{
+			card_error("Failed to write to log file");
+			hold_buffer();
+			return;
+		}
 
-		/** Note on const_cast
-		 *
-		 * The circular buffer returns a const char* for the underlying storage,
-		 * but the AVR EEPROM library requires that a char* is passed to write().
-		 * We're not modifying the buffer, so I'm const casting here.
-		 */
+		size_t count = log_buffer_.size();
 
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		// An auto-flush cannot rotate, since that would stall the logging call. If the buffer
+		// only holds data for the next file, that data goes to the current file instead.
+		if(rotate_pending_ && rotate_offset_ == 0 && logging_)
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written =
-				file_.write(const_cast<char*>(&buffer[tail]), log_buffer_.capacity() - tail);
-			bytes_written += file_.write(const_cast<char*>(buffer), head);
+			rotate_pending_ = false;
 		}
-		else
+
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(preallocated_ && !rotate_pending_)
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(const_cast<char*>(&buffer[tail]), log_buffer_.size());
+			count -= count % log_sd_sector_size;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		write_buffer(count);
+
+		if(this->sync_.flushed(millis()))
 		{
-			errorHalt("Failed to write to log file");
+			this->sync_file();
 		}
+	}
 
-		log_buffer_.reset();
+	/** Write the oldest `count` bytes in the log buffer to the file
+	 *
+	 * While a rotation is pending, only the data which belongs to the current file is written.
+	 * A failed write is retried. If it still fails, the log buffer is held in RAM until the card
+	 * is available again.
+	 */
+	void write_buffer(size_t count)
+	{
+		if(rotate_pending_)
+		{
+			count = (count < rotate_offset_) ? count : rotate_offset_;
+			rotate_offset_ -= count;
+		}
 
-		file_.close();
+		if(!BaseClass::write_buffer(count))
+		{
+			card_error("Failed to write to log file");
+			hold_buffer();
+		}
+	}
+
+	/// Mark the end of the buffered data as the end of the current file, if it should rotate
+	void mark_rotation() noexcept
+	{
+		if(!rotate_pending_ && file_.isOpen() &&
+		   rotation_.due(file_.curPosition() + log_buffer_.size(), millis()))
+		{
+			rotate_pending_ = true;
+			rotate_offset_ = log_buffer_.size();
+		}
+	}
+
+	/** Switch to the next log file once the current file's data has been written
+	 *
+	 * @returns true if a new file was started.
+	 */
+	bool rotate_if_pending()
+	{
+		if(rotate_pending_ && rotate_offset_ == 0 && !logging_ && recovery_.available())
+		{
+			rotate_file();
+			return true;
+		}
+
+		return false;
+	}
+
+	/// Close the current log file and continue logging in the next one
+	void rotate_file()
+	{
+		rotate_pending_ = false;
+
+		if(!close_file())
+		{
+			card_error("Failed to truncate log file");
+			return;
+		}
+
+		if(!open_file())
+		{
+			card_error("Failed to open file");
+			return;
+		}
+
+		// Record the new file in the directory
+		this->sync_file();
+	}
+
+	/// Delete the log files older than the number kept by the rotation policy
+	void remove_old_files()
+	{
+		uint16_t max_files = rotation_.policy().max_files;
+
+		if(max_files == 0 || max_files >= log_file_number_max)
+		{
+			return;
+		}
+
+		// Older files are deleted until a missing number is found. This also removes files
+		// left behind when the policy keeps fewer files than before.
+		char filename[FILENAME_SIZE];
+		uint16_t number = log_previous_file_number(file_number_, max_files);
+
+		for(uint16_t i = max_files; i < log_file_number_max; i++)
+		{
+			format_filename(filename, number);
+
+			if(!fs_->exists(filename) || !fs_->remove(filename))
+			{
+				break;
+			}
+
+			number = log_previous_file_number(number, 1);
+		}
 	}
 
   private:
-	SdFs* fs_;
 	char filename_[FILENAME_SIZE];
-	FsFile file_;
 
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
+	uint32_t preallocate_size_ = 0;
+
+	log_rotation_tracker rotation_;
+	uint16_t file_number_ = 0;
+	/// Set while a statement is logged, so rotation waits for a flush outside of log()
+	bool logging_ = false;
+	bool rotate_pending_ = false;
+	/// The number of buffered bytes which belong to the current file
+	size_t rotate_offset_ = 0;
 };
 
 #endif // AVR_SD_FILE_LOGGER_H_
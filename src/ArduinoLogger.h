@@ -1,7 +1,10 @@
 #ifndef ARDUINO_LOGGER_H_
 #define ARDUINO_LOGGER_H_
 
+#include "internal/interrupt_log_queue.hpp"
 #include <LibPrintf.h>
+#include <stdint.h>
+#include <string.h>
 #if !defined(__AVR__)
 #include <utility>
 #endif
@@ -57,6 +60,60 @@
 #define LOG_ECHO_EN_DEFAULT false
 #endif
 
+#ifndef LOG_STAGING_BUFFER_SIZE
+/// Size of the stack buffer used to stage formatted output before it is committed
+/// to the log buffer in a single write. Longer statements are committed in chunks.
+#if defined(__AVR__)
+#define LOG_STAGING_BUFFER_SIZE 32
+#else
+#define LOG_STAGING_BUFFER_SIZE 128
+#endif
+#endif
+
+#ifndef LOG_INTERRUPT_BUFFER_SIZE
+/// Size of the queue which holds statements logged with log_interrupt() until they are moved
+/// into the log buffer by the main context. Must be a power of 2.
+/// Set to 0 to log directly to the log buffer from interrupts instead.
+#if defined(__AVR__)
+#define LOG_INTERRUPT_BUFFER_SIZE 64
+#else
+#define LOG_INTERRUPT_BUFFER_SIZE 256
+#endif
+#endif
+
+#ifndef LOG_INTERRUPT_MAX_RECORD_SIZE
+/// Maximum size of a single statement logged with log_interrupt(), in bytes.
+/// Statements are formatted on the interrupt's stack, and longer statements are truncated.
+#if defined(__AVR__)
+#define LOG_INTERRUPT_MAX_RECORD_SIZE 32
+#else
+#define LOG_INTERRUPT_MAX_RECORD_SIZE 96
+#endif
+#endif
+
+#ifndef LOG_ECHO_WRITE
+/// Console output for echoed log statements. It receives whole spans of formatted text, so it
+/// can be defined as a bulk write, e.g. `Serial.write(data, len)`.
+/// By default, each character is sent to _putchar(), which is also used by printf().
+#define LOG_ECHO_WRITE(data, len) log_echo_putchar(data, len)
+#endif
+
+#ifndef LOG_TIMESTAMP
+/// Timestamp source for strategies which record a timestamp with each log statement.
+/// Users can supply their own source with a compiler definition.
+#if defined(ARDUINO)
+#define LOG_TIMESTAMP() millis()
+#else
+#define LOG_TIMESTAMP() 0
+#endif
+#endif
+
+#ifndef LOG_TOKENIZE_MACROS
+/// If true, the logging macros compute a token for each format string at compile time and
+/// call log_tokenized(). Format strings passed to the macros must then be string literals.
+#define LOG_TOKENIZE_MACROS false
+#endif
+
 #ifndef LOG_LEVEL_NAMES
 /// Users can override these default names with a compiler definition
 #define LOG_LEVEL_NAMES                                         \
@@ -113,6 +170,32 @@ constexpr cstr past_last_slash(cstr str)
 #define FUNC() __FUNCTION__
 #define PRETTY_FUNC() __PRETTY_FUNCTION__
 
+#ifndef NO_PRAGMA_MARK
+#pragma mark - Format String Tokens -
+#endif
+
+/** Compute the token for a format string
+ *
+ * Tokens are the 32-bit FNV-1a hash of the format string bytes. The same hash is computed
+ * by tools/tokenized_log.py when generating the token dictionary.
+ *
+ * @param str The format string.
+ * @param hash The running hash value. Leave as the default.
+ * @returns The token associated with the format string.
+ */
+constexpr uint32_t log_token(cstr str, uint32_t hash = 2166136261u)
+{
+	return *str == '\0' ? hash
+						: log_token(str + 1, (hash ^ static_cast<uint8_t>(*str)) * 16777619u);
+}
+
+/// Compute the token for a format string literal at compile time
+#define LOG_TOKEN(fmt)                              \
+	({                                              \
+		constexpr uint32_t token__{log_token(fmt)}; \
+		token__;                                    \
+	})
+
 #ifndef NO_PRAGMA_MARK
 #pragma mark - Logging Class -
 #endif
@@ -134,6 +217,23 @@ class logNames
 	constexpr static const char* level_string_names[LOG_LEVEL_COUNT] = LOG_LEVEL_NAMES;
 };
 
+/** Log buffer full policies
+ *
+ * Selects what a strategy does when its log buffer is full. Strategies which support more
+ * than one policy take it as a template parameter, so the choice has no run-time cost.
+ */
+enum class log_full_policy : uint8_t
+{
+	/// Flush if auto-flush is enabled. Otherwise, the oldest data is overwritten.
+	overwrite_oldest,
+	/// Flush if auto-flush is enabled. Otherwise, the new data is dropped.
+	drop_newest,
+	/// Always flush, waiting for the flush to complete, even if auto-flush is disabled.
+	/// Statements logged with log_interrupt() are only added to the log buffer by the main
+	/// context, unless LOG_INTERRUPT_BUFFER_SIZE is 0.
+	flush_and_block,
+};
+
 constexpr log_level_e LOG_LEVEL_LIMIT() noexcept
 {
 	return static_cast<log_level_e>(LOG_LEVEL);
@@ -149,9 +249,187 @@ constexpr const char* LOG_LEVEL_TO_SHORT_C_STRING(log_level_e level)
 	return logNames::level_short_names[level];
 }
 
-class LoggerBase
+/** Log buffer overrun statistics
+ *
+ * Counts the data lost from a log buffer since the last flush() or clear() call, as well as
+ * the highest buffer occupancy observed in that time. These values are useful for sizing log
+ * buffers and tuning flush intervals.
+ */
+struct log_overrun_stats
+{
+	/// Number of times data was lost from the log buffer
+	uint32_t events = 0;
+	/// Number of bytes which were dropped or overwritten
+	uint32_t dropped_bytes = 0;
+	/// Number of whole log statements which were dropped.
+	/// Only strategies which store statements as records count these.
+	uint32_t dropped_records = 0;
+	/// Highest log buffer occupancy, in bytes (see LoggerBaseT::internal_size())
+	size_t high_water_mark = 0;
+};
+
+/** Staging area for formatted log output.
+ *
+ * fctprintf() produces output one character at a time. Rather than forwarding each character
+ * to the logging strategy, characters are collected in a small caller-supplied buffer and
+ * handed to the commit function as a single span. If the buffer fills before the statement
+ * is complete, the pending characters are committed and staging continues.
+ */
+class LogStagingBuffer
 {
   public:
+	/// Receives a span of staged characters. `ctx` is the pointer supplied at construction.
+	using commit_fn = void (*)(void* ctx, const char* data, size_t len);
+
+	/** Initialize the staging buffer
+	 *
+	 * @param buffer Storage for staged characters. Usually a stack array.
+	 * @param size The size of `buffer`, in bytes.
+	 * @param commit Function which receives each staged span.
+	 * @param ctx Context pointer passed to `commit`.
+	 */
+	LogStagingBuffer(char* buffer, size_t size, commit_fn commit, void* ctx) noexcept
+		: buffer_(buffer), size_(size), commit_(commit), ctx_(ctx)
+	{
+	}
+
+	/// Add a single character to the staging buffer
+	void putc(char c) noexcept
+	{
+		if(len_ == size_)
+		{
+			commit();
+		}
+
+		buffer_[len_++] = c;
+	}
+
+	/// Add a NUL-terminated string to the staging buffer
+	void puts(const char* str) noexcept
+	{
+		while(*str)
+		{
+			putc(*str++);
+		}
+	}
+
+	/// Hand the staged characters to the commit function and empty the staging buffer
+	void commit() noexcept
+	{
+		if(len_ > 0)
+		{
+			commit_(ctx_, buffer_, len_);
+			len_ = 0;
+		}
+	}
+
+	/** putc bounce function
+	 *
+	 * Registers with the fctprintf() API. The private parameter stores the staging buffer.
+	 *
+	 * @param c The character to stage.
+	 * @param stage_ptr Pointer to the LogStagingBuffer instance.
+	 */
+	static void putc_bounce(char c, void* stage_ptr)
+	{
+		reinterpret_cast<LogStagingBuffer*>(stage_ptr)->putc(c);
+	}
+
+  private:
+	char* buffer_;
+	size_t size_;
+	size_t len_ = 0;
+	commit_fn commit_;
+	void* ctx_;
+};
+
+/// Bounded output target for fctprintf(), used to format a statement into a stack record
+struct log_record_writer
+{
+	char* buffer;
+	size_t size;
+	size_t len;
+	/// Number of characters which did not fit in the record
+	size_t truncated;
+
+	log_record_writer(char* buf, size_t buf_size) noexcept
+		: buffer(buf), size(buf_size), len(0), truncated(0)
+	{
+	}
+
+	/// Format a level prefix and a log statement into the record
+	template<typename... Args>
+	void format(const char* prefix, const char* fmt, const Args&... args) noexcept
+	{
+		fctprintf(&log_record_writer::putc_bounce, this, "%s", prefix);
+		// cppcheck-suppress wrongPrintfScanfArgNum
+		fctprintf(&log_record_writer::putc_bounce, this, fmt, args...);
+	}
+
+	static void putc_bounce(char c, void* writer_ptr) noexcept
+	{
+		auto writer = reinterpret_cast<log_record_writer*>(writer_ptr);
+
+		if(writer->len < writer->size)
+		{
+			writer->buffer[writer->len++] = c;
+		}
+		else
+		{
+			writer->truncated++;
+		}
+	}
+};
+
+/// Default LOG_ECHO_WRITE() implementation
+inline void log_echo_putchar(const char* data, size_t len) noexcept
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		_putchar(data[i]);
+	}
+}
+
+/** Statically-dispatched logger front end
+ *
+ * LoggerBaseT implements the logging API (critical() ... debug(), the *_interrupt() variants,
+ * print(), flush(), and clear()) on top of a set of strategy hooks. The hooks are resolved
+ * at compile time using the Curiously Recurring Template Pattern, so the compiler can inline
+ * the strategy's storage logic into the logging call and no vtable is required.
+ *
+ * A strategy derives from LoggerBaseT, passing itself as the template parameter:
+ *
+ * @code
+ * template<size_t TBufferSize>
+ * class CircularLogBufferLogger final : public LoggerBaseT<CircularLogBufferLogger<TBufferSize>>
+ * {
+ *	friend class LoggerBaseT<CircularLogBufferLogger<TBufferSize>>;
+ *	...
+ * };
+ * @endcode
+ *
+ * Hooks are "overridden" by declaring a function with the same name and signature in the
+ * strategy. Strategies must supply log_putc(). All other hooks have a default implementation
+ * in this class. Hooks may be protected as long as LoggerBaseT is declared a friend.
+ *
+ * @tparam TDerived The logging strategy class which derives from LoggerBaseT.
+ * @tparam TInterruptQueueSize The size of the queue used by log_interrupt(), in bytes.
+ *	Strategies whose log buffer can be written from an interrupt directly set this to 0, so
+ *	they do not reserve RAM for a queue. They must then replace log_interrupt().
+ */
+template<class TDerived, size_t TInterruptQueueSize = LOG_INTERRUPT_BUFFER_SIZE>
+class LoggerBaseT
+{
+  public:
+	/// Behavior when the log buffer is full.
+	/// Strategies select a different policy by declaring a member with the same name.
+	static constexpr log_full_policy full_policy = log_full_policy::overwrite_oldest;
+
+	/// True if the strategy stores formatted text, and can take statements formatted by another
+	/// logger (see begin_statement()). Strategies which keep their own record format (e.g., the
+	/// format string and encoded arguments) declare a member with the same name set to false.
+	static constexpr bool accepts_statements = true;
+
 	/** Get the current log buffer size
 	 *
 	 * Derived classes must implement this function.
@@ -159,7 +437,7 @@ class LoggerBase
 	 * @returns The current size of the log buffer, in bytes.
 	 *	The base class returns SIZE_MAX to indicate a potentially invalid condition.
 	 */
-	virtual size_t size() const noexcept
+	size_t size() const noexcept
 	{
 		return SIZE_MAX;
 	}
@@ -171,7 +449,7 @@ class LoggerBase
 	 * @returns The total capacity of the log buffer, in bytes.
 	 *	The base class returns SIZE_MAX to indicate a potentially invalid condition.
 	 */
-	virtual size_t capacity() const noexcept
+	size_t capacity() const noexcept
 	{
 		return SIZE_MAX;
 	}
@@ -273,18 +551,30 @@ class LoggerBase
 	 *	since the last time flush() was called. If `true`, this indicates that data
 	 * 	has been lost from the log buffer.
 	 */
-	bool has_overrun()
+	bool has_overrun() const noexcept
 	{
-		return overrun_occurred_;
+		return overrun_stats_.events > 0;
+	}
+
+	/** Get the overrun statistics
+	 *
+	 * The statistics are reset by flush() and clear(), so read them before flushing.
+	 * When data has been lost, flush() also reports them in the log.
+	 *
+	 * @returns the overrun counters and high-water mark since the last flush() or clear().
+	 */
+	log_overrun_stats overrun_stats() const noexcept
+	{
+		return overrun_stats_;
 	}
 
 	template<typename... Args>
 	void critical(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log(log_level_e::critical, fmt, args...);
+		self().log(log_level_e::critical, fmt, args...);
 #else
-		log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+		self().log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -292,9 +582,9 @@ class LoggerBase
 	void critical_interrupt(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log_interrupt(log_level_e::critical, fmt, args...);
+		self().log_interrupt(log_level_e::critical, fmt, args...);
 #else
-		log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+		self().log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -302,9 +592,9 @@ class LoggerBase
 	void error(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log(log_level_e::error, fmt, args...);
+		self().log(log_level_e::error, fmt, args...);
 #else
-		log(log_level_e::error, fmt, std::forward<const Args>(args)...);
+		self().log(log_level_e::error, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -312,9 +602,9 @@ class LoggerBase
 	void error_interrupt(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log_interrupt(log_level_e::error, fmt, args...);
+		self().log_interrupt(log_level_e::error, fmt, args...);
 #else
-		log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
+		self().log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -322,9 +612,9 @@ class LoggerBase
 	void warning(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log(log_level_e::warning, fmt, args...);
+		self().log(log_level_e::warning, fmt, args...);
 #else
-		log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+		self().log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -332,9 +622,9 @@ class LoggerBase
 	void warning_interrupt(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log_interrupt(log_level_e::warning, fmt, args...);
+		self().log_interrupt(log_level_e::warning, fmt, args...);
 #else
-		log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+		self().log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -342,9 +632,9 @@ class LoggerBase
 	void info(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log(log_level_e::info, fmt, args...);
+		self().log(log_level_e::info, fmt, args...);
 #else
-		log(log_level_e::info, fmt, std::forward<const Args>(args)...);
+		self().log(log_level_e::info, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -352,9 +642,9 @@ class LoggerBase
 	void info_interrupt(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log_interrupt(log_level_e::info, fmt, args...);
+		self().log_interrupt(log_level_e::info, fmt, args...);
 #else
-		log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
+		self().log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -362,9 +652,9 @@ class LoggerBase
 	void debug(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log(log_level_e::debug, fmt, args...);
+		self().log(log_level_e::debug, fmt, args...);
 #else
-		log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+		self().log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
@@ -372,29 +662,65 @@ class LoggerBase
 	void debug_interrupt(const char* fmt, const Args&... args)
 	{
 #if defined(__AVR__)
-		log_interrupt(log_level_e::debug, fmt, args...);
+		self().log_interrupt(log_level_e::debug, fmt, args...);
 #else
-		log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+		self().log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 #endif
 	}
 
+	/** Add data to the log buffer using a precomputed format string token
+	 *
+	 * This is the entry point for the tokenized logging macros. Strategies which store
+	 * tokens instead of formatted text supply their own version of this function.
+	 * By default, the token is ignored and the statement is formatted with log().
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param token The token for `fmt`, as computed by LOG_TOKEN().
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_tokenized(log_level_e l, uint32_t token, const char* fmt, const Args&... args) noexcept
+	{
+		(void)token;
+		self().log(l, fmt, args...);
+	}
+
 	/// Prints directly to the log with no extra characters added to the message.
 	template<typename... Args>
 	void print(const Args&... args) noexcept
 	{
-		fctprintf(&LoggerBase::log_add_char_to_buffer_bounce, this, args...);
-
-		if(echo_)
+		if(stage_)
+		{
+			// We're inside of a log() call, so the output joins the current record
+			fctprintf(&LogStagingBuffer::putc_bounce, stage_, args...);
+		}
+		else
 		{
-			// cppcheck-suppress wrongPrintfScanfArgNum
-			printf(args...);
+			char buffer[LOG_STAGING_BUFFER_SIZE];
+			LogStagingBuffer stage(buffer, sizeof(buffer), &log_add_span_to_buffer_bounce, &self());
+			fctprintf(&LogStagingBuffer::putc_bounce, &stage, args...);
+			commit(stage);
 		}
 	}
 
 	/** Add data to the log buffer from an interrupt context
 	 *
-	 * This call will disable auto-echo and auto-flush behavior for the duration
-	 * of this function call.
+	 * The message is formatted on the caller's stack and added to a wait-free interrupt queue
+	 * with its level. No logger settings or log buffer state are modified, so this is safe to
+	 * call while the main context is inside log() or flush(). The main context moves queued
+	 * statements into the log buffer with log() at the start of the next log() or flush()
+	 * call, so the custom prefix and echo are applied at that time.
+	 *
+	 * Statements which do not fit in the queue (LOG_INTERRUPT_BUFFER_SIZE) are dropped and
+	 * reported as an overrun.
+	 *
+	 * If LOG_INTERRUPT_BUFFER_SIZE is 0, the statement is added directly to the log buffer
+	 * with auto-echo and auto-flush disabled for the duration of this function call.
+	 *
+	 * Strategies can replace this function, e.g. to queue their own record format with
+	 * queue_interrupt_record(), or to use a log buffer which is already safe to write from an
+	 * interrupt.
 	 *
 	 * @tparam Args Variadic template args. Will be deduced by the compiler. Enables support for
 	 *	a variadic function template.
@@ -407,24 +733,30 @@ class LoggerBase
 	{
 		if(enabled_ && l <= level_)
 		{
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+			// The first byte holds the level
+			char record[interrupt_record_size];
+			log_record_writer writer(record + 1, sizeof(record) - 1);
+			writer.format("", fmt, args...);
+			record[0] = static_cast<char>(l);
+			interrupt_queue_.push(record, 1 + writer.len);
+#else
 			bool flush_setting = auto_flush(false);
 			bool echo_setting = echo(false);
 
-			// Add our prefix
-			print("%s", LOG_LEVEL_TO_SHORT_C_STRING(l));
-
-			log_customprefix();
-
-			// Send the primary log statement
-			print(fmt, args...);
+			self().log(l, fmt, args...);
 
 			// Restore prior settings
 			auto_flush(flush_setting);
 			echo(echo_setting);
+#endif
 		}
 	}
 
 	/** Add data to the log buffer
+	 *
+	 * The level prefix, custom prefix, and message are staged on the stack and
+	 * committed to the log buffer together.
 	 *
 	 * @tparam Args Variadic template args. Will be deduced by the compiler. Enables support for
 	 *	a variadic function template.
@@ -437,45 +769,142 @@ class LoggerBase
 	{
 		if(enabled_ && l <= level_)
 		{
-			// Add our prefix
-			print("%s", LOG_LEVEL_TO_SHORT_C_STRING(l));
+			// Keep statements from interrupts in order with this one
+			drain_interrupt_queue();
 
-			log_customprefix();
+			char buffer[LOG_STAGING_BUFFER_SIZE];
+			LogStagingBuffer stage(buffer, sizeof(buffer), &log_add_span_to_buffer_bounce, &self());
+
+			// Route print() calls made while building this record into our stage.
+			// The prior value is kept so a nested log() call (e.g., from an interrupt) is safe.
+			LogStagingBuffer* prior_stage = stage_;
+			stage_ = &stage;
+
+			// Add our prefix
+			stage.puts(LOG_LEVEL_TO_SHORT_C_STRING(l));
+			self().log_customprefix();
 
 			// Send the primary log statement
 			print(fmt, args...);
+
+			stage_ = prior_stage;
+			commit(stage);
+		}
+	}
+
+	/** Start a statement which was formatted by another logger
+	 *
+	 * Loggers which format a statement once and hand it to several strategies (see
+	 * FanoutLogger) call begin_statement(), pass the formatted message to write_statement() in
+	 * spans, and finish with end_statement(). The statement is stored as if it had been logged
+	 * with log(): the level prefix and custom prefix are added, and the statement is kept whole.
+	 * Output from print() uses log_level_e::off, and is stored without prefixes.
+	 *
+	 * The caller checks enabled() and level() first. The strategy's echo is not applied.
+	 * Only strategies with accepts_statements set support these calls.
+	 *
+	 * @param l The log level associated with this statement.
+	 */
+	void begin_statement(log_level_e l) noexcept
+	{
+		drain_interrupt_queue();
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		// The statement is committed span by span, so the interrupt queue is left alone until
+		// end_statement()
+		committing_ = true;
+#endif
+
+		if(l != log_level_e::off)
+		{
+			const char* prefix = LOG_LEVEL_TO_SHORT_C_STRING(l);
+			self().log_add_span_to_buffer(prefix, strlen(prefix));
+			self().log_customprefix();
 		}
 	}
 
+	/** Add a span of a statement started with begin_statement()
+	 *
+	 * @param data The characters to add to the statement. Not NUL-terminated.
+	 * @param len The number of characters in `data`.
+	 */
+	void write_statement(const char* data, size_t len) noexcept
+	{
+		self().log_add_span_to_buffer(data, len);
+	}
+
+	/** Finish a statement started with begin_statement()
+	 *
+	 * @param l The log level which was passed to begin_statement().
+	 */
+	void end_statement(log_level_e l) noexcept
+	{
+		(void)l;
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		committing_ = false;
+#endif
+	}
+
 	/// Flush the buffered log contents to the target output stream
-	/// Wrapper for flush_ that resets the overrun_occurred_ flag
+	/// Wrapper for flush_ that reports and resets the overrun statistics
 	/// Can be overridden if desired
-	virtual void flush() noexcept
+	void flush() noexcept
 	{
-		if(internal_size() > 0)
+		drain_interrupt_queue();
+
+		// Strategies which collect overruns in flush_() may have one pending with an empty buffer
+		if(self().internal_size() > 0 || self().has_overrun())
+		{
+			self().flush_();
+		}
+
+		if(!has_overrun())
 		{
-			flush_();
-			if(overrun_occurred_)
+			overrun_stats_ = log_overrun_stats();
+			return;
+		}
+
+		// Only the reported statistics are cleared: data lost while the report is added and
+		// flushed is reported by the next flush()
+		log_overrun_stats stats = overrun_stats_;
+		overrun_stats_ = log_overrun_stats();
+
+		if(!self().log_overrun_report(stats))
+		{
+			overrun_stats_.events += stats.events;
+			overrun_stats_.dropped_bytes += stats.dropped_bytes;
+			overrun_stats_.dropped_records += stats.dropped_records;
+
+			if(stats.high_water_mark > overrun_stats_.high_water_mark)
 			{
-				critical("---Log buffer overrun detected---\n");
-				flush_();
+				overrun_stats_.high_water_mark = stats.high_water_mark;
 			}
-			overrun_occurred_ = false;
+		}
+
+		self().flush_();
+
+		// The peak is measured from the end of this flush(), unless data was lost since the report
+		if(!has_overrun())
+		{
+			overrun_stats_.high_water_mark = 0;
 		}
 	}
 
 	/// Clear the contents of the log buffer
-	/// Wrapper for clear_ that resets the overrun_occurred_ flag
+	/// Wrapper for clear_ that resets the overrun statistics
 	/// Can be overridden if desired
-	virtual void clear() noexcept
+	void clear() noexcept
 	{
-		overrun_occurred_ = false;
-		clear_();
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		interrupt_queue_.reset();
+#endif
+		overrun_stats_ = log_overrun_stats();
+		self().clear_();
 	}
 
   protected:
 	/// Default constructor
-	LoggerBase() = default;
+	LoggerBaseT() = default;
 
 	/** Initialize the logger with options
 	 *
@@ -486,14 +915,15 @@ class LoggerBase
 	 * @param echo If true, log statements will be logged and printed to the console with printf().
 	 * If false, log statements will only be added to the log buffer.
 	 */
-	explicit LoggerBase(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
-						bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+	explicit LoggerBaseT(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+						 bool echo = LOG_ECHO_EN_DEFAULT) noexcept
 		: enabled_(enable), level_(l), echo_(echo)
 	{
 	}
 
 	/// Default destructor
-	virtual ~LoggerBase() = default;
+	/// Strategies are not destroyed through a base class pointer, so this is not virtual.
+	~LoggerBaseT() = default;
 
 	/** Flush the buffered log contents to the target output stream
 	 *
@@ -505,7 +935,7 @@ class LoggerBase
 	 *
 	 * Derived classes must implement this function.
 	 */
-	virtual void flush_() noexcept {}
+	void flush_() noexcept {}
 
 	/** Clear the contents of the log buffer.
 	 *
@@ -513,7 +943,7 @@ class LoggerBase
 	 *
 	 * @post The log buffer will be empty.
 	 */
-	virtual void clear_() noexcept {}
+	void clear_() noexcept {}
 
 	/** Add a custom prefix to the log file
 	 *
@@ -526,60 +956,173 @@ class LoggerBase
 	 *
 	 * Derived classes must implement this function.
 	 */
-	virtual void log_customprefix() {}
+	void log_customprefix() {}
 
-	/** Log buffer putc function
+	/** Log buffer bulk write function
 	 *
-	 * This function adds a character to the underlying log buffer.
+	 * This function adds a span of characters to the underlying log buffer.
+	 * Formatted output is staged and delivered through this function, so strategies
+	 * should override it with a native bulk implementation.
 	 *
-	 * This function is used with the fctprintf() interface to output to the log buffer.
-	 * This enables the framework to reuse the same print formatting for both logging and printf().
+	 * The default implementation forwards each character to the strategy's log_putc().
 	 *
-	 * Derived classes must implement this function.
+	 * @param str The characters to insert into the log buffer. Not NUL-terminated.
+	 * @param len The number of characters in `str`.
+	 */
+	void log_write(const char* str, size_t len)
+	{
+		for(size_t i = 0; i < len; i++)
+		{
+			self().log_putc(str[i]);
+		}
+	}
+
+	/** Console echo function
 	 *
-	 * @param c The character to insert into the log buffer.
+	 * When echo is enabled, each formatted span which is added to the log buffer is also
+	 * passed to this function, so statements are only formatted once.
+	 *
+	 * The default implementation forwards the span to LOG_ECHO_WRITE().
+	 *
+	 * @param data The characters to print to the console. Not NUL-terminated.
+	 * @param len The number of characters in `data`.
 	 */
-	virtual void log_putc(char c) = 0;
+	void log_echo(const char* data, size_t len) noexcept
+	{
+		LOG_ECHO_WRITE(data, len);
+	}
+
+	/** Format output for the console only
+	 *
+	 * Used by strategies which do not store formatted output in their log buffer. The output
+	 * is staged on the stack and passed to log_echo() in spans.
+	 */
+	template<typename... Args>
+	void log_echo_print(const Args&... args) noexcept
+	{
+		char buffer[LOG_STAGING_BUFFER_SIZE];
+		LogStagingBuffer stage(buffer, sizeof(buffer), &log_echo_bounce, &self());
+		// cppcheck-suppress wrongPrintfScanfArgNum
+		fctprintf(&LogStagingBuffer::putc_bounce, &stage, args...);
+		stage.commit();
+	}
 
 	/** Helper function for logging to the buffer.
 	 *
-	 * If auto-flushing is enabled, we check whether the RAM buffer storage
-	 * is full and then call flush(). Otherwise, we forward the character to
-	 * the logging strategy's log_putc() implementation.
+	 * The span is written in chunks that fit into the internal storage.
+	 * If the RAM buffer storage is full and flush_when_full() is true, we call flush()
+	 * before writing the next chunk. Otherwise, we note the overrun and apply the
+	 * strategy's full_policy: the remaining characters are either forwarded to the
+	 * logging strategy's log_write() implementation (overwrite_oldest) or dropped
+	 * (drop_newest). The characters which do not fit are counted as dropped bytes.
 	 *
-	 * Deived classes may override this function if desired.
+	 * Derived classes may override this function if desired.
 	 *
-	 * @param c The character to insert into the log buffer.
+	 * @param data The characters to insert into the log buffer.
+	 * @param len The number of characters in `data`.
 	 */
-	virtual void log_add_char_to_buffer(char c)
+	void log_add_span_to_buffer(const char* data, size_t len)
 	{
-		if(internal_size() == internal_capacity())
+		while(len > 0)
 		{
-			if(auto_flush())
-			{
-				flush();
-			}
-			else
+			if(self().internal_size() >= self().internal_capacity())
 			{
-				overrun_occurred_ = true;
+				if(flush_when_full())
+				{
+					self().flush();
+				}
+				else
+				{
+					mark_overrun(len);
+
+					if(TDerived::full_policy == log_full_policy::drop_newest)
+					{
+						return;
+					}
+				}
 			}
+
+			size_t size = self().internal_size();
+			size_t capacity = self().internal_capacity();
+			size_t chunk = (size < capacity) ? capacity - size : len;
+			chunk = (chunk < len) ? chunk : len;
+
+			self().log_write(data, chunk);
+			data += chunk;
+			len -= chunk;
+			track_occupancy();
 		}
+	}
+
+	/** Check whether a full log buffer should be flushed to make room for new data
+	 *
+	 * @returns true if auto-flush is enabled or the strategy's full_policy is flush_and_block.
+	 */
+	bool flush_when_full() const noexcept
+	{
+		return auto_flush_ || TDerived::full_policy == log_full_policy::flush_and_block;
+	}
 
-		log_putc(c);
+	/** Record that data has been lost from the log buffer
+	 *
+	 * The base class tracks overruns for strategies which write through
+	 * log_add_span_to_buffer(). Strategies that manage their own storage call this
+	 * function when they drop or overwrite log data.
+	 *
+	 * @param bytes The number of bytes which were dropped or overwritten.
+	 * @param records The number of whole log statements which were dropped.
+	 * @param events The number of times data was lost. Strategies which collect
+	 *	overruns before reporting them may report several events at once.
+	 */
+	void mark_overrun(size_t bytes, size_t records = 0, size_t events = 1) noexcept
+	{
+		overrun_stats_.events += static_cast<uint32_t>(events);
+		overrun_stats_.dropped_bytes += static_cast<uint32_t>(bytes);
+		overrun_stats_.dropped_records += static_cast<uint32_t>(records);
 	}
 
-	/** putc bounce function
+	/** Update the high-water mark with the current internal_size()
 	 *
-	 * This is a bounce function which registers with the C printf API. We use the private parameter
-	 * to store the `this` pointer so we can get back to our logger's add_char_to_buffer function.
+	 * The base class tracks occupancy for strategies which write through
+	 * log_add_span_to_buffer(). Strategies that manage their own storage call this
+	 * function after adding data to the log buffer.
+	 */
+	void track_occupancy() noexcept
+	{
+		size_t size = self().internal_size();
+
+		if(size > overrun_stats_.high_water_mark)
+		{
+			overrun_stats_.high_water_mark = size;
+		}
+	}
+
+	/** Span commit bounce function
+	 *
+	 * This is a bounce function which is registered with a LogStagingBuffer. We use the private
+	 * parameter to store the `this` pointer so we can get back to our logger's
+	 * log_add_span_to_buffer() function.
 	 *
-	 * @param c The character to log.
-	 * @param this_ptr The this pointer of the logger instance. Used to invoke log_putc() on the
-	 * correct instance.
+	 * @param this_ptr The this pointer of the logger instance.
+	 * @param data The staged characters to log.
+	 * @param len The number of characters in `data`.
 	 */
-	static void log_add_char_to_buffer_bounce(char c, void* this_ptr)
+	static void log_add_span_to_buffer_bounce(void* this_ptr, const char* data, size_t len)
+	{
+		auto logger = static_cast<TDerived*>(this_ptr);
+		logger->log_add_span_to_buffer(data, len);
+
+		// The formatted output is also sent to the console, so it is only formatted once
+		if(logger->echo())
+		{
+			logger->log_echo(data, len);
+		}
+	}
+
+	/// Span commit bounce function for log_echo_print()
+	static void log_echo_bounce(void* this_ptr, const char* data, size_t len)
 	{
-		reinterpret_cast<LoggerBase*>(this_ptr)->log_add_char_to_buffer(c);
+		static_cast<TDerived*>(this_ptr)->log_echo(data, len);
 	}
 
 	/** Get the current size of the log buffer internal storage.
@@ -595,9 +1138,9 @@ class LoggerBase
 	 * @returns The current size of the internal staging log buffer, in bytes.
 	 *	By default, this returns size(). Override if necessary.
 	 */
-	virtual size_t internal_size() const noexcept
+	size_t internal_size() const noexcept
 	{
-		return size();
+		return self().size();
 	}
 
 	/** Get the capacity of the log buffer internal storage.
@@ -613,9 +1156,146 @@ class LoggerBase
 	 * @returns The current capacity of the internal staging log buffer, in bytes.
 	 *	By default, this returns capacity(). Override if necessary.
 	 */
-	virtual size_t internal_capacity() const noexcept
+	size_t internal_capacity() const noexcept
 	{
-		return capacity();
+		return self().capacity();
+	}
+
+	/** Move statements logged with log_interrupt() into the log buffer
+	 *
+	 * Called by log() and flush(). Strategies which replace log() or flush() call this from
+	 * their main-context paths, so interrupt statements stay in order with the statement being
+	 * logged. Must not be called from an interrupt context.
+	 *
+	 * Nothing is moved while a statement is being staged or committed (e.g., by an auto-flush
+	 * of a full buffer), so interrupt statements never land in the middle of another statement.
+	 * They are moved by the next log() or flush() call instead.
+	 */
+	void drain_interrupt_queue() noexcept
+	{
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		// log() calls this function, so nested calls are ignored
+		if(draining_interrupts_ || stage_ || committing_)
+		{
+			return;
+		}
+
+		draining_interrupts_ = true;
+
+		size_t bytes;
+		size_t records = interrupt_queue_.take_dropped(bytes);
+
+		if(records)
+		{
+			mark_overrun(bytes, records);
+		}
+
+		interrupt_queue_.drain(
+			[this](const char* data, size_t len) { self().log_interrupt_record(data, len); });
+
+		draining_interrupts_ = false;
+#endif
+	}
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+	/// The largest record which fits in the interrupt queue, in bytes
+	static constexpr size_t interrupt_record_size =
+		(LOG_INTERRUPT_MAX_RECORD_SIZE < InterruptLogQueue<TInterruptQueueSize>::max_payload)
+			? LOG_INTERRUPT_MAX_RECORD_SIZE
+			: InterruptLogQueue<TInterruptQueueSize>::max_payload;
+
+	/** Add a record to the interrupt queue from an interrupt context
+	 *
+	 * Used by strategies which replace log_interrupt() with their own record format. The
+	 * record is passed to log_interrupt_record() by the main context. Records are never
+	 * truncated: an empty record, or one larger than interrupt_record_size, is dropped and
+	 * reported as an overrun.
+	 *
+	 * @param data The record.
+	 * @param len The size of the record, in bytes.
+	 * @returns true if the record was queued.
+	 */
+	bool queue_interrupt_record(const void* data, size_t len) noexcept
+	{
+		if(len == 0 || len > interrupt_record_size)
+		{
+			interrupt_queue_.drop(len);
+			return false;
+		}
+
+		return interrupt_queue_.push(static_cast<const char*>(data), len);
+	}
+#endif
+
+	/** Add the overrun report to the log buffer
+	 *
+	 * Called by flush() when data was lost since the last report. The default implementation
+	 * logs the report with critical(). Strategies which can tell whether their own record was
+	 * stored replace this.
+	 *
+	 * @param stats The statistics to report.
+	 * @returns false if the report was dropped. The statistics are then kept for the next
+	 *	flush().
+	 */
+	bool log_overrun_report(const log_overrun_stats& stats) noexcept
+	{
+		uint32_t events = overrun_stats_.events;
+
+		critical(overrun_report_format(), static_cast<unsigned long>(stats.events),
+				 static_cast<unsigned long>(stats.dropped_bytes),
+				 static_cast<unsigned long>(stats.dropped_records),
+				 static_cast<unsigned long>(stats.high_water_mark));
+
+		// Other strategies make room for the report, so only a new statement can be dropped
+		return TDerived::full_policy != log_full_policy::drop_newest ||
+			   overrun_stats_.events == events;
+	}
+
+	/// Format string of the overrun report. Takes the statistics as unsigned long values.
+	static const char* overrun_report_format() noexcept
+	{
+		return "---Log buffer overrun detected: %lu events, %lu bytes, %lu records lost, "
+			   "%lu bytes peak---\n";
+	}
+
+	/** Add a record from the interrupt queue to the log buffer
+	 *
+	 * Called by drain_interrupt_queue() for each queued record. The default implementation
+	 * handles the records added by the default log_interrupt(): a level byte followed by the
+	 * formatted statement. Strategies which queue their own record format replace this.
+	 *
+	 * @param data The record.
+	 * @param len The size of the record, in bytes.
+	 */
+	void log_interrupt_record(const char* data, size_t len) noexcept
+	{
+		self().log(static_cast<log_level_e>(data[0]), "%.*s", static_cast<int>(len - 1), data + 1);
+	}
+
+  private:
+	/// Access the strategy which derives from this class
+	TDerived& self() noexcept
+	{
+		return *static_cast<TDerived*>(this);
+	}
+
+	/// Commit a staged statement to the log buffer. See drain_interrupt_queue().
+	void commit(LogStagingBuffer& stage) noexcept
+	{
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		bool prior_committing = committing_;
+		committing_ = true;
+		stage.commit();
+		committing_ = prior_committing;
+#else
+		stage.commit();
+#endif
+	}
+
+	/// Access the strategy which derives from this class
+	const TDerived& self() const noexcept
+	{
+		return *static_cast<const TDerived*>(this);
 	}
 
   private:
@@ -626,9 +1306,9 @@ class LoggerBase
 	/// is full. If disabled, the user is responsible for coordinating flush() calls.
 	bool auto_flush_ = LOG_AUTOFLUSH_DEFAULT;
 
-	/// Indicates whether an overrun has occurred between flush() calls. If this is `true`,
+	/// Data lost between flush() calls. If the event count is non-zero,
 	/// then you know data has been lost.
-	bool overrun_occurred_ = false;
+	log_overrun_stats overrun_stats_;
 
 	/// The current log level.
 	/// Levels greater than the current setting will be filtered out.
@@ -637,6 +1317,122 @@ class LoggerBase
 	/// Console echoing.
 	/// If true, log statements will be printed to the console through printf().
 	bool echo_ = LOG_ECHO_EN_DEFAULT;
+
+	/// Staging buffer for the log() call that is currently in progress, if any.
+	/// print() calls made while this is set are added to the same record.
+	LogStagingBuffer* stage_ = nullptr;
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+	/// Set while a staged statement is written to the log buffer
+	bool committing_ = false;
+
+	/// Statements from log_interrupt(), which are only moved into the log buffer by the
+	/// main context
+	InterruptLogQueue<TInterruptQueueSize> interrupt_queue_;
+
+	/// Set while drain_interrupt_queue() is running
+	bool draining_interrupts_ = false;
+#endif
+};
+
+/** Dynamically-dispatched logger base class
+ *
+ * LoggerBase exposes the strategy hooks as virtual functions. It is provided for strategies
+ * which need to be used through a common base class pointer, and for compatibility with
+ * custom strategies written against earlier versions of this library. The strategies
+ * provided by this library derive from LoggerBaseT directly.
+ */
+class LoggerBase : public LoggerBaseT<LoggerBase>
+{
+	friend class LoggerBaseT<LoggerBase>;
+
+  public:
+	/// See LoggerBaseT::size()
+	virtual size_t size() const noexcept
+	{
+		return LoggerBaseT::size();
+	}
+
+	/// See LoggerBaseT::capacity()
+	virtual size_t capacity() const noexcept
+	{
+		return LoggerBaseT::capacity();
+	}
+
+	/// See LoggerBaseT::flush()
+	virtual void flush() noexcept
+	{
+		LoggerBaseT::flush();
+	}
+
+	/// See LoggerBaseT::clear()
+	virtual void clear() noexcept
+	{
+		LoggerBaseT::clear();
+	}
+
+  protected:
+	/// Default constructor
+	LoggerBase() = default;
+
+	/// See LoggerBaseT::LoggerBaseT(bool, log_level_e, bool)
+	explicit LoggerBase(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+						bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: LoggerBaseT(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	virtual ~LoggerBase() = default;
+
+	/// See LoggerBaseT::flush_()
+	virtual void flush_() noexcept {}
+
+	/// See LoggerBaseT::clear_()
+	virtual void clear_() noexcept {}
+
+	/// See LoggerBaseT::log_customprefix()
+	virtual void log_customprefix() {}
+
+	/** Log buffer putc function
+	 *
+	 * This function adds a character to the underlying log buffer.
+	 *
+	 * Derived classes must implement this function.
+	 *
+	 * @param c The character to insert into the log buffer.
+	 */
+	virtual void log_putc(char c) = 0;
+
+	/// See LoggerBaseT::log_write()
+	virtual void log_write(const char* str, size_t len)
+	{
+		LoggerBaseT::log_write(str, len);
+	}
+
+	/// See LoggerBaseT::log_echo()
+	virtual void log_echo(const char* data, size_t len) noexcept
+	{
+		LoggerBaseT::log_echo(data, len);
+	}
+
+	/// See LoggerBaseT::log_add_span_to_buffer()
+	virtual void log_add_span_to_buffer(const char* data, size_t len)
+	{
+		LoggerBaseT::log_add_span_to_buffer(data, len);
+	}
+
+	/// See LoggerBaseT::internal_size()
+	virtual size_t internal_size() const noexcept
+	{
+		return size();
+	}
+
+	/// See LoggerBaseT::internal_capacity()
+	virtual size_t internal_capacity() const noexcept
+	{
+		return capacity();
+	}
 };
 
 /** Declare a static platform logger instance.
@@ -780,6 +1576,17 @@ class PlatformLogger_t
 #endif
 	}
 
+	template<typename... Args>
+	inline static void log_tokenized(log_level_e l, uint32_t token, const char* fmt,
+									 const Args&... args)
+	{
+#if defined(__AVR__)
+		inst().log_tokenized(l, token, fmt, args...);
+#else
+		inst().log_tokenized(l, token, fmt, std::forward<const Args>(args)...);
+#endif
+	}
+
 	inline static void flush()
 	{
 		inst().flush();
@@ -809,6 +1616,11 @@ class PlatformLogger_t
 	{
 		return inst().has_overrun();
 	}
+
+	inline static log_overrun_stats overrun_stats()
+	{
+		return inst().overrun_stats();
+	}
 };
 
 /** @name Logging Macros
@@ -824,40 +1636,65 @@ class PlatformLogger_t
 
 #if LOG_LEVEL >= LOG_LEVEL_CRITICAL
 #ifndef logcritical
+#if LOG_TOKENIZE_MACROS
+#define logcritical(fmt, ...) \
+	PlatformLogger::log_tokenized(log_level_e::critical, LOG_TOKEN(fmt), fmt, ##__VA_ARGS__)
+#else
 #define logcritical(...) PlatformLogger::critical(__VA_ARGS__)
 #endif
+#endif
 #else
 #define logcritical(...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_ERROR
 #ifndef logerror
+#if LOG_TOKENIZE_MACROS
+#define logerror(fmt, ...) \
+	PlatformLogger::log_tokenized(log_level_e::error, LOG_TOKEN(fmt), fmt, ##__VA_ARGS__)
+#else
 #define logerror(...) PlatformLogger::error(__VA_ARGS__)
 #endif
+#endif
 #else
 #define logerror(...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_WARNING
 #ifndef logwarning
+#if LOG_TOKENIZE_MACROS
+#define logwarning(fmt, ...) \
+	PlatformLogger::log_tokenized(log_level_e::warning, LOG_TOKEN(fmt), fmt, ##__VA_ARGS__)
+#else
 #define logwarning(...) PlatformLogger::warning(__VA_ARGS__)
 #endif
+#endif
 #else
 #define logwarning(...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_INFO
 #ifndef loginfo
+#if LOG_TOKENIZE_MACROS
+#define loginfo(fmt, ...) \
+	PlatformLogger::log_tokenized(log_level_e::info, LOG_TOKEN(fmt), fmt, ##__VA_ARGS__)
+#else
 #define loginfo(...) PlatformLogger::info(__VA_ARGS__)
 #endif
+#endif
 #else
 #define loginfo(...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_DEBUG
 #ifndef logdebug
+#if LOG_TOKENIZE_MACROS
+#define logdebug(fmt, ...) \
+	PlatformLogger::log_tokenized(log_level_e::debug, LOG_TOKEN(fmt), fmt, ##__VA_ARGS__)
+#else
 #define logdebug(...) PlatformLogger::debug(__VA_ARGS__)
 #endif
+#endif
 #else
 #define logdebug(...)
 #endif
@@ -0,0 +1,491 @@
+#ifndef ASYNC_FLUSH_LOGGER_H_
+#define ASYNC_FLUSH_LOGGER_H_
+
+#if defined(__AVR__)
+#error "AsyncFlushLogger requires <atomic>, which is not available for AVR"
+#endif
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_ASYNC_MAX_RECORD_SIZE
+/// Maximum size of a single formatted log statement, in bytes.
+/// Statements are formatted on the stack, and longer statements are truncated.
+#define LOG_ASYNC_MAX_RECORD_SIZE 256
+#endif
+
+#ifndef LOG_ASYNC_FLUSH_THREAD
+/// If true, AsyncFlushLogger can run its own flush worker with std::thread (see start()).
+/// Otherwise, the worker is supplied by the user (see set_wake_hook()).
+#if defined(ARDUINO)
+#define LOG_ASYNC_FLUSH_THREAD false
+#else
+#define LOG_ASYNC_FLUSH_THREAD true
+#endif
+#endif
+
+#ifndef LOG_ASYNC_FLUSH_INTERVAL_MS
+/// The flush worker started by start() also drains the buffer if it has been idle this long.
+#define LOG_ASYNC_FLUSH_INTERVAL_MS 100
+#endif
+
+#include "ArduinoLogger.h"
+#include "internal/concurrent_logging.hpp"
+#include "internal/mpsc_ring_buffer.hpp"
+
+#if LOG_ASYNC_FLUSH_THREAD
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/// Function which wakes a user-supplied AsyncFlushLogger worker, and its argument
+struct log_wake_hook
+{
+	/// Called from the logging context with `arg`
+	void (*wake)(void* arg);
+	void* arg;
+};
+
+/** Calls which move a statement to an AsyncFlushLogger backend, selected by the backend's
+ * accepts_statements setting
+ */
+template<bool TAcceptsStatements>
+struct async_backend_calls
+{
+	template<class TBackend>
+	static void put(TBackend& backend, log_level_e l, const char* data, size_t len) noexcept
+	{
+		if(backend.enabled() && l <= backend.level())
+		{
+			backend.begin_statement(l);
+			backend.write_statement(data, len);
+			backend.end_statement(l);
+		}
+	}
+};
+
+template<>
+struct async_backend_calls<false>
+{
+	template<class TBackend>
+	static void put(TBackend& backend, log_level_e l, const char* data, size_t len) noexcept
+	{
+		if(l == log_level_e::off)
+		{
+			backend.print("%.*s", static_cast<int>(len), data);
+		}
+		else
+		{
+			backend.log(l, "%.*s", static_cast<int>(len), data);
+		}
+	}
+};
+
+/** Log buffer which is flushed by a background worker
+ *
+ * Strategies which flush when their buffer is full do so in whichever context happens to fill
+ * the buffer. For SD-backed strategies, that means a random log statement can stall the
+ * caller for milliseconds.
+ *
+ * This strategy puts a lock-free buffer in front of another strategy (the backend). Log calls
+ * only format the statement and copy it into the buffer. When the buffer reaches the high
+ * watermark, a flush worker is woken. The worker moves statements into the backend until the
+ * buffer is at the low watermark, then flushes the backend.
+ *
+ * Each statement reaches the backend with its level, as if it had been logged there: the
+ * backend applies its level filter, and adds its own level prefix and custom prefix.
+ *
+ * The worker can be:
+ * - A std::thread started with start() (hosts, or RTOS targets with std::thread support).
+ *   The worker also drains the buffer every LOG_ASYNC_FLUSH_INTERVAL_MS.
+ * - A user task, woken by the function registered with set_wake_hook(). The task calls
+ *   drain(). The hook is called from the logging context, so it must be safe to call there
+ *   (e.g., give a semaphore or notify a task).
+ *
+ * Requirements:
+ * - Configure the backend with backend() before logging starts. The backend's auto-flush is
+ *   enabled, and its echo is disabled.
+ * - Only one thread at a time may call drain(), flush(), or clear(). When start() is used,
+ *   these calls are serialized with the worker.
+ * - When the buffer is full, new statements are dropped and reported as an overrun.
+ *
+ * @tparam TBackend The logging strategy which receives statements from the worker.
+ * @tparam TBufferSize Defines the size of the buffer. Must be a power of 2.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<AsyncFlushLogger<TeensySDLogger, 8 * 1024>>;
+ *
+ *	PlatformLogger::inst().backend().begin(sd);
+ *	PlatformLogger::inst().start();
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<class TBackend, size_t TBufferSize = (4 * 1024)>
+class AsyncFlushLogger final
+	: public ConcurrentLoggerBaseT<AsyncFlushLogger<TBackend, TBufferSize>>
+{
+	friend class LoggerBaseT<AsyncFlushLogger<TBackend, TBufferSize>, 0>;
+	friend class ConcurrentLoggerBaseT<AsyncFlushLogger<TBackend, TBufferSize>>;
+	using BaseClass = ConcurrentLoggerBaseT<AsyncFlushLogger<TBackend, TBufferSize>>;
+
+	/// Records are also limited by the largest record the ring buffer can hold
+	static constexpr size_t max_record_size =
+		(LOG_ASYNC_MAX_RECORD_SIZE < MPSCRingBuffer<TBufferSize>::max_payload())
+			? LOG_ASYNC_MAX_RECORD_SIZE
+			: MPSCRingBuffer<TBufferSize>::max_payload();
+
+  public:
+	/// Producers never flush or evict old data, so new data is dropped when the buffer is full
+	static constexpr log_full_policy full_policy = log_full_policy::drop_newest;
+
+	/// Producers format their own records, so statements cannot be passed in spans
+	static constexpr bool accepts_statements = false;
+
+	/// Default constructor
+	AsyncFlushLogger() : BaseClass()
+	{
+		init_backend();
+	}
+
+	/** Initialize the log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit AsyncFlushLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+							  bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+		init_backend();
+	}
+
+	/// Stops the flush worker, if it is running
+	~AsyncFlushLogger() noexcept
+	{
+#if LOG_ASYNC_FLUSH_THREAD
+		stop();
+#endif
+	}
+
+	/// The strategy which receives statements from the flush worker
+	TBackend& backend() noexcept
+	{
+		return backend_;
+	}
+
+	/// Bytes reserved in the buffer, including record headers and padding
+	size_t size() const noexcept
+	{
+		return log_buffer_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return log_buffer_.capacity();
+	}
+
+	/** Set the buffer levels which control the flush worker
+	 *
+	 * By default, the worker is woken when the buffer is 3/4 full, and drains it to 1/4.
+	 * Safe to call while other threads are logging.
+	 *
+	 * @param high Wake the worker when size() reaches this value.
+	 * @param low The worker stops moving statements to the backend at this value.
+	 */
+	void set_watermarks(size_t high, size_t low) noexcept
+	{
+		high_watermark_.store(high, std::memory_order_relaxed);
+		low_watermark_.store((low < high) ? low : high, std::memory_order_relaxed);
+	}
+
+	/** Register the function which wakes a user-supplied flush worker
+	 *
+	 * The function is called from the logging context when the buffer reaches the high
+	 * watermark. It is not called again until the worker has called drain().
+	 *
+	 * Safe to call while other threads are logging. The function and its argument are
+	 * published together, so a producer never calls a function with another hook's argument.
+	 *
+	 * @param hook The function and its argument, or nullptr to remove the hook. A producer may
+	 *	still be calling a hook after it is replaced, so `hook` must not be changed or destroyed
+	 *	while the logger is in use (e.g., give it static storage).
+	 */
+	void set_wake_hook(const log_wake_hook* hook) noexcept
+	{
+		wake_hook_.store(hook, std::memory_order_release);
+	}
+
+	/** Move statements into the backend until the buffer is at the low watermark, then flush
+	 * the backend. Called by the flush worker.
+	 */
+	void drain() noexcept
+	{
+#if LOG_ASYNC_FLUSH_THREAD
+		std::lock_guard<std::mutex> lock(consumer_mutex_);
+#endif
+		drain_to(low_watermark_.load(std::memory_order_relaxed));
+	}
+
+#if LOG_ASYNC_FLUSH_THREAD
+	/// Start a std::thread flush worker. Has no effect if a hook is registered.
+	void start()
+	{
+		if(wake_hook_.load(std::memory_order_acquire) || worker_.joinable())
+		{
+			return;
+		}
+
+		stop_ = false;
+		worker_ = std::thread(&AsyncFlushLogger::run_worker, this);
+		set_wake_hook(&worker_hook_);
+	}
+
+	/// Stop the std::thread flush worker, then flush the remaining statements
+	void stop()
+	{
+		if(!worker_.joinable())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex_);
+			stop_ = true;
+		}
+
+		wake_cv_.notify_one();
+		worker_.join();
+		set_wake_hook(nullptr);
+		flush();
+	}
+#endif
+
+	/** Add a statement to the log buffer. Safe to call from multiple threads.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::statement, fmt, args...);
+		}
+	}
+
+	/** Add a statement to the log buffer from an interrupt context
+	 *
+	 * The log buffer can already be written from an interrupt, so the statement is added
+	 * directly instead of through the interrupt queue, and stays in order with the other
+	 * statements. The statement is not echoed, and the worker is not woken: the next
+	 * statement, or the worker's interval, moves it to the backend.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_interrupt(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::interrupt, fmt, args...);
+		}
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	/// Safe to call from multiple threads.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		add_record(log_level_e::off, log_record_origin::statement, fmt, args...);
+	}
+
+	/// Flush all buffered statements through the backend
+	void flush() noexcept
+	{
+#if LOG_ASYNC_FLUSH_THREAD
+		std::lock_guard<std::mutex> lock(consumer_mutex_);
+#endif
+		BaseClass::flush();
+	}
+
+	/// Clear the buffer and the backend
+	void clear() noexcept
+	{
+#if LOG_ASYNC_FLUSH_THREAD
+		std::lock_guard<std::mutex> lock(consumer_mutex_);
+#endif
+		BaseClass::clear();
+	}
+
+  protected:
+	void flush_() noexcept
+	{
+		this->collect_overruns();
+		drain_to(0);
+	}
+
+	void clear_() noexcept
+	{
+		log_buffer_.reset();
+		this->pending_overruns_.reset();
+		backend_.clear();
+		wake_pending_.store(false, std::memory_order_relaxed);
+	}
+
+  private:
+	void init_backend() noexcept
+	{
+		backend_.auto_flush(true);
+		backend_.echo(false);
+	}
+
+	/** Add a record, which is the statement's level followed by the statement
+	 *
+	 * @returns false if the record was dropped
+	 */
+	template<typename... Args>
+	bool add_record(log_level_e l, log_record_origin origin, const char* fmt,
+					const Args&... args) noexcept
+	{
+		const char* prefix = this->record_prefix(l);
+		char record[max_record_size];
+		log_record_writer writer(record + 1, sizeof(record) - 1);
+		writer.format(prefix, fmt, args...);
+
+		// The statement is only formatted once, even when it is echoed
+		if(origin != log_record_origin::interrupt && this->echo())
+		{
+			this->log_echo(writer.buffer, writer.len);
+		}
+
+		// The backend adds its own prefix, so the level replaces it in the record
+		size_t prefix_len = strlen(prefix);
+		prefix_len = (prefix_len < writer.len) ? prefix_len : writer.len;
+		char* stored_record = writer.buffer + prefix_len - 1;
+		stored_record[0] = static_cast<char>(l);
+
+		bool stored = log_buffer_.put(stored_record, writer.len - prefix_len + 1);
+
+		if(!stored)
+		{
+			this->note_dropped(origin, writer);
+		}
+		else if(writer.truncated)
+		{
+			this->pending_overruns_.note(writer.truncated, 0);
+		}
+
+		if(origin == log_record_origin::statement &&
+		   log_buffer_.size() >= high_watermark_.load(std::memory_order_relaxed))
+		{
+			wake();
+		}
+
+		return stored;
+	}
+
+	/// Wake the worker once per high watermark crossing
+	void wake() noexcept
+	{
+		const log_wake_hook* hook = wake_hook_.load(std::memory_order_acquire);
+
+		if(hook && !wake_pending_.exchange(true, std::memory_order_acq_rel))
+		{
+			hook->wake(hook->arg);
+		}
+	}
+
+	/// Must be called by the consumer
+	void drain_to(size_t level) noexcept
+	{
+		// Re-arm the wake hook before draining, so statements added during the drain can wake
+		// the worker again
+		wake_pending_.store(false, std::memory_order_release);
+
+		const char* data;
+		size_t len;
+
+		while(log_buffer_.size() > level && log_buffer_.front(data, len))
+		{
+			async_backend_calls<TBackend::accepts_statements>::put(
+				backend_, static_cast<log_level_e>(data[0]), data + 1, len - 1);
+			log_buffer_.pop_front();
+		}
+
+		backend_.flush();
+	}
+
+#if LOG_ASYNC_FLUSH_THREAD
+	static void notify_worker(void* arg) noexcept
+	{
+		reinterpret_cast<AsyncFlushLogger*>(arg)->wake_cv_.notify_one();
+	}
+
+	void run_worker() noexcept
+	{
+		std::unique_lock<std::mutex> lock(wake_mutex_);
+
+		while(!stop_)
+		{
+			// The timeout also covers a wake-up which arrives before the worker waits
+			wake_cv_.wait_for(lock, std::chrono::milliseconds(LOG_ASYNC_FLUSH_INTERVAL_MS));
+
+			if(stop_)
+			{
+				break;
+			}
+
+			lock.unlock();
+
+			// Only the producers' pending counters are read here. The base class statistics
+			// belong to the consumer, and are only accessed under consumer_mutex_.
+			if(wake_pending_.load(std::memory_order_acquire) &&
+			   !this->pending_overruns_.pending())
+			{
+				drain();
+			}
+			else
+			{
+				// Periodic flush, so statements don't sit in the buffer while it is quiet.
+				// flush() also reports overruns.
+				flush();
+			}
+
+			lock.lock();
+		}
+	}
+#endif
+
+  private:
+	MPSCRingBuffer<TBufferSize> log_buffer_;
+	TBackend backend_;
+	std::atomic<size_t> high_watermark_{(TBufferSize / 4) * 3};
+	std::atomic<size_t> low_watermark_{TBufferSize / 4};
+	std::atomic<const log_wake_hook*> wake_hook_{nullptr};
+	std::atomic<bool> wake_pending_{false};
+#if LOG_ASYNC_FLUSH_THREAD
+	const log_wake_hook worker_hook_{&AsyncFlushLogger::notify_worker, this};
+	std::thread worker_;
+	std::mutex consumer_mutex_;
+	std::mutex wake_mutex_;
+	std::condition_variable wake_cv_;
+	bool stop_ = false;
+#endif
+};
+
+#endif // ASYNC_FLUSH_LOGGER_H_
@@ -17,9 +17,17 @@
  * overwrite old data. This enables seemingly "infinite" memory with a fixed capacity, preferring
  * the newest data be kept.
  *
+ * Old data is overwritten byte by byte, so the oldest statement in the buffer may be partial.
+ * Use RecordBufferLogger if statements must be kept whole.
+ *
  * @tparam TBufferSize Defines the size of the circular log buffer.
  * Set to 0 to disable logging completely (for memory constrained systems).
- * @note Size requirement: power-of-2 for optimized queue logic.
+ * @note Use a power-of-2 size for optimized queue logic (index masking instead of division).
+ * @tparam TFullPolicy Behavior when the buffer is full. By default, the oldest data is
+ * overwritten unless auto-flush is enabled. See log_full_policy.
+ * @tparam TStorage The circular buffer type which holds the log. On Linux hosts, use
+ * MirroredRingBuffer (internal/mirrored_ring_buffer.hpp) so large buffers are written and
+ * flushed without splitting data at the end of the buffer.
  *
  *	@code
  *	using PlatformLogger =
@@ -28,12 +36,21 @@
  *
  * @ingroup LoggingSubsystem
  */
-template<size_t TBufferSize = (1 * 1024)>
-class CircularLogBufferLogger final : public LoggerBase
+template<size_t TBufferSize = (1 * 1024),
+		 log_full_policy TFullPolicy = log_full_policy::overwrite_oldest,
+		 template<class, size_t> class TStorage = CircularBuffer>
+class CircularLogBufferLogger final
+	: public LoggerBaseT<CircularLogBufferLogger<TBufferSize, TFullPolicy, TStorage>>
 {
+	friend class LoggerBaseT<CircularLogBufferLogger<TBufferSize, TFullPolicy, TStorage>>;
+	using storage_t = TStorage<char, TBufferSize>;
+
   public:
+	/// Behavior when the log buffer is full
+	static constexpr log_full_policy full_policy = TFullPolicy;
+
 	/// Default constructor
-	CircularLogBufferLogger() : LoggerBase() {}
+	CircularLogBufferLogger() : LoggerBaseT<CircularLogBufferLogger>() {}
 
 	/** Initialize the circular log buffer with options
 	 *
@@ -46,44 +63,57 @@ class CircularLogBufferLogger final : public LoggerBase
 	 */
 	explicit CircularLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
 									 bool echo = LOG_ECHO_EN_DEFAULT) noexcept
-		: LoggerBase(enable, l, echo)
+		: LoggerBaseT<CircularLogBufferLogger>(enable, l, echo)
 	{
 	}
 
 	/// Default destructor
 	~CircularLogBufferLogger() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
 		return log_buffer_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		return log_buffer_.capacity();
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
 		log_buffer_.put(c);
 	}
 
-	void flush_() noexcept final
+	void log_write(const char* str, size_t len) noexcept
+	{
+		log_buffer_.put(str, len);
+	}
+
+	void flush_() noexcept
 	{
-		while(!log_buffer_.empty())
+		typename storage_t::span spans[2];
+		size_t count = log_buffer_.peek_spans(spans[0], spans[1]);
+
+		for(const auto& region : spans)
 		{
-			_putchar(log_buffer_.get());
+			for(size_t i = 0; i < region.size; i++)
+			{
+				_putchar(region.data[i]);
+			}
 		}
+
+		log_buffer_.consume(count);
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
 		log_buffer_.reset();
 	}
 
   private:
-	CircularBuffer<char, TBufferSize> log_buffer_;
+	storage_t log_buffer_;
 };
 
 #endif // CIRCULAR_BUFFER_LOGGER_H_
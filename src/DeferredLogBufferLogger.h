@@ -0,0 +1,372 @@
+#ifndef DEFERRED_LOG_BUFFER_LOGGER_H_
+#define DEFERRED_LOG_BUFFER_LOGGER_H_
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_DEFERRED_MAX_RECORD_SIZE
+/// Maximum size of a single deferred record (header + encoded arguments), in bytes.
+/// String arguments are truncated to fit.
+#if defined(__AVR__)
+#define LOG_DEFERRED_MAX_RECORD_SIZE 64
+#else
+#define LOG_DEFERRED_MAX_RECORD_SIZE 256
+#endif
+#endif
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#endif
+#include "ArduinoLogger.h"
+#include "internal/circular_buffer.hpp"
+#include "internal/log_args.hpp"
+
+/** Deferred-formatting log buffer
+ *
+ * Log statements are not formatted when they are logged. Instead, the call site stores the
+ * format string pointer, the log level, a timestamp, and the binary argument values in a
+ * circular buffer. Formatting happens in flush(), where the records are rendered to the
+ * console with _putchar().
+ *
+ * This makes a log statement roughly the cost of copying its arguments, which is also
+ * useful for logging from interrupts. Binary arguments are usually much smaller than their
+ * formatted text, so more statements fit in the same buffer.
+ *
+ * Requirements:
+ * - Format strings must remain valid until the log is flushed (e.g., string literals).
+ * - String arguments are copied into the record, and are truncated to fit
+ *   LOG_DEFERRED_MAX_RECORD_SIZE.
+ * - Records are added whole. By default, when the buffer is full and auto-flush is disabled,
+ *   the newest record is dropped and an overrun is reported. With the overwrite_oldest policy,
+ *   whole records are evicted from the start of the buffer instead.
+ *
+ * Records are rendered as: `<level prefix>[<timestamp> ms] <message>`. The timestamp is
+ * supplied by LOG_TIMESTAMP().
+ *
+ * log_interrupt() encodes the record on the interrupt's stack and adds it to the interrupt
+ * queue, so interrupts never call printf(). The main context copies queued records into the
+ * log buffer at the start of the next log() or flush() call. Records from interrupts which
+ * are larger than LOG_INTERRUPT_MAX_RECORD_SIZE are dropped and reported as an overrun.
+ *
+ * @tparam TBufferSize Defines the size of the circular log buffer.
+ * @tparam TFullPolicy Behavior when the buffer is full. See log_full_policy.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<DeferredLogBufferLogger<1024>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (1 * 1024),
+		 log_full_policy TFullPolicy = log_full_policy::drop_newest>
+class DeferredLogBufferLogger final
+	: public LoggerBaseT<DeferredLogBufferLogger<TBufferSize, TFullPolicy>>
+{
+	friend class LoggerBaseT<DeferredLogBufferLogger<TBufferSize, TFullPolicy>>;
+
+  public:
+	/// Behavior when the log buffer is full
+	static constexpr log_full_policy full_policy = TFullPolicy;
+
+	/// Records hold the format string and arguments instead of formatted text
+	static constexpr bool accepts_statements = false;
+
+	/// Default constructor
+	DeferredLogBufferLogger() : LoggerBaseT<DeferredLogBufferLogger>() {}
+
+	/** Initialize the deferred log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit DeferredLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+									 bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: LoggerBaseT<DeferredLogBufferLogger>(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~DeferredLogBufferLogger() noexcept = default;
+
+	size_t size() const noexcept
+	{
+		return log_buffer_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return log_buffer_.capacity();
+	}
+
+	/** Add a deferred record to the log buffer
+	 *
+	 * @tparam Args Variadic template args. Will be deduced by the compiler. The types are
+	 *	used to encode the arguments and to select the renderer used at flush time.
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string. Must remain valid until the record is flushed.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			// Keep statements from interrupts in order with this one
+			this->drain_interrupt_queue();
+			add_record(l, fmt, args...);
+
+			if(this->echo())
+			{
+				const char* prefix = LOG_LEVEL_TO_SHORT_C_STRING(l);
+				this->log_echo(prefix, strlen(prefix));
+				this->log_echo_print(fmt, args...);
+			}
+		}
+	}
+
+	/** Add a deferred record from an interrupt context
+	 *
+	 * The record is encoded on the caller's stack and added to the interrupt queue. See
+	 * LoggerBaseT::log_interrupt().
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string. Must remain valid until the record is flushed.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_interrupt(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		if(this->enabled() && l <= this->level())
+		{
+			uint8_t record[interrupt_record_size];
+			size_t length = encode_record(record, sizeof(record), l, fmt, args...);
+			this->queue_interrupt_record(record, length);
+		}
+#else
+		LoggerBaseT<DeferredLogBufferLogger>::log_interrupt(l, fmt, args...);
+#endif
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	/// The format string must remain valid until the record is flushed.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		add_record(log_level_e::off, fmt, args...);
+
+		if(this->echo())
+		{
+			this->log_echo_print(fmt, args...);
+		}
+	}
+
+  protected:
+	void flush_() noexcept
+	{
+		uint8_t record[LOG_DEFERRED_MAX_RECORD_SIZE];
+
+		while(!log_buffer_.empty())
+		{
+			record_header header;
+			read(record, sizeof(header));
+			memcpy(&header, record, sizeof(header));
+			read(record, header.length - sizeof(header));
+			render(header, record);
+		}
+	}
+
+	void clear_() noexcept
+	{
+		log_buffer_.reset();
+	}
+
+	/// Copy a record queued by log_interrupt() into the log buffer
+	void log_interrupt_record(const char* data, size_t len) noexcept
+	{
+		const uint8_t* record = reinterpret_cast<const uint8_t*>(data);
+
+		if(!put_record(record, len))
+		{
+			return;
+		}
+
+		if(this->echo())
+		{
+			record_header header;
+			memcpy(&header, record, sizeof(header));
+
+			char buffer[LOG_STAGING_BUFFER_SIZE];
+			LogStagingBuffer stage(buffer, sizeof(buffer),
+								   &LoggerBaseT<DeferredLogBufferLogger>::log_echo_bounce, this);
+			stage.puts(LOG_LEVEL_TO_SHORT_C_STRING(static_cast<log_level_e>(header.level)));
+			header.render(&LogStagingBuffer::putc_bounce, &stage, header.fmt,
+						  record + sizeof(header));
+			stage.commit();
+		}
+	}
+
+  private:
+	/// Stored at the start of each record, followed by the encoded arguments
+	struct record_header
+	{
+		uint32_t timestamp;
+		log_args::render_fn render;
+		const char* fmt;
+		/// Total record length, including this header
+		uint16_t length;
+		uint8_t level;
+	};
+
+	static_assert(LOG_DEFERRED_MAX_RECORD_SIZE > sizeof(record_header),
+				  "LOG_DEFERRED_MAX_RECORD_SIZE must be larger than the record header");
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+	/// Records from log_interrupt() must also fit in the interrupt queue
+	static constexpr size_t interrupt_record_size =
+		(LOG_DEFERRED_MAX_RECORD_SIZE <
+		 LoggerBaseT<DeferredLogBufferLogger>::interrupt_record_size)
+			? LOG_DEFERRED_MAX_RECORD_SIZE
+			: LoggerBaseT<DeferredLogBufferLogger>::interrupt_record_size;
+#endif
+
+	template<typename... Args>
+	void add_record(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		uint8_t record[LOG_DEFERRED_MAX_RECORD_SIZE];
+		size_t length = encode_record(record, sizeof(record), l, fmt, args...);
+
+		if(length == 0)
+		{
+			// The arguments can never fit in a record
+			this->mark_overrun(0, 1);
+			return;
+		}
+
+		put_record(record, length);
+	}
+
+	/** Encode a record. Does not modify the logger, so it is safe to call from an interrupt.
+	 *
+	 * @returns the length of the record, or 0 if the arguments do not fit in `size` bytes.
+	 */
+	template<typename... Args>
+	static size_t encode_record(uint8_t* record, size_t size, log_level_e l, const char* fmt,
+								const Args&... args) noexcept
+	{
+		if(size <= sizeof(record_header))
+		{
+			return 0;
+		}
+
+		uint8_t* dst = &record[sizeof(record_header)];
+		size_t avail = size - sizeof(record_header);
+
+		if(!log_args::pack<Args...>::encode(dst, avail, args...))
+		{
+			return 0;
+		}
+
+		record_header header;
+		header.timestamp = static_cast<uint32_t>(LOG_TIMESTAMP());
+		header.render = &log_args::render_args<Args...>;
+		header.fmt = fmt;
+		header.length = static_cast<uint16_t>(dst - record);
+		header.level = static_cast<uint8_t>(l);
+		memcpy(record, &header, sizeof(header));
+
+		return header.length;
+	}
+
+	/// Add an encoded record to the log buffer. Returns false if the record was dropped.
+	bool put_record(const uint8_t* record, size_t length) noexcept
+	{
+		if(!make_room(length))
+		{
+			// Records are only added whole: we drop the newest record rather than
+			// overwriting part of an older one, which could not be decoded.
+			this->mark_overrun(length, 1);
+			return false;
+		}
+
+		log_buffer_.put(record, length);
+		this->track_occupancy();
+		return true;
+	}
+
+	/** Free space for a new record according to the full-buffer policy
+	 *
+	 * @param length The size of the new record.
+	 * @returns true if there is room for the new record.
+	 */
+	bool make_room(size_t length) noexcept
+	{
+		if(available() < length && this->flush_when_full())
+		{
+			this->flush();
+		}
+
+		if(full_policy == log_full_policy::overwrite_oldest)
+		{
+			while(available() < length && !log_buffer_.empty())
+			{
+				this->mark_overrun(drop_oldest(), 1);
+			}
+		}
+
+		return available() >= length;
+	}
+
+	/// Remove the oldest record. Returns the size of the record.
+	size_t drop_oldest() noexcept
+	{
+		record_header header;
+		uint8_t record[sizeof(header)];
+		read(record, sizeof(header));
+		memcpy(&header, record, sizeof(header));
+
+		log_buffer_.consume(header.length - sizeof(header));
+
+		return header.length;
+	}
+
+	void render(const record_header& header, const uint8_t* args) noexcept
+	{
+		if(header.level != log_level_e::off)
+		{
+			fctprintf(&putchar_bounce, nullptr, "%s[%lu ms] ",
+					  LOG_LEVEL_TO_SHORT_C_STRING(static_cast<log_level_e>(header.level)),
+					  static_cast<unsigned long>(header.timestamp));
+		}
+
+		header.render(&putchar_bounce, nullptr, header.fmt, args);
+	}
+
+	void read(uint8_t* dst, size_t count) noexcept
+	{
+		log_buffer_.get(dst, count);
+	}
+
+	size_t available() const noexcept
+	{
+		return log_buffer_.capacity() - log_buffer_.size();
+	}
+
+	static void putchar_bounce(char c, void* /*ctx*/)
+	{
+		_putchar(c);
+	}
+
+  private:
+	CircularBuffer<uint8_t, TBufferSize> log_buffer_;
+};
+
+#endif // DEFERRED_LOG_BUFFER_LOGGER_H_
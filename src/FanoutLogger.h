@@ -0,0 +1,486 @@
+#ifndef FANOUT_LOGGER_H_
+#define FANOUT_LOGGER_H_
+
+#include "ArduinoLogger.h"
+#include <string.h>
+
+/** Calls to a FanoutLogger sink, selected by the sink's accepts_statements setting
+ *
+ * Sinks which accept formatted statements receive each statement in spans. Sinks which keep
+ * their own record format receive the log() and print() calls instead.
+ */
+template<bool TAcceptsStatements>
+struct fanout_sink_calls
+{
+	template<class TSink>
+	static void begin_statement(TSink& sink, log_level_e l) noexcept
+	{
+		sink.begin_statement(l);
+	}
+
+	template<class TSink>
+	static void write_statement(TSink& sink, const char* data, size_t len) noexcept
+	{
+		sink.write_statement(data, len);
+	}
+
+	template<class TSink>
+	static void end_statement(TSink& sink, log_level_e l) noexcept
+	{
+		sink.end_statement(l);
+	}
+
+	template<class TSink, typename... Args>
+	static void log(TSink&, log_level_e, const char*, const Args&...) noexcept
+	{
+	}
+
+	template<class TSink, typename... Args>
+	static void print(TSink&, const char*, const Args&...) noexcept
+	{
+	}
+};
+
+template<>
+struct fanout_sink_calls<false>
+{
+	template<class TSink>
+	static void begin_statement(TSink&, log_level_e) noexcept
+	{
+	}
+
+	template<class TSink>
+	static void write_statement(TSink&, const char*, size_t) noexcept
+	{
+	}
+
+	template<class TSink>
+	static void end_statement(TSink&, log_level_e) noexcept
+	{
+	}
+
+	template<class TSink, typename... Args>
+	static void log(TSink& sink, log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		sink.log(l, fmt, args...);
+	}
+
+	template<class TSink, typename... Args>
+	static void print(TSink& sink, const char* fmt, const Args&... args) noexcept
+	{
+		if(sink.enabled())
+		{
+			sink.print(fmt, args...);
+		}
+	}
+};
+
+/** Storage for the sinks of a FanoutLogger
+ *
+ * Each sink is stored by value, so the set of sinks is fixed at compile time and calls to
+ * the sinks are resolved statically.
+ */
+template<class... TSinks>
+struct fanout_sinks
+{
+	template<typename TFn>
+	void for_each(TFn&) noexcept
+	{
+	}
+
+	template<typename TFn>
+	void for_each(TFn&) const noexcept
+	{
+	}
+
+	template<typename... Args>
+	void log_direct(log_level_e, const char*, const Args&...) noexcept
+	{
+	}
+
+	template<typename... Args>
+	void print_direct(const char*, const Args&...) noexcept
+	{
+	}
+};
+
+template<class TFirst, class... TRest>
+struct fanout_sinks<TFirst, TRest...>
+{
+	TFirst first;
+	fanout_sinks<TRest...> rest;
+
+	template<typename TFn>
+	void for_each(TFn& fn) noexcept
+	{
+		fn(first);
+		rest.for_each(fn);
+	}
+
+	template<typename TFn>
+	void for_each(TFn& fn) const noexcept
+	{
+		fn(first);
+		rest.for_each(fn);
+	}
+
+	/// Pass a log() call to the sinks which do not accept formatted statements
+	template<typename... Args>
+	void log_direct(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		fanout_sink_calls<TFirst::accepts_statements>::log(first, l, fmt, args...);
+		rest.log_direct(l, fmt, args...);
+	}
+
+	/// Pass a print() call to the sinks which do not accept formatted statements
+	template<typename... Args>
+	void print_direct(const char* fmt, const Args&... args) noexcept
+	{
+		fanout_sink_calls<TFirst::accepts_statements>::print(first, fmt, args...);
+		rest.print_direct(fmt, args...);
+	}
+};
+
+/// Access to the Ith sink in a fanout_sinks list
+template<size_t I, class TSinks>
+struct fanout_sink_at;
+
+template<class TFirst, class... TRest>
+struct fanout_sink_at<0, fanout_sinks<TFirst, TRest...>>
+{
+	using type = TFirst;
+
+	static type& get(fanout_sinks<TFirst, TRest...>& sinks) noexcept
+	{
+		return sinks.first;
+	}
+};
+
+template<size_t I, class TFirst, class... TRest>
+struct fanout_sink_at<I, fanout_sinks<TFirst, TRest...>>
+{
+	using next = fanout_sink_at<I - 1, fanout_sinks<TRest...>>;
+	using type = typename next::type;
+
+	static type& get(fanout_sinks<TFirst, TRest...>& sinks) noexcept
+	{
+		return next::get(sinks.rest);
+	}
+};
+
+/** Log to several logging strategies at once
+ *
+ * Each log statement is formatted once, and the formatted output is handed to every sink
+ * which accepts the statement's level. For example, a statement can be kept in a RAM buffer
+ * for crash dumps and written to an SD card, while echo() prints it to the console:
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<FanoutLogger<CircularLogBufferLogger<1024>, TeensySDLogger>>;
+ *  @endcode
+ *
+ * The sinks are any logging strategies, and they are stored in the FanoutLogger. Use sink<I>()
+ * to configure them (e.g., to call begin() on an SD logger).
+ *
+ * Levels are filtered in two steps:
+ * - The FanoutLogger's level() limits the statements which are formatted at all.
+ * - Each sink's own level() and enabled() settings select the statements it receives, so
+ *   sinks can have different thresholds: `log.sink<1>().level(log_level_e::warning);`
+ *
+ * Output from print() is sent to every enabled sink.
+ *
+ * Each sink adds its own level prefix and custom prefix, and stores the statement whole (see
+ * LoggerBaseT::begin_statement()), so a record-based sink such as RecordBufferLogger stores
+ * one record per statement.
+ *
+ * Other notes:
+ * - Echo is handled by the FanoutLogger, so the sinks' echo is disabled on construction.
+ * - Sinks which keep their own record format instead of formatted text (accepts_statements is
+ *   false, e.g. DeferredLogBufferLogger) receive the log() and print() calls, and format the
+ *   statement themselves.
+ * - flush() and clear() are applied to every sink. Each sink applies its own auto-flush
+ *   setting and full policy, and reports its own overruns when it is flushed.
+ * - size() and capacity() are the totals for all sinks.
+ *
+ * @tparam TSinks The logging strategies which receive the log output.
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<class... TSinks>
+class FanoutLogger final : public LoggerBaseT<FanoutLogger<TSinks...>>
+{
+	friend class LoggerBaseT<FanoutLogger<TSinks...>>;
+	using BaseClass = LoggerBaseT<FanoutLogger<TSinks...>>;
+	using sinks_t = fanout_sinks<TSinks...>;
+
+	static_assert(sizeof...(TSinks) > 0, "FanoutLogger requires at least one sink");
+
+  public:
+	/// Default constructor
+	FanoutLogger() : BaseClass()
+	{
+		disable_sink_echo();
+	}
+
+	/** Initialize the fan-out logger with options
+	 *
+	 * @param enable If true, log statements will be output to the sinks. If false,
+	 * logging will be disabled and log statements will not be output to the sinks.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to any sink.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be sent to the sinks.
+	 */
+	explicit FanoutLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+						  bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+		disable_sink_echo();
+	}
+
+	/// Default destructor
+	~FanoutLogger() noexcept = default;
+
+	/// The number of sinks
+	static constexpr size_t sink_count() noexcept
+	{
+		return sizeof...(TSinks);
+	}
+
+	/// Access the Ith sink
+	template<size_t I>
+	typename fanout_sink_at<I, sinks_t>::type& sink() noexcept
+	{
+		static_assert(I < sizeof...(TSinks), "Sink index is out of range");
+		return fanout_sink_at<I, sinks_t>::get(sinks_);
+	}
+
+	/// Total size of all sinks
+	size_t size() const noexcept
+	{
+		size_sum sum;
+		sinks_.for_each(sum);
+		return sum.total;
+	}
+
+	/// Total capacity of all sinks
+	size_t capacity() const noexcept
+	{
+		capacity_sum sum;
+		sinks_.for_each(sum);
+		return sum.total;
+	}
+
+	/** Format a statement once and send it to each sink which accepts its level
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(!this->enabled() || l > this->level())
+		{
+			return;
+		}
+
+		// Keep statements from interrupts in order with this one
+		this->drain_interrupt_queue();
+
+		sinks_.log_direct(l, fmt, args...);
+
+		accepts_level accepts{l, false};
+		sinks_.for_each(accepts);
+
+		// Skip formatting when no sink wants the statement, unless it is echoed
+		if(!accepts.any && !this->echo())
+		{
+			return;
+		}
+
+		if(this->echo())
+		{
+			const char* prefix = LOG_LEVEL_TO_SHORT_C_STRING(l);
+			this->log_echo(prefix, strlen(prefix));
+		}
+
+		write_statement(l, fmt, args...);
+	}
+
+	/// Prints directly to every enabled sink with no extra characters added to the message.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		sinks_.print_direct(fmt, args...);
+		write_statement(log_level_e::off, fmt, args...);
+	}
+
+  protected:
+	void flush_() noexcept
+	{
+		flush_sink flush;
+		sinks_.for_each(flush);
+	}
+
+	void clear_() noexcept
+	{
+		clear_sink clear;
+		sinks_.for_each(clear);
+	}
+
+	/// Hand formatted output to the sinks. Called with each span of the current statement.
+	void log_add_span_to_buffer(const char* data, size_t len) noexcept
+	{
+		write_sink write{data, len, record_level_};
+		sinks_.for_each(write);
+	}
+
+  private:
+	/// Format a statement and pass it to the sinks which accept it, as one statement each
+	template<typename... Args>
+	void write_statement(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		// The prior level is kept so a nested log() call (e.g., from an interrupt) is safe
+		log_level_e prior_level = record_level_;
+		record_level_ = l;
+
+		begin_sink begin{l};
+		sinks_.for_each(begin);
+
+		BaseClass::print(fmt, args...);
+
+		end_sink end{l};
+		sinks_.for_each(end);
+
+		record_level_ = prior_level;
+	}
+
+	void disable_sink_echo() noexcept
+	{
+		disable_echo disable;
+		sinks_.for_each(disable);
+	}
+
+	/// Sinks accept output from print() (record level off) if they are enabled. Sinks which
+	/// keep their own record format receive the log() and print() calls instead.
+	template<class TSink>
+	static bool sink_accepts(const TSink& sink, log_level_e l) noexcept
+	{
+		return TSink::accepts_statements && sink.enabled() &&
+			   (l == log_level_e::off || l <= sink.level());
+	}
+
+	struct accepts_level
+	{
+		log_level_e level;
+		bool any;
+
+		template<class TSink>
+		void operator()(const TSink& sink) noexcept
+		{
+			any = any || sink_accepts(sink, level);
+		}
+	};
+
+	struct begin_sink
+	{
+		log_level_e level;
+
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			if(sink_accepts(sink, level))
+			{
+				fanout_sink_calls<TSink::accepts_statements>::begin_statement(sink, level);
+			}
+		}
+	};
+
+	struct write_sink
+	{
+		const char* data;
+		size_t len;
+		log_level_e level;
+
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			if(sink_accepts(sink, level))
+			{
+				fanout_sink_calls<TSink::accepts_statements>::write_statement(sink, data, len);
+			}
+		}
+	};
+
+	struct end_sink
+	{
+		log_level_e level;
+
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			if(sink_accepts(sink, level))
+			{
+				fanout_sink_calls<TSink::accepts_statements>::end_statement(sink, level);
+			}
+		}
+	};
+
+	struct flush_sink
+	{
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			sink.flush();
+		}
+	};
+
+	struct clear_sink
+	{
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			sink.clear();
+		}
+	};
+
+	struct disable_echo
+	{
+		template<class TSink>
+		void operator()(TSink& sink) noexcept
+		{
+			sink.echo(false);
+		}
+	};
+
+	struct size_sum
+	{
+		size_t total = 0;
+
+		template<class TSink>
+		void operator()(const TSink& sink) noexcept
+		{
+			total += sink.size();
+		}
+	};
+
+	struct capacity_sum
+	{
+		size_t total = 0;
+
+		template<class TSink>
+		void operator()(const TSink& sink) noexcept
+		{
+			total += sink.capacity();
+		}
+	};
+
+  private:
+	sinks_t sinks_;
+
+	/// Level of the statement being formatted. Output from print() uses log_level_e::off.
+	log_level_e record_level_ = log_level_e::off;
+};
+
+#endif // FANOUT_LOGGER_H_
@@ -0,0 +1,196 @@
+#ifndef MPSC_LOG_BUFFER_LOGGER_H_
+#define MPSC_LOG_BUFFER_LOGGER_H_
+
+#if defined(__AVR__)
+#error "MPSCLogBufferLogger requires <atomic>, which is not available for AVR"
+#endif
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_MPSC_MAX_RECORD_SIZE
+/// Maximum size of a single formatted log statement, in bytes.
+/// Statements are formatted on the stack, and longer statements are truncated.
+#define LOG_MPSC_MAX_RECORD_SIZE 256
+#endif
+
+#include "ArduinoLogger.h"
+#include "internal/concurrent_logging.hpp"
+#include "internal/mpsc_ring_buffer.hpp"
+
+/** Lock-free multi-producer log buffer
+ *
+ * This strategy is intended for hosts and RTOS targets where several threads log at the same
+ * time. Each log statement is formatted on the calling thread's stack, then added to a
+ * lock-free ring buffer as a whole record with a single atomic reservation. Statements from
+ * different threads are never interleaved, and producers never block each other.
+ *
+ * Requirements:
+ * - flush() and clear() must only be called from one thread at a time (the consumer).
+ *   Producers never flush, so auto-flush is not supported.
+ * - When the buffer is full, new statements are dropped and reported as an overrun.
+ * - Statements longer than LOG_MPSC_MAX_RECORD_SIZE (or half of the buffer, if smaller) are
+ *   truncated.
+ * - Run-time settings (level, echo, etc.) should be configured before logging starts.
+ *
+ * @tparam TBufferSize Defines the size of the ring buffer. Must be a power of 2.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<MPSCLogBufferLogger<16 * 1024>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (16 * 1024)>
+class MPSCLogBufferLogger final
+	: public ConcurrentLoggerBaseT<MPSCLogBufferLogger<TBufferSize>>
+{
+	friend class LoggerBaseT<MPSCLogBufferLogger<TBufferSize>, 0>;
+	friend class ConcurrentLoggerBaseT<MPSCLogBufferLogger<TBufferSize>>;
+	using BaseClass = ConcurrentLoggerBaseT<MPSCLogBufferLogger<TBufferSize>>;
+
+	/// Records are also limited by the largest record the ring buffer can hold
+	static constexpr size_t max_record_size =
+		(LOG_MPSC_MAX_RECORD_SIZE < MPSCRingBuffer<TBufferSize>::max_payload())
+			? LOG_MPSC_MAX_RECORD_SIZE
+			: MPSCRingBuffer<TBufferSize>::max_payload();
+
+  public:
+	/// Producers cannot flush or evict old data, so new data is dropped when the buffer is full
+	static constexpr log_full_policy full_policy = log_full_policy::drop_newest;
+
+	/// Producers format their own records, so statements cannot be passed in spans
+	static constexpr bool accepts_statements = false;
+
+	/// Default constructor
+	MPSCLogBufferLogger() : BaseClass() {}
+
+	/** Initialize the log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit MPSCLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+								 bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~MPSCLogBufferLogger() noexcept = default;
+
+	/// Bytes reserved in the ring buffer, including record headers and padding
+	size_t size() const noexcept
+	{
+		return log_buffer_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return log_buffer_.capacity();
+	}
+
+	/** Add a statement to the log buffer. Safe to call from multiple threads.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::statement, fmt, args...);
+		}
+	}
+
+	/** Add a statement to the log buffer from an interrupt context
+	 *
+	 * The log buffer can already be written from an interrupt, so the statement is added
+	 * directly instead of through the interrupt queue, and stays in order with the other
+	 * statements. The statement is not echoed.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_interrupt(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::interrupt, fmt, args...);
+		}
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	/// Safe to call from multiple threads.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		add_record(log_level_e::off, log_record_origin::statement, fmt, args...);
+	}
+
+  protected:
+	void flush_() noexcept
+	{
+		this->collect_overruns();
+
+		log_buffer_.consume([](const char* data, size_t len) {
+			for(size_t i = 0; i < len; i++)
+			{
+				_putchar(data[i]);
+			}
+		});
+	}
+
+	void clear_() noexcept
+	{
+		log_buffer_.reset();
+		this->pending_overruns_.reset();
+	}
+
+  private:
+	/// @returns false if the record was dropped
+	template<typename... Args>
+	bool add_record(log_level_e l, log_record_origin origin, const char* fmt,
+					const Args&... args) noexcept
+	{
+		char record[max_record_size];
+		log_record_writer writer(record, sizeof(record));
+		writer.format(this->record_prefix(l), fmt, args...);
+
+		// The statement is only formatted once, even when it is echoed
+		if(origin != log_record_origin::interrupt && this->echo())
+		{
+			this->log_echo(record, writer.len);
+		}
+
+		if(!log_buffer_.put(record, writer.len))
+		{
+			this->note_dropped(origin, writer);
+			return false;
+		}
+
+		if(writer.truncated)
+		{
+			this->pending_overruns_.note(writer.truncated, 0);
+		}
+
+		return true;
+	}
+
+  private:
+	MPSCRingBuffer<TBufferSize> log_buffer_;
+};
+
+#endif // MPSC_LOG_BUFFER_LOGGER_H_
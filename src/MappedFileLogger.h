@@ -0,0 +1,220 @@
+#ifndef MAPPED_FILE_LOGGER_H_
+#define MAPPED_FILE_LOGGER_H_
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "MappedFileLogger requires mmap(), which is only available on Linux and other POSIX hosts"
+#endif
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#include "ArduinoLogger.h"
+#include "internal/persistent_ring_buffer.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** Log buffer in a memory-mapped file
+ *
+ * The circular log buffer is a file which is mapped into memory, so log statements are
+ * added with memory writes only: there are no system calls when logging, and the kernel's
+ * page cache writes the data back to the file. The log survives a crash of the process.
+ *
+ * The buffer's indices are kept in the file with a magic value, a sequence number, and a
+ * CRC (see PersistentRingBuffer). When begin() maps a file which holds a valid log (e.g.,
+ * after the process crashed), the log is recovered and new statements are added after it.
+ *
+ * Notes:
+ * - flush() calls msync(), which waits for the log to be written to the file. The log stays
+ *   in the buffer. Use dump() to output the log contents.
+ * - Once the buffer is full, each new statement overwrites the oldest data. Because the
+ *   buffer stays full, auto-flush would call msync() for every statement, so it is best left
+ *   disabled.
+ * - Statements logged before begin() is called are dropped.
+ * - The file holds two header copies followed by the circular buffer (see
+ *   PersistentRingBuffer::storage_t).
+ *
+ * @tparam TBufferSize Defines the size of the log buffer in the file.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<MappedFileLogger<1024 * 1024>>;
+ *
+ *	PlatformLogger::inst().begin("/var/log/app.ring");
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (64 * 1024)>
+class MappedFileLogger final : public LoggerBaseT<MappedFileLogger<TBufferSize>>
+{
+	friend class LoggerBaseT<MappedFileLogger<TBufferSize>>;
+	using BaseClass = LoggerBaseT<MappedFileLogger<TBufferSize>>;
+	using ring_t = PersistentRingBuffer<TBufferSize>;
+	using storage_t = typename ring_t::storage_t;
+
+  public:
+	/// Default constructor
+	MappedFileLogger() : BaseClass() {}
+
+	/** Initialize the log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit MappedFileLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+							  bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+	}
+
+	/// Unmaps the file
+	~MappedFileLogger() noexcept
+	{
+		end();
+	}
+
+	/** Map the log file and recover its contents
+	 *
+	 * The file is created if it does not exist. If it holds a valid log, the log is kept.
+	 * Otherwise, the file is initialized as an empty log.
+	 *
+	 * @param path The path of the log file.
+	 * @returns true if the file was mapped. recovered_size() is the number of bytes which were
+	 * recovered from the file.
+	 */
+	bool begin(const char* path) noexcept
+	{
+		end();
+
+		int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+		if(fd < 0)
+		{
+			return false;
+		}
+
+		void* map = MAP_FAILED;
+
+		if(ftruncate(fd, sizeof(storage_t)) == 0)
+		{
+			map = mmap(nullptr, sizeof(storage_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+
+		// The mapping stays valid after the file is closed
+		close(fd);
+
+		if(map == MAP_FAILED)
+		{
+			return false;
+		}
+
+		storage_ = static_cast<storage_t*>(map);
+		ring_.recover(storage_);
+		recovered_ = ring_.size();
+
+		return true;
+	}
+
+	/// Write the log to the file and unmap it
+	void end() noexcept
+	{
+		if(storage_)
+		{
+			msync(storage_, sizeof(storage_t), MS_SYNC);
+			munmap(storage_, sizeof(storage_t));
+			ring_.detach();
+			storage_ = nullptr;
+		}
+	}
+
+	/// The number of bytes recovered from the file by begin()
+	size_t recovered_size() const noexcept
+	{
+		return recovered_;
+	}
+
+	/// The number of times the log has been recovered since the file was initialized
+	uint32_t session() const noexcept
+	{
+		return ring_.session();
+	}
+
+	/// Output the log contents with _putchar() without removing them
+	void dump() noexcept
+	{
+		if(!storage_)
+		{
+			return;
+		}
+
+		typename ring_t::span first;
+		typename ring_t::span second;
+		ring_.peek_spans(first, second);
+
+		for(size_t i = 0; i < first.size; i++)
+		{
+			_putchar(first.data[i]);
+		}
+
+		for(size_t i = 0; i < second.size; i++)
+		{
+			_putchar(second.data[i]);
+		}
+	}
+
+	size_t size() const noexcept
+	{
+		return ring_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return TBufferSize;
+	}
+
+  protected:
+	void log_putc(char c) noexcept
+	{
+		log_write(&c, 1);
+	}
+
+	void log_write(const char* str, size_t len) noexcept
+	{
+		if(storage_)
+		{
+			ring_.put(str, len);
+		}
+	}
+
+	/// Wait for the page cache to write the log to the file
+	void flush_() noexcept
+	{
+		if(storage_)
+		{
+			msync(storage_, sizeof(storage_t), MS_SYNC);
+		}
+	}
+
+	void clear_() noexcept
+	{
+		if(storage_)
+		{
+			ring_.reset();
+		}
+	}
+
+  private:
+	storage_t* storage_ = nullptr;
+	ring_t ring_;
+	size_t recovered_ = 0;
+};
+
+#endif // MAPPED_FILE_LOGGER_H_
@@ -0,0 +1,301 @@
+#ifndef PER_THREAD_LOG_BUFFER_LOGGER_H_
+#define PER_THREAD_LOG_BUFFER_LOGGER_H_
+
+#if defined(__AVR__)
+#error "PerThreadLogBufferLogger requires <atomic>, which is not available for AVR"
+#endif
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_PER_THREAD_MAX_RECORD_SIZE
+/// Maximum size of a single formatted log statement, in bytes.
+/// Statements are formatted on the stack, and longer statements are truncated.
+#define LOG_PER_THREAD_MAX_RECORD_SIZE 256
+#endif
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#endif
+#include "ArduinoLogger.h"
+#include "internal/concurrent_logging.hpp"
+#include "internal/mpsc_ring_buffer.hpp"
+
+#ifndef LOG_THREAD_SLOT
+/// Selects the buffer used by the calling thread. By default, each thread claims its own slot.
+/// On multi-core MCUs, this can be defined as the core ID (e.g., xPortGetCoreID()) if log
+/// statements cannot preempt each other on the same core.
+#define LOG_THREAD_SLOT() log_thread_slot::index()
+#endif
+
+#ifndef LOG_MERGE_TIMESTAMP
+/// Timestamp used to order statements from different threads during flush().
+/// It must be monotonic, and fine-grained enough to separate statements.
+#if defined(ARDUINO)
+#define LOG_MERGE_TIMESTAMP() static_cast<uint64_t>(micros())
+#else
+#include <chrono>
+#define LOG_MERGE_TIMESTAMP() log_merge_timestamp()
+
+/// Monotonic time, in nanoseconds
+inline uint64_t log_merge_timestamp() noexcept
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+									 std::chrono::steady_clock::now().time_since_epoch())
+									 .count());
+}
+#endif
+#endif
+
+/** Log buffer with a private buffer for each thread
+ *
+ * Even a lock-free shared buffer moves cache lines between cores when several threads log
+ * heavily. With this strategy, each thread (see LOG_THREAD_SLOT()) formats its statements on
+ * its own stack and adds them to its own buffer, so producers never write to memory which is
+ * shared with another producer.
+ *
+ * Each statement is stored with a timestamp (see LOG_MERGE_TIMESTAMP()). flush() merges the
+ * buffers by timestamp, so the output is in the order the statements were logged. Statements
+ * from a single thread always stay in order. If producers keep logging while the buffers are
+ * flushed, a statement which is published late may be output after newer statements from
+ * other threads.
+ *
+ * Requirements:
+ * - flush() and clear() must only be called from one thread at a time (the consumer).
+ *   Producers never flush, so auto-flush is not supported.
+ * - When a thread's buffer is full, its new statements are dropped and reported as an overrun.
+ * - Statements from threads beyond the first TThreadCount slots are dropped and reported as an
+ *   overrun. Slots are released when threads exit.
+ * - flush() adds the overrun report to the consumer's own buffer, so the consumer needs a slot
+ *   too. Until it has one, overruns are counted (see overrun_stats()) but not reported.
+ * - Statements longer than LOG_PER_THREAD_MAX_RECORD_SIZE (or half of the buffer, if smaller)
+ *   are truncated.
+ * - Run-time settings (level, echo, etc.) should be configured before logging starts.
+ *
+ * @tparam TBufferSize Defines the size of each thread's buffer. Must be a power of 2.
+ * @tparam TThreadCount The number of thread buffers.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<PerThreadLogBufferLogger<4 * 1024, 4>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (4 * 1024), size_t TThreadCount = 4>
+class PerThreadLogBufferLogger final
+	: public ConcurrentLoggerBaseT<PerThreadLogBufferLogger<TBufferSize, TThreadCount>>
+{
+	friend class LoggerBaseT<PerThreadLogBufferLogger<TBufferSize, TThreadCount>, 0>;
+	friend class ConcurrentLoggerBaseT<PerThreadLogBufferLogger<TBufferSize, TThreadCount>>;
+	using BaseClass = ConcurrentLoggerBaseT<PerThreadLogBufferLogger<TBufferSize, TThreadCount>>;
+	using timestamp_t = uint64_t;
+
+	static_assert(TThreadCount > 0, "PerThreadLogBufferLogger requires at least one buffer");
+
+	/// Records are also limited by the largest record a thread buffer can hold
+	static constexpr size_t max_record_size =
+		(LOG_PER_THREAD_MAX_RECORD_SIZE <
+		 MPSCRingBuffer<TBufferSize>::max_payload() - sizeof(timestamp_t))
+			? LOG_PER_THREAD_MAX_RECORD_SIZE
+			: MPSCRingBuffer<TBufferSize>::max_payload() - sizeof(timestamp_t);
+
+  public:
+	/// Producers cannot flush or evict old data, so new data is dropped when a buffer is full
+	static constexpr log_full_policy full_policy = log_full_policy::drop_newest;
+
+	/// Producers format their own records, so statements cannot be passed in spans
+	static constexpr bool accepts_statements = false;
+
+	/// Default constructor
+	PerThreadLogBufferLogger() : BaseClass() {}
+
+	/** Initialize the log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit PerThreadLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+									  bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~PerThreadLogBufferLogger() noexcept = default;
+
+	/// Bytes used in all thread buffers, including record headers and padding
+	size_t size() const noexcept
+	{
+		size_t total = 0;
+
+		for(size_t i = 0; i < TThreadCount; i++)
+		{
+			total += buffers_[i].size();
+		}
+
+		return total;
+	}
+
+	size_t capacity() const noexcept
+	{
+		return TBufferSize * TThreadCount;
+	}
+
+	/** Add a statement to the calling thread's buffer. Safe to call from multiple threads.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::statement, fmt, args...);
+		}
+	}
+
+	/** Add a statement to the log buffer from an interrupt context
+	 *
+	 * The thread buffers can already be written from an interrupt, so the statement is added
+	 * to the interrupted thread's buffer instead of the interrupt queue. It keeps its
+	 * timestamp, so it is merged in order with the other statements. It is not echoed.
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_interrupt(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			add_record(l, log_record_origin::interrupt, fmt, args...);
+		}
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	/// Safe to call from multiple threads.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		add_record(log_level_e::off, log_record_origin::statement, fmt, args...);
+	}
+
+  protected:
+	/// Merge the thread buffers, oldest statement first
+	void flush_() noexcept
+	{
+		this->collect_overruns();
+
+		while(true)
+		{
+			size_t oldest = TThreadCount;
+			timestamp_t oldest_timestamp = 0;
+			const char* oldest_data = nullptr;
+			size_t oldest_len = 0;
+
+			for(size_t i = 0; i < TThreadCount; i++)
+			{
+				const char* data;
+				size_t len;
+
+				if(!buffers_[i].front(data, len))
+				{
+					continue;
+				}
+
+				timestamp_t timestamp;
+				memcpy(&timestamp, data, sizeof(timestamp));
+
+				if(oldest == TThreadCount || timestamp < oldest_timestamp)
+				{
+					oldest = i;
+					oldest_timestamp = timestamp;
+					oldest_data = data;
+					oldest_len = len;
+				}
+			}
+
+			if(oldest == TThreadCount)
+			{
+				break;
+			}
+
+			for(size_t i = sizeof(timestamp_t); i < oldest_len; i++)
+			{
+				_putchar(oldest_data[i]);
+			}
+
+			buffers_[oldest].pop_front();
+		}
+	}
+
+	void clear_() noexcept
+	{
+		for(size_t i = 0; i < TThreadCount; i++)
+		{
+			buffers_[i].reset();
+		}
+
+		this->pending_overruns_.reset();
+	}
+
+  private:
+	/// @returns false if the record was dropped
+	template<typename... Args>
+	bool add_record(log_level_e l, log_record_origin origin, const char* fmt,
+					const Args&... args) noexcept
+	{
+		char record[sizeof(timestamp_t) + max_record_size];
+		log_record_writer writer(record + sizeof(timestamp_t), max_record_size);
+		writer.format(this->record_prefix(l), fmt, args...);
+
+		// The statement is only formatted once, even when it is echoed
+		if(origin != log_record_origin::interrupt && this->echo())
+		{
+			this->log_echo(writer.buffer, writer.len);
+		}
+
+		int slot = LOG_THREAD_SLOT();
+
+		if(slot < 0 || static_cast<size_t>(slot) >= TThreadCount)
+		{
+			this->note_dropped(origin, writer);
+			return false;
+		}
+
+		// Take the timestamp after formatting, so it is as close as possible to the time the
+		// record becomes visible to flush()
+		timestamp_t timestamp = LOG_MERGE_TIMESTAMP();
+		memcpy(record, &timestamp, sizeof(timestamp));
+
+		if(!buffers_[slot].put(record, sizeof(timestamp_t) + writer.len))
+		{
+			this->note_dropped(origin, writer);
+			return false;
+		}
+
+		if(writer.truncated)
+		{
+			this->pending_overruns_.note(writer.truncated, 0);
+		}
+
+		return true;
+	}
+
+  private:
+	/// Each buffer has a single producer, so the producers never contend for a cache line
+	MPSCRingBuffer<TBufferSize> buffers_[TThreadCount];
+};
+
+#endif // PER_THREAD_LOG_BUFFER_LOGGER_H_
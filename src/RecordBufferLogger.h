@@ -0,0 +1,326 @@
+#ifndef RECORD_BUFFER_LOGGER_H_
+#define RECORD_BUFFER_LOGGER_H_
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#endif
+#include "ArduinoLogger.h"
+#include "internal/record_buffer.hpp"
+#include <string.h>
+
+/** Record-oriented circular log buffer
+ *
+ * Like CircularLogBufferLogger, this strategy keeps the newest log data in a circular buffer
+ * in RAM. Instead of overwriting the oldest bytes, it stores each log statement as a record
+ * and evicts the oldest records whole. The first line of the flushed output is therefore
+ * never a partial statement.
+ *
+ * Each record holds a header with the payload length, the log level, and a timestamp from
+ * LOG_TIMESTAMP(). The level prefix is not stored as text: it is rendered at flush time as
+ * `<level prefix>[<timestamp> ms] `. Because the level is stored with the record,
+ * flush(log_level_e) can output a subset of the buffered levels. A custom prefix added by
+ * log_customprefix() is stored as text, at the start of the payload.
+ *
+ * Records are reserved when a statement starts and committed once it has been formatted.
+ * With the default overwrite_oldest policy, the oldest records are evicted to make room.
+ * With the drop_newest and flush_and_block policies, a statement which does not fit is
+ * dropped whole when the buffer cannot be flushed.
+ * - A statement which is larger than the buffer is truncated (overwrite_oldest) or dropped.
+ * - A statement logged while another is being formatted (e.g., by log_customprefix()) is dropped.
+ * Both cases are reported as an overrun. Interrupts should use log_interrupt(), which queues
+ * the statement until the next log() or flush() call from the main context.
+ *
+ * @tparam TBufferSize Defines the size of the circular log buffer.
+ * @tparam TFullPolicy Behavior when the buffer is full. See log_full_policy.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<RecordBufferLogger<8 * 1024>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (1 * 1024),
+		 log_full_policy TFullPolicy = log_full_policy::overwrite_oldest>
+class RecordBufferLogger final : public LoggerBaseT<RecordBufferLogger<TBufferSize, TFullPolicy>>
+{
+	friend class LoggerBaseT<RecordBufferLogger<TBufferSize, TFullPolicy>>;
+	using BaseClass = LoggerBaseT<RecordBufferLogger<TBufferSize, TFullPolicy>>;
+
+  public:
+	/// Behavior when the log buffer is full
+	static constexpr log_full_policy full_policy = TFullPolicy;
+
+	/// Default constructor
+	RecordBufferLogger() : BaseClass() {}
+
+	/** Initialize the record buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit RecordBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+								bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~RecordBufferLogger() noexcept = default;
+
+	/// Bytes used by buffered records, including their headers
+	size_t size() const noexcept
+	{
+		return log_buffer_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return log_buffer_.capacity();
+	}
+
+	/** Add a record to the log buffer
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		if(!this->enabled() || l > this->level())
+		{
+			return;
+		}
+
+		// Keep statements from interrupts in order with this one. Queued statements could not
+		// be added while another record is open.
+		if(!log_buffer_.open())
+		{
+			this->drain_interrupt_queue();
+		}
+
+		if(begin_record(l))
+		{
+			if(this->echo())
+			{
+				// The message is echoed as it is staged
+				const char* prefix = LOG_LEVEL_TO_SHORT_C_STRING(l);
+				this->log_echo(prefix, strlen(prefix));
+			}
+
+			this->log_customprefix();
+			BaseClass::print(fmt, args...);
+			log_buffer_.commit();
+			this->track_occupancy();
+		}
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	/// Output is stored as a record with level log_level_e::off, unless it is printed while a
+	/// statement is formatted (e.g., by log_customprefix()), and belongs to that statement.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		if(log_buffer_.open())
+		{
+			BaseClass::print(fmt, args...);
+		}
+		else if(begin_record(log_level_e::off))
+		{
+			BaseClass::print(fmt, args...);
+			log_buffer_.commit();
+			this->track_occupancy();
+		}
+	}
+
+	/// See LoggerBaseT::begin_statement(). The statement is stored as one record.
+	void begin_statement(log_level_e l) noexcept
+	{
+		if(!log_buffer_.open())
+		{
+			this->drain_interrupt_queue();
+		}
+
+		// If the record cannot be started, the statement's spans are dropped
+		if(begin_record(l) && l != log_level_e::off)
+		{
+			this->log_customprefix();
+		}
+	}
+
+	/// See LoggerBaseT::end_statement()
+	void end_statement(log_level_e l) noexcept
+	{
+		(void)l;
+
+		if(log_buffer_.open())
+		{
+			log_buffer_.commit();
+			this->track_occupancy();
+		}
+	}
+
+	using BaseClass::flush;
+
+	/** Flush the records at or below a log level
+	 *
+	 * Records with a higher level are removed from the buffer without being output.
+	 * Output from print() is always flushed.
+	 *
+	 * @param l The highest log level to output.
+	 */
+	void flush(log_level_e l) noexcept
+	{
+		flush_level_ = l;
+		flush();
+		flush_level_ = log_level_e::debug;
+	}
+
+  protected:
+	void log_add_span_to_buffer(const char* data, size_t len) noexcept
+	{
+		// The record may have been dropped by an earlier span
+		if(!log_buffer_.open())
+		{
+			return;
+		}
+
+		while(len > 0)
+		{
+			if(log_buffer_.available() == 0 && !make_room())
+			{
+				if(full_policy == log_full_policy::overwrite_oldest)
+				{
+					// The open record fills the buffer, so the rest of the statement is lost
+					this->mark_overrun(len);
+				}
+				else
+				{
+					this->mark_overrun(log_buffer_.abort() + len, 1);
+				}
+
+				return;
+			}
+
+			size_t written = log_buffer_.write(data, len);
+			if(written == 0)
+			{
+				// The record has reached its maximum length
+				this->mark_overrun(len);
+				return;
+			}
+
+			data += written;
+			len -= written;
+		}
+	}
+
+	void flush_() noexcept
+	{
+		while(!log_buffer_.empty())
+		{
+			auto h = log_buffer_.front();
+
+			if(h.level <= flush_level_)
+			{
+				if(h.level != log_level_e::off)
+				{
+					fctprintf(&putchar_bounce, nullptr, "%s[%lu ms] ",
+							  LOG_LEVEL_TO_SHORT_C_STRING(static_cast<log_level_e>(h.level)),
+							  static_cast<unsigned long>(h.timestamp));
+				}
+
+				log_buffer_.pop_front([](const char* data, size_t len) {
+					for(size_t i = 0; i < len; i++)
+					{
+						_putchar(data[i]);
+					}
+				});
+			}
+			else
+			{
+				log_buffer_.drop_front();
+			}
+		}
+	}
+
+	void clear_() noexcept
+	{
+		log_buffer_.reset();
+	}
+
+  private:
+	bool begin_record(log_level_e l) noexcept
+	{
+		if(log_buffer_.open())
+		{
+			// Only one record can be formatted at a time
+			this->mark_overrun(0, 1);
+			return false;
+		}
+
+		while(log_buffer_.available() < log_buffer_.header_size)
+		{
+			if(!make_room())
+			{
+				this->mark_overrun(0, 1);
+				return false;
+			}
+		}
+
+		log_buffer_.begin(static_cast<uint8_t>(l), static_cast<uint32_t>(LOG_TIMESTAMP()));
+		return true;
+	}
+
+	/** Free space by removing the oldest committed records
+	 *
+	 * If flush_when_full() is true, the committed records are flushed. Otherwise, the oldest
+	 * record is dropped if the policy is overwrite_oldest.
+	 *
+	 * @returns false if no space could be freed.
+	 */
+	bool make_room() noexcept
+	{
+		if(log_buffer_.empty())
+		{
+			return false;
+		}
+
+		if(this->flush_when_full())
+		{
+			flush_();
+		}
+		else if(full_policy == log_full_policy::overwrite_oldest)
+		{
+			this->mark_overrun(log_buffer_.drop_front(), 1);
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	static void putchar_bounce(char c, void* /*ctx*/)
+	{
+		_putchar(c);
+	}
+
+  private:
+	RecordBuffer<TBufferSize> log_buffer_;
+	log_level_e flush_level_ = log_level_e::debug;
+};
+
+#endif // RECORD_BUFFER_LOGGER_H_
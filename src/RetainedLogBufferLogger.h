@@ -0,0 +1,170 @@
+#ifndef RETAINED_LOG_BUFFER_LOGGER_H_
+#define RETAINED_LOG_BUFFER_LOGGER_H_
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_RETAINED_SECTION
+/// Places the retained log buffer in RAM which is not cleared on reset.
+/// The linker script must provide the section. Most Arduino cores provide `.noinit`.
+#if defined(__APPLE__)
+#define LOG_RETAINED_SECTION __attribute__((section("__DATA,__noinit")))
+#else
+#define LOG_RETAINED_SECTION __attribute__((section(".noinit")))
+#endif
+#endif
+
+#include "ArduinoLogger.h"
+#include "internal/persistent_ring_buffer.hpp"
+
+/** Log buffer which survives a reset
+ *
+ * The circular log buffer is kept in a RAM section which is not initialized at startup
+ * (see LOG_RETAINED_SECTION), so the log from before a watchdog reset or a crash is still
+ * available when the program starts again. Nothing is written to slower storage at run-time.
+ *
+ * The buffer's indices are kept in a header with a magic value, a sequence number, and a
+ * CRC (see PersistentRingBuffer), so a reset in the middle of an update leaves the previous
+ * state intact.
+ *
+ * Call begin() at startup, before logging:
+ * - If the buffer holds a valid log from the previous session, it is kept. Call flush() to
+ *   output it, or keep logging and it will be output with the new statements.
+ * - Otherwise (e.g., after power loss), the buffer is initialized.
+ *
+ * Statements logged before begin() is called are dropped.
+ *
+ * Every RetainedLogBufferLogger with the same buffer size shares the same retained buffer,
+ * so only use one instance.
+ *
+ * @tparam TBufferSize Defines the size of the retained log buffer.
+ *
+ *	@code
+ *	using PlatformLogger =
+ *		PlatformLogger_t<RetainedLogBufferLogger<1024>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (1 * 1024)>
+class RetainedLogBufferLogger final : public LoggerBaseT<RetainedLogBufferLogger<TBufferSize>>
+{
+	friend class LoggerBaseT<RetainedLogBufferLogger<TBufferSize>>;
+	using BaseClass = LoggerBaseT<RetainedLogBufferLogger<TBufferSize>>;
+
+	using ring_t = PersistentRingBuffer<TBufferSize>;
+
+  public:
+	/// Default constructor
+	RetainedLogBufferLogger() : BaseClass() {}
+
+	/** Initialize the log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit RetainedLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+									 bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: BaseClass(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~RetainedLogBufferLogger() noexcept = default;
+
+	/** Validate the retained buffer and start logging
+	 *
+	 * @returns true if the log from the previous session was recovered. recovered_size()
+	 * is the number of bytes it holds. Returns false if the buffer was initialized.
+	 */
+	bool begin() noexcept
+	{
+		bool recovered = ring_.recover(&storage_);
+		recovered_ = ring_.size();
+		return recovered;
+	}
+
+	/// The number of bytes recovered from the previous session by begin()
+	size_t recovered_size() const noexcept
+	{
+		return recovered_;
+	}
+
+	/// The number of times the buffer has been recovered since it was initialized
+	uint32_t session() const noexcept
+	{
+		return ring_.session();
+	}
+
+	size_t size() const noexcept
+	{
+		return ring_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return TBufferSize;
+	}
+
+  protected:
+	void log_putc(char c) noexcept
+	{
+		log_write(&c, 1);
+	}
+
+	void log_write(const char* str, size_t len) noexcept
+	{
+		if(ring_.attached())
+		{
+			ring_.put(str, len);
+		}
+	}
+
+	void flush_() noexcept
+	{
+		typename ring_t::span first;
+		typename ring_t::span second;
+		size_t count = ring_.peek_spans(first, second);
+
+		for(size_t i = 0; i < first.size; i++)
+		{
+			_putchar(first.data[i]);
+		}
+
+		for(size_t i = 0; i < second.size; i++)
+		{
+			_putchar(second.data[i]);
+		}
+
+		ring_.consume(count);
+		recovered_ = 0;
+	}
+
+	void clear_() noexcept
+	{
+		if(ring_.attached())
+		{
+			ring_.reset();
+			recovered_ = 0;
+		}
+	}
+
+  private:
+	static typename ring_t::storage_t storage_;
+
+	ring_t ring_;
+	size_t recovered_ = 0;
+};
+
+template<size_t TBufferSize>
+typename PersistentRingBuffer<TBufferSize>::storage_t
+	RetainedLogBufferLogger<TBufferSize>::storage_ LOG_RETAINED_SECTION;
+
+#endif // RETAINED_LOG_BUFFER_LOGGER_H_
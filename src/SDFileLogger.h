@@ -5,6 +5,7 @@
 #include "ArduinoLogger.h"
 #include "SdFat.h"
 #include "internal/circular_buffer.hpp"
+#include "internal/sd_logging.hpp"
 
 /** SD File Buffer
  *
@@ -12,6 +13,11 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery) until logging can resume.
+ * If the card needs to be initialized again (e.g., after it was removed), call `sd.begin()`;
+ * the log file is reopened on the next attempt.
+ *
  *	@code
  *	using PlatformLogger =
  *		PlatformLogger_t<SDFileLogger>;
@@ -19,141 +25,186 @@
  *
  * @ingroup LoggingSubsystem
  */
-class SDFileLogger final : public LoggerBase
+class SDFileLogger final
+	: public SDLoggerBaseT<SDFileLogger, CircularBuffer<char, 512>>
 {
-  private:
-	static constexpr size_t BUFFER_SIZE = 512;
+	friend class LoggerBaseT<SDFileLogger>;
+	friend class SDLoggerBaseT<SDFileLogger, CircularBuffer<char, 512>>;
+	using BaseClass = SDLoggerBaseT<SDFileLogger, CircularBuffer<char, 512>>;
 
   public:
 	/// Default constructor
-	SDFileLogger() : LoggerBase() {}
+	SDFileLogger() : BaseClass() {}
 
 	/// Default destructor
 	~SDFileLogger() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
 		return file_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		// size in blocks * bytes per block (512 Bytes = 2^9)
 		return fs_ ? fs_->card()->sectorCount() << 9 : 0;
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
 		print("[%d ms] ", millis());
 	}
 
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
 		fs_ = &sd_inst;
+		preallocated_ = false;
+		resume_position_ = 0;
 
 		if(!file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			errorHalt("Failed to open file");
+			// Logging continues in RAM until the file can be opened
+			card_error("Failed to open file");
+
+			// The file is cleared once it can be opened, as if begin() had succeeded
+			resume_position_ = 0;
 		}
+		else
+		{
+			recovery_.recovered();
 
-		// Clear current file contents
-		file_.truncate(0);
+			// Clear current file contents
+			file_.truncate(0);
+
+			// Reserve contiguous clusters, so appending does not need to search the FAT
+			preallocated_ = (preallocate > 0) && file_.preAllocate(preallocate);
+
+			if(preallocate > 0 && !preallocated_)
+			{
+				warning("Failed to pre-allocate %lu bytes for the log file\n",
+						static_cast<unsigned long>(preallocate));
+			}
+		}
 
 		// Flush the buffer since the file is open
+		sync();
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
 		flush();
 
+		if(recovery_.available())
+		{
+			if(!write_buffer(log_buffer_.size()))
+			{
+				card_error("Failed to write to log file");
+			}
+			else if(preallocated_ && !file_.truncate(file_.curPosition()))
+			{
+				card_error("Failed to truncate log file");
+			}
+		}
+
 		file_.close();
+		preallocated_ = false;
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
 		log_buffer_.put(c);
 	}
 
-	size_t internal_size() const noexcept override
+	void log_write(const char* str, size_t len) noexcept
+	{
+		log_buffer_.put(str, len);
+	}
+
+	size_t internal_size() const noexcept
 	{
 		return log_buffer_.size();
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_capacity() const noexcept
 	{
 		return log_buffer_.capacity();
 	}
 
-	void flush_() noexcept final
+	void flush_() noexcept
 	{
 		writeBufferToSDFile();
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
 		log_buffer_.reset();
 	}
 
   private:
-	void errorHalt(const char* msg)
+	/// Called by recover()
+	bool reopen_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
-		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
-			{
-				printf("Try power cycling the SD card.\n");
-			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
-		}
-		while(true)
-		{
-		}
+		return resume_file(filename_);
 	}
 
 	void writeBufferToSDFile()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(!recovery_.available() && !recover())
 		{
-			errorHalt("Failed to open file");
+			hold_buffer();
+			return;
 		}
 
-		int bytes_written = 0;
-
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
+		// Data held while the card was unavailable is written first
+		auto& fallback = recovery_.fallback();
 
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		if(!fallback.empty() &&
+		   !log_sd_retry([&]() { return log_write_buffer(file_, fallback, fallback.size()); },
+						 delay))
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written = file_.write(&buffer[tail], log_buffer_.capacity() - tail);
-			bytes_written += file_.write(buffer, head);
+			card_error("Failed to write to log file");
+			hold_buffer();
+			return;
 		}
-		else
+
+		size_t count = log_buffer_.size();
+
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(preallocated_)
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(&buffer[tail], log_buffer_.size());
+			count -= count % log_sd_sector_size;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		if(!write_buffer(count))
 		{
-			errorHalt("Failed to write to log file");
+			card_error("Failed to write to log file");
+			hold_buffer();
+			return;
 		}
 
-		log_buffer_.reset();
-
-		file_.close();
+		if(sync_.flushed(millis()))
+		{
+			sync_file();
+		}
 	}
 
   private:
-	SdFs* fs_;
 	const char* filename_ = "log.txt";
-	mutable FsFile file_;
-
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
 };
 
 #endif // SD_FILE_LOGGER_H_
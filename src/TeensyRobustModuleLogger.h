@@ -5,6 +5,7 @@
 #include "ArduinoLogger.h"
 #include "SdFat.h"
 #include "internal/circular_buffer.hpp"
+#include "internal/sd_logging.hpp"
 #include <EEPROM.h>
 #include <kinetis.h>
 
@@ -24,6 +25,11 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery) until logging can resume.
+ * If the card needs to be initialized again (e.g., after it was removed), call `sd.begin()`;
+ * the log file is reopened on the next attempt.
+ *
  * NOTE that module APIs are not routed to the global instance manager,
  * so you cannot use that class or the macros with this strategy.
  * You can implement your own that forwards the appropriate APIs, however.
@@ -39,25 +45,32 @@
  * @ingroup LoggingSubsystem
  */
 template<size_t TModuleCount = 1>
-class TeensyRobustModuleLogger final : public LoggerBase
+class TeensyRobustModuleLogger final
+	: public SDLoggerBaseT<TeensyRobustModuleLogger<TModuleCount>,
+						   CircularBuffer<char, 512>>
 {
+	friend class LoggerBaseT<TeensyRobustModuleLogger<TModuleCount>>;
+	friend class SDLoggerBaseT<TeensyRobustModuleLogger<TModuleCount>,
+							   CircularBuffer<char, 512>>;
+	using BaseClass =
+		SDLoggerBaseT<TeensyRobustModuleLogger<TModuleCount>, CircularBuffer<char, 512>>;
+
   private:
-	static constexpr size_t BUFFER_SIZE = 512;
 	static constexpr size_t FILENAME_SIZE = 32;
 	static constexpr unsigned EEPROM_LOG_STORAGE_ADDR = 4095;
 
   public:
 	/// Default constructor
-	TeensyRobustModuleLogger() : LoggerBase() {}
+	TeensyRobustModuleLogger() : BaseClass() {}
 
 	/// Default destructor
 	~TeensyRobustModuleLogger() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
-		if(fs_)
+		if(this->fs_)
 		{
-			return file_.size();
+			return this->file_.size();
 		}
 		else if(fallback_to_eeprom_)
 		{
@@ -66,16 +79,16 @@ class TeensyRobustModuleLogger final : public LoggerBase
 		}
 		else
 		{
-			return log_buffer_.size();
+			return this->log_buffer_.size();
 		}
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
-		if(fs_)
+		if(this->fs_)
 		{
 			// size in blocks * bytes per block (512 Bytes = 2^9)
-			return fs_ ? fs_->card()->sectorCount() << 9 : 0;
+			return this->fs_ ? this->fs_->card()->sectorCount() << 9 : 0;
 		}
 		else if(fallback_to_eeprom_)
 		{
@@ -83,13 +96,13 @@ class TeensyRobustModuleLogger final : public LoggerBase
 		}
 		else
 		{
-			return log_buffer_.capacity();
+			return this->log_buffer_.capacity();
 		}
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
-		print("[%d ms] ", millis());
+		this->print("[%d ms] ", millis());
 	}
 
 	void begin()
@@ -117,26 +130,81 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	}
 
 	// SD Card Logger
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
-		fs_ = &sd_inst;
+		this->fs_ = &sd_inst;
+		this->preallocated_ = false;
+		this->resume_position_ = 0;
 
 		set_filename();
 
-		if(!file_.open(filename_, O_WRITE | O_CREAT))
+		if(!this->file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			errorHalt("Failed to open file");
+			// Logging continues in RAM until the file can be opened
+			this->card_error("Failed to open file");
+
+			// The file is cleared once it can be opened, as if begin() had succeeded
+			this->resume_position_ = 0;
 		}
+		else
+		{
+			this->recovery_.recovered();
+
+			// Clear current file contents
+			this->file_.truncate(0);
+
+			// Reserve contiguous clusters, so appending does not need to search the FAT
+			this->preallocated_ = (preallocate > 0) && this->file_.preAllocate(preallocate);
 
-		// Clear current file contents
-		file_.truncate(0);
+			if(preallocate > 0 && !this->preallocated_)
+			{
+				BaseClass::warning("Failed to pre-allocate %lu bytes for the log file\n",
+								   static_cast<unsigned long>(preallocate));
+			}
+		}
 
 		log_reset_reason();
 
 		// Manually flush, since the file is open
-		flush();
+		this->sync();
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
+		if(!this->fs_)
+		{
+			return;
+		}
+
+		this->flush();
+
+		if(this->recovery_.available())
+		{
+			if(!this->write_buffer(this->log_buffer_.size()))
+			{
+				this->card_error("Failed to write to log file");
+			}
+			else if(this->preallocated_ && !this->file_.truncate(this->file_.curPosition()))
+			{
+				this->card_error("Failed to truncate log file");
+			}
+		}
 
-		file_.close();
+		this->file_.close();
+		this->preallocated_ = false;
 	}
 
 	// Resets the log file counter back to 1
@@ -161,14 +229,14 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	/// the global log level
 	log_level_e level(log_level_e l) noexcept
 	{
-		return LoggerBase::level(l);
+		return LoggerBaseT<TeensyRobustModuleLogger>::level(l);
 	}
 
 	/// Get the log level for ALL modules
 	/// We need to forward this version to the base class version
 	log_level_e level() const noexcept
 	{
-		return LoggerBase::level();
+		return LoggerBaseT<TeensyRobustModuleLogger>::level();
 	}
 
 	/** Set the maximum log level (filtering) for the specified module
@@ -194,7 +262,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::critical)
 		{
-			log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -203,7 +271,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::critical)
 		{
-			log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -212,7 +280,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::error)
 		{
-			log(log_level_e::error, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::error, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -221,7 +289,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::error)
 		{
-			log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -230,7 +298,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::warning)
 		{
-			log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -239,7 +307,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::warning)
 		{
-			log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -248,7 +316,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::info)
 		{
-			log(log_level_e::info, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::info, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -257,7 +325,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::info)
 		{
-			log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -266,7 +334,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::debug)
 		{
-			log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -275,22 +343,27 @@ class TeensyRobustModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::debug)
 		{
-			log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
-		log_buffer_.put(c);
+		this->log_buffer_.put(c);
 	}
 
-	size_t internal_size() const noexcept override
+	void log_write(const char* str, size_t len) noexcept
 	{
-		return log_buffer_.size();
+		this->log_buffer_.put(str, len);
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_size() const noexcept
+	{
+		return this->log_buffer_.size();
+	}
+
+	size_t internal_capacity() const noexcept
 	{
 		if(fallback_to_eeprom_)
 		{
@@ -300,15 +373,15 @@ class TeensyRobustModuleLogger final : public LoggerBase
 		}
 		else
 		{
-			return log_buffer_.capacity();
+			return this->log_buffer_.capacity();
 		}
 	}
 
-	void flush_() noexcept final
+	void flush_() noexcept
 	{
 		// First, we need to check to ensure that there is an SD Instance
 		// If not, we determine whether we need to fallback to EEPROM
-		if(fs_)
+		if(this->fs_)
 		{
 			writeBufferToSDFile();
 		}
@@ -316,29 +389,29 @@ class TeensyRobustModuleLogger final : public LoggerBase
 		{
 			// We go byte-by-byte (since that's what the EEPROM interface allows)
 			// and then we reset the log buffer
-			while(!log_buffer_.empty())
+			while(!this->log_buffer_.empty())
 			{
-				EEPROMWriteAndIncrement(log_buffer_.get());
+				EEPROMWriteAndIncrement(this->log_buffer_.get());
 			}
 			// End with a NULL terminator to ensure we clear out any OLD log data
 			// stored in the EEPROM
 			EEPROMWriteAndIncrement(0x0);
 
-			log_buffer_.reset();
+			this->log_buffer_.reset();
 		}
 		else
 		{
 			// Circular buffer just prints out the log
-			while(!log_buffer_.empty())
+			while(!this->log_buffer_.empty())
 			{
-				_putchar(log_buffer_.get());
+				_putchar(this->log_buffer_.get());
 			}
 		}
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
-		log_buffer_.reset();
+		this->log_buffer_.reset();
 	}
 
   private:
@@ -354,60 +427,52 @@ class TeensyRobustModuleLogger final : public LoggerBase
 		}
 	}
 
-	void errorHalt(const char* msg)
+	/// Called by recover()
+	bool reopen_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
-		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
-			{
-				printf("Try power cycling the SD card.\n");
-			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
-		}
-		while(true)
-		{
-		}
+		return this->resume_file(filename_);
 	}
 
 	void writeBufferToSDFile()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(!this->recovery_.available() && !this->recover())
 		{
-			errorHalt("Failed to open file");
+			this->hold_buffer();
+			return;
 		}
 
-		int bytes_written = 0;
+		// Data held while the card was unavailable is written first
+		auto& fallback = this->recovery_.fallback();
 
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
-
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		if(!fallback.empty() &&
+		   !log_sd_retry([&]() { return log_write_buffer(this->file_, fallback, fallback.size()); },
+						 delay))
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written = file_.write(&buffer[tail], log_buffer_.capacity() - tail);
-			bytes_written += file_.write(buffer, head);
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
-		else
+
+		size_t count = this->log_buffer_.size();
+
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(this->preallocated_)
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(&buffer[tail], log_buffer_.size());
+			count -= count % log_sd_sector_size;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		if(!this->write_buffer(count))
 		{
-			errorHalt("Failed to write to log file");
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
 
-		log_buffer_.reset();
-
-		file_.close();
+		if(this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
 	}
 
 	/// Checks the kinetis SoC's reset reason registers and logs them
@@ -423,52 +488,52 @@ class TeensyRobustModuleLogger final : public LoggerBase
 
 		if(srs0 & RCM_SRS0_LVD)
 		{
-			LoggerBase::info("Low-voltage Detect Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Low-voltage Detect Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOL)
 		{
-			LoggerBase::info("Loss of Lock in PLL Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Loss of Lock in PLL Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOC)
 		{
-			LoggerBase::info("Loss of External Clock Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Loss of External Clock Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_WDOG)
 		{
-			LoggerBase::info("Watchdog Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Watchdog Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_PIN)
 		{
-			LoggerBase::info("External Pin Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("External Pin Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_POR)
 		{
-			LoggerBase::info("Power-on Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Power-on Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SACKERR)
 		{
-			LoggerBase::info("Stop Mode Acknowledge Error Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Stop Mode Acknowledge Error Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_MDM_AP)
 		{
-			LoggerBase::info("MDM-AP Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("MDM-AP Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SW)
 		{
-			LoggerBase::info("Software Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Software Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_LOCKUP)
 		{
-			LoggerBase::info("Core Lockup Event Reset\n");
+			LoggerBaseT<TeensyRobustModuleLogger>::info("Core Lockup Event Reset\n");
 		}
 	}
 
@@ -489,9 +554,7 @@ class TeensyRobustModuleLogger final : public LoggerBase
 
   private:
 	/// SD Card Storage
-	SdFs* fs_ = nullptr;
 	char filename_[FILENAME_SIZE];
-	mutable FsFile file_;
 
 	/// EEPROM Log Storage
 	/// This variable indicates whether the class is configured
@@ -508,9 +571,6 @@ class TeensyRobustModuleLogger final : public LoggerBase
 
 	/// Log Levle Module Storage
 	log_level_e module_levels_[TModuleCount] = {log_level_e(LOG_LEVEL)};
-
-	/// Internal RAM log buffer
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
 };
 
 #endif // SD_FILE_LOGGER_H_
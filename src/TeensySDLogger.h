@@ -4,7 +4,8 @@
 #include "Arduino.h"
 #include "ArduinoLogger.h"
 #include "SdFat.h"
-#include "internal/circular_buffer.hpp"
+#include "internal/sd_logging.hpp"
+#include "internal/slot_buffer.hpp"
 #include <kinetis.h>
 
 /** SD File Buffer
@@ -13,142 +14,264 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * Log data is collected in one or more RAM buffers. With a single buffer, logging waits while
+ * the full buffer is written to the SD card. With several buffers, a full buffer is handed off
+ * and logging continues in the next one. Handed-off buffers are written by drain(), which
+ * skips the write while the card is busy, or by flush(). Logging only waits for the SD card
+ * when every buffer is full.
+ *
+ * When auto-flush is disabled and every buffer is full, new data is dropped.
+ *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery) until logging can resume.
+ * If the card needs to be initialized again (e.g., after it was removed), call `sd.begin()`;
+ * the log file is reopened on the next attempt.
+ *
+ * @tparam TBufferSize The size of each buffer, in bytes. Must be a multiple of the 512-byte
+ *	SD sector size.
+ * @tparam TBufferCount The number of buffers. Use 2 or more for double buffering.
+ *
  *	@code
  *	using PlatformLogger =
  *		PlatformLogger_t<TeensySDLogger>;
+ *
+ *	// Double-buffered
+ *	using PlatformLogger =
+ *		PlatformLogger_t<TeensySDLoggerT<1024, 2>>;
  *  @endcode
  *
  * @ingroup LoggingSubsystem
  */
-class TeensySDLogger final : public LoggerBase
+template<size_t TBufferSize = 512, size_t TBufferCount = 1>
+class TeensySDLoggerT final
+	: public SDLoggerBaseT<TeensySDLoggerT<TBufferSize, TBufferCount>,
+						   SlotBuffer<char, TBufferSize, TBufferCount>>
 {
-  private:
-	static constexpr size_t BUFFER_SIZE = 512;
+	using buffer_t = SlotBuffer<char, TBufferSize, TBufferCount>;
+	friend class LoggerBaseT<TeensySDLoggerT<TBufferSize, TBufferCount>>;
+	friend class SDLoggerBaseT<TeensySDLoggerT<TBufferSize, TBufferCount>, buffer_t>;
+	using BaseClass = SDLoggerBaseT<TeensySDLoggerT<TBufferSize, TBufferCount>, buffer_t>;
+
+	static_assert(TBufferSize > 0 && TBufferSize % log_sd_sector_size == 0,
+				  "TBufferSize must be a multiple of the SD sector size");
 
   public:
+	/// Full buffers are never overwritten, so new data is dropped when auto-flush is disabled
+	static constexpr log_full_policy full_policy = log_full_policy::drop_newest;
+
 	/// Default constructor
-	TeensySDLogger() : LoggerBase() {}
+	TeensySDLoggerT() : BaseClass() {}
 
 	/// Default destructor
-	~TeensySDLogger() noexcept = default;
+	~TeensySDLoggerT() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
-		return file_.size();
+		return this->file_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		// size in blocks * bytes per block (512 Bytes = 2^9)
-		return fs_ ? fs_->card()->sectorCount() << 9 : 0;
+		return this->fs_ ? this->fs_->card()->sectorCount() << 9 : 0;
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
-		print("[%d ms] ", millis());
+		this->print("[%d ms] ", millis());
 	}
 
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
-		fs_ = &sd_inst;
+		this->fs_ = &sd_inst;
+		this->preallocated_ = false;
+		this->resume_position_ = 0;
 
-		if(!file_.open(filename_, O_WRITE | O_CREAT))
+		if(!this->file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			errorHalt("Failed to open file");
+			// Logging continues in RAM until the file can be opened
+			this->card_error("Failed to open file");
+
+			// The file is cleared once it can be opened, as if begin() had succeeded
+			this->resume_position_ = 0;
 		}
+		else
+		{
+			this->recovery_.recovered();
 
-		// Clear current file contents
-		file_.truncate(0);
+			// Clear current file contents
+			this->file_.truncate(0);
+
+			// Reserve contiguous clusters, so appending does not need to search the FAT
+			this->preallocated_ = (preallocate > 0) && this->file_.preAllocate(preallocate);
+
+			if(preallocate > 0 && !this->preallocated_)
+			{
+				this->warning("Failed to pre-allocate %lu bytes for the log file\n",
+							  static_cast<unsigned long>(preallocate));
+			}
+		}
 
 		log_reset_reason();
 
 		// Manually flush, since the file is open
-		flush();
+		this->sync();
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
+		this->flush();
+
+		if(this->recovery_.available())
+		{
+			if(!this->write_buffer(this->log_buffer_.size()))
+			{
+				this->card_error("Failed to write to log file");
+			}
+			else if(this->preallocated_ && !this->file_.truncate(this->file_.curPosition()))
+			{
+				this->card_error("Failed to truncate log file");
+			}
+		}
+
+		this->file_.close();
+		this->preallocated_ = false;
+	}
+
+	/** Write the buffers which have been handed off, without waiting for a busy SD card
+	 *
+	 * Call this regularly (e.g., from loop()) when using more than one buffer. Full buffers are
+	 * written while the card is ready. If the card is busy, the call returns without writing.
+	 * The active buffer is left for a later flush(). While the card is unavailable, nothing is
+	 * written; flush() holds the data in RAM and tries to resume logging to the card.
+	 *
+	 * @returns the number of bytes written.
+	 */
+	size_t drain()
+	{
+		size_t written = 0;
 
-		file_.close();
+		// Data held in RAM must be written first, which flush() handles
+		if(!this->recovery_.available() || !this->recovery_.fallback().empty())
+		{
+			return 0;
+		}
+
+		while(this->fs_ && this->log_buffer_.ready() && !this->fs_->card()->isBusy())
+		{
+			typename buffer_t::span full, next;
+			this->log_buffer_.peek_spans(full, next);
+
+			if(!this->write_buffer(full.size))
+			{
+				this->card_error("Failed to write to log file");
+				this->hold_buffer();
+				return written;
+			}
+
+			written += full.size;
+		}
+
+		if(written > 0 && this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
+
+		return written;
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
+	{
+		this->log_buffer_.put(&c, 1);
+	}
+
+	void log_write(const char* str, size_t len) noexcept
 	{
-		log_buffer_.put(c);
+		this->log_buffer_.put(str, len);
 	}
 
-	size_t internal_size() const noexcept override
+	size_t internal_size() const noexcept
 	{
-		return log_buffer_.size();
+		return this->log_buffer_.size();
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_capacity() const noexcept
 	{
-		return log_buffer_.capacity();
+		// Space in a partially-written buffer is not reused until the whole buffer is free
+		return this->log_buffer_.size() + this->log_buffer_.available();
 	}
 
-	void flush_() noexcept final
+	void flush_() noexcept
 	{
 		writeBufferToSDFile();
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
-		log_buffer_.reset();
+		this->log_buffer_.reset();
 	}
 
   private:
-	void errorHalt(const char* msg)
+	/// Called by recover()
+	bool reopen_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
-		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
-			{
-				printf("Try power cycling the SD card.\n");
-			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
-		}
-		while(true)
-		{
-		}
+		return this->resume_file(filename_);
 	}
 
 	void writeBufferToSDFile()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(!this->recovery_.available() && !this->recover())
 		{
-			errorHalt("Failed to open file");
+			this->hold_buffer();
+			return;
 		}
 
-		int bytes_written = 0;
+		// Data held while the card was unavailable is written first
+		auto& fallback = this->recovery_.fallback();
 
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
-
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		if(!fallback.empty() &&
+		   !log_sd_retry([&]() { return log_write_buffer(this->file_, fallback, fallback.size()); },
+						 delay))
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written = file_.write(&buffer[tail], log_buffer_.capacity() - tail);
-			bytes_written += file_.write(buffer, head);
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
-		else
+
+		size_t count = this->log_buffer_.size();
+
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(this->preallocated_)
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(&buffer[tail], log_buffer_.size());
+			count -= count % log_sd_sector_size;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		if(!this->write_buffer(count))
 		{
-			errorHalt("Failed to write to log file");
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
 
-		log_buffer_.reset();
-
-		file_.close();
+		if(this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
 	}
 
 	/// Checks the kinetis SoC's reset reason registers and logs them
@@ -164,61 +287,60 @@ class TeensySDLogger final : public LoggerBase
 
 		if(srs0 & RCM_SRS0_LVD)
 		{
-			info("Low-voltage Detect Reset\n");
+			this->info("Low-voltage Detect Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOL)
 		{
-			info("Loss of Lock in PLL Reset\n");
+			this->info("Loss of Lock in PLL Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOC)
 		{
-			info("Loss of External Clock Reset\n");
+			this->info("Loss of External Clock Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_WDOG)
 		{
-			info("Watchdog Reset\n");
+			this->info("Watchdog Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_PIN)
 		{
-			info("External Pin Reset\n");
+			this->info("External Pin Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_POR)
 		{
-			info("Power-on Reset\n");
+			this->info("Power-on Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SACKERR)
 		{
-			info("Stop Mode Acknowledge Error Reset\n");
+			this->info("Stop Mode Acknowledge Error Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_MDM_AP)
 		{
-			info("MDM-AP Reset\n");
+			this->info("MDM-AP Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SW)
 		{
-			info("Software Reset\n");
+			this->info("Software Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_LOCKUP)
 		{
-			info("Core Lockup Event Reset\n");
+			this->info("Core Lockup Event Reset\n");
 		}
 	}
 
   private:
-	SdFs* fs_;
 	const char* filename_ = "log.txt";
-	mutable FsFile file_;
-
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
 };
 
+/// Single-buffered TeensySDLogger with a 512-byte buffer
+using TeensySDLogger = TeensySDLoggerT<>;
+
 #endif // SD_FILE_LOGGER_H_
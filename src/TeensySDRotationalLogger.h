@@ -1,10 +1,19 @@
 #ifndef SD_FILE_LOGGER_H_
 #define SD_FILE_LOGGER_H_
 
+#ifndef LOG_SD_COMPRESSION
+/// Compress the log file with LogCompressor (internal/log_compression.hpp).
+/// Decompress the file on a host with tools/lz_log.py.
+#define LOG_SD_COMPRESSION false
+#endif
+
 #include "Arduino.h"
 #include "ArduinoLogger.h"
 #include "SdFat.h"
-#include "internal/circular_buffer.hpp"
+#include "internal/log_compression.hpp"
+#include "internal/sd_logging.hpp"
+#include "internal/sd_rotation.hpp"
+#include "internal/slot_buffer.hpp"
 #include <EEPROM.h>
 #include <kinetis.h>
 
@@ -14,152 +23,583 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * If LOG_SD_COMPRESSION is true, each flush is compressed before it is written, and the
+ * file is named `log_N.lz` instead of `log_N.txt`. Repetitive log text is typically 3-6x
+ * smaller, which shortens SD writes. Compression uses an extra ~1.9 KB of RAM (the
+ * compression window, its index, and a block buffer), and size() returns the compressed
+ * size. Compressed blocks are not sector-aligned, but a pre-allocated file still avoids
+ * cluster allocation.
+ *
+ * Log data is buffered as in TeensySDLoggerT: with several buffers, a full buffer is handed
+ * off and written by drain() or flush() while logging continues in the next buffer. When
+ * compression is enabled, each buffer is compressed as a separate block.
+ *
+ * Each call to begin() starts a new file. With a size or age limit in the rotation policy
+ * (see log_rotation_policy), a new file is also started while logging. The new file starts at
+ * a statement boundary. The logging call only marks the boundary: the file is switched by the
+ * next flush(), sync(), or drain() call, so call one of them regularly (e.g., from loop()).
+ * If every buffer fills first, the boundary is dropped and a new one is marked later.
+ *
+ * The file counter is 16 bits wide, stored at EEPROM addresses 4094 (high byte) and 4095
+ * (low byte). Files are numbered 1..9999.
+ *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery). Once the card can be
+ * written again, logging continues in a new file, starting with the held data. If the card
+ * needs to be initialized again (e.g., after it was removed), call `sd.begin()`.
+ *
+ * @tparam TBufferSize The size of each buffer, in bytes. Must be a multiple of the 512-byte
+ *	SD sector size.
+ * @tparam TBufferCount The number of buffers. Use 2 or more for double buffering.
+ *
  *	@code
  *	using PlatformLogger =
  *		PlatformLogger_t<TeensySDRotationalLogger>;
+ *
+ *	// Double-buffered
+ *	using PlatformLogger =
+ *		PlatformLogger_t<TeensySDRotationalLoggerT<1024, 2>>;
  *  @endcode
  *
  * @ingroup LoggingSubsystem
  */
-class TeensySDRotationalLogger final : public LoggerBase
+template<size_t TBufferSize = 512, size_t TBufferCount = 1>
+class TeensySDRotationalLoggerT final
+	: public SDLoggerBaseT<TeensySDRotationalLoggerT<TBufferSize, TBufferCount>,
+						   SlotBuffer<char, TBufferSize, TBufferCount>>
 {
+	using buffer_t = SlotBuffer<char, TBufferSize, TBufferCount>;
+	friend class LoggerBaseT<TeensySDRotationalLoggerT<TBufferSize, TBufferCount>>;
+	friend class SDLoggerBaseT<TeensySDRotationalLoggerT<TBufferSize, TBufferCount>, buffer_t>;
+	using BaseClass = SDLoggerBaseT<TeensySDRotationalLoggerT<TBufferSize, TBufferCount>, buffer_t>;
+
+	static_assert(TBufferSize > 0 && TBufferSize % log_sd_sector_size == 0,
+				  "TBufferSize must be a multiple of the SD sector size");
+	static_assert(!LOG_SD_COMPRESSION || TBufferSize <= 32 * 1024,
+				  "A compressed block holds at most 32 KB of log data");
+
   private:
-	static constexpr size_t BUFFER_SIZE = 512;
 	static constexpr size_t FILENAME_SIZE = 32;
 	static constexpr unsigned EEPROM_LOG_STORAGE_ADDR = 4095;
 
   public:
+	/// Full buffers are never overwritten, so new data is dropped when auto-flush is disabled
+	static constexpr log_full_policy full_policy = log_full_policy::drop_newest;
+
 	/// Default constructor
-	TeensySDRotationalLogger() : LoggerBase() {}
+	TeensySDRotationalLoggerT() : BaseClass() {}
 
 	/// Default destructor
-	~TeensySDRotationalLogger() noexcept = default;
+	~TeensySDRotationalLoggerT() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
-		return file_.size();
+		return this->file_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		// size in blocks * bytes per block (512 Bytes = 2^9)
-		return fs_ ? fs_->card()->sectorCount() << 9 : 0;
+		return this->fs_ ? this->fs_->card()->sectorCount() << 9 : 0;
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
-		print("[%d ms] ", millis());
+		this->print("[%d ms] ", millis());
 	}
 
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
-		fs_ = &sd_inst;
-
-		set_filename();
+		this->fs_ = &sd_inst;
+		preallocate_size_ = preallocate;
+		rotate_pending_ = false;
 
-		if(!file_.open(filename_, O_WRITE | O_CREAT))
+		if(open_file())
 		{
-			errorHalt("Failed to open file");
+			this->recovery_.recovered();
+		}
+		else
+		{
+			// Logging continues in RAM until a file can be opened
+			this->card_error("Failed to open file");
 		}
-
-		// Clear current file contents
-		file_.truncate(0);
 
 		log_reset_reason();
 
 		// Manually flush, since the file is open
+		this->sync();
+	}
+
+	/// Set when a new log file is started, and how many files are kept. See log_rotation_policy.
+	void rotation_policy(const log_rotation_policy& policy) noexcept
+	{
+		rotation_.policy(policy);
+	}
+
+	/// Get the current rotation policy
+	const log_rotation_policy& rotation_policy() const noexcept
+	{
+		return rotation_.policy();
+	}
+
+	/// Write the log buffer to the current file, then continue logging in a new file
+	void rotate()
+	{
+		rotate_pending_ = true;
+		rotate_offset_ = this->log_buffer_.size();
 		flush();
 
-		file_.close();
+		if(rotate_pending_)
+		{
+			rotate_file();
+		}
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
+		rotate_pending_ = false;
+		flush();
+
+		if(this->recovery_.available())
+		{
+			this->write_buffer(this->log_buffer_.size());
+		}
+
+		if(!close_file())
+		{
+			this->card_error("Failed to truncate log file");
+		}
+	}
+
+	/// See SDLoggerBaseT::log(). Marks a rotation once the statement is buffered.
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		// Statements logged by flush() (e.g., the overrun report) are nested in another call
+		bool was_logging = logging_;
+		logging_ = true;
+
+		BaseClass::log(l, fmt, args...);
+
+		mark_rotation();
+		logging_ = was_logging;
+	}
+
+	/// See LoggerBaseT::begin_statement()
+	void begin_statement(log_level_e l) noexcept
+	{
+		logging_ = true;
+		BaseClass::begin_statement(l);
+	}
+
+	/// See SDLoggerBaseT::end_statement(). Marks a rotation once the statement is buffered.
+	void end_statement(log_level_e l) noexcept
+	{
+		BaseClass::end_statement(l);
+		mark_rotation();
+		logging_ = false;
+	}
+
+	/// See LoggerBaseT::flush(). Switches to a new log file if a rotation is pending.
+	void flush() noexcept
+	{
+		BaseClass::flush();
+
+		if(rotate_if_pending())
+		{
+			// Write the data which belongs to the new file
+			BaseClass::flush();
+		}
+	}
+
+	/** Write the buffers which have been handed off, without waiting for a busy SD card
+	 *
+	 * Call this regularly (e.g., from loop()) when using more than one buffer. Full buffers are
+	 * written while the card is ready. If the card is busy, the call returns without writing.
+	 * The active buffer is left for a later flush(). While the card is unavailable, nothing is
+	 * written; flush() holds the data in RAM and tries to resume logging to the card.
+	 *
+	 * @returns the number of bytes taken from the log buffer.
+	 */
+	size_t drain()
+	{
+		size_t written = 0;
+
+		while(this->fs_ && this->log_buffer_.ready() && !this->fs_->card()->isBusy())
+		{
+			rotate_if_pending();
+
+			// Data held in RAM must be written first, which flush() handles
+			if(!this->recovery_.available() || !this->recovery_.fallback().empty())
+			{
+				break;
+			}
+
+			typename buffer_t::span full, next;
+			this->log_buffer_.peek_spans(full, next);
+			written += this->write_buffer(full.size);
+		}
+
+		if(written > 0 && this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
+
+		if(this->fs_ && !this->fs_->card()->isBusy())
+		{
+			rotate_if_pending();
+		}
+
+		return written;
 	}
 
 	// Resets the log file counter back to 1
 	void resetFileCounter()
 	{
-		EEPROM.write(EEPROM_LOG_STORAGE_ADDR, 1);
+		log_write_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR, 1);
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
 	{
-		log_buffer_.put(c);
+		this->log_buffer_.put(&c, 1);
 	}
 
-	size_t internal_size() const noexcept override
+	void log_write(const char* str, size_t len) noexcept
 	{
-		return log_buffer_.size();
+		this->log_buffer_.put(str, len);
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_size() const noexcept
 	{
-		return log_buffer_.capacity();
+		return this->log_buffer_.size();
 	}
 
-	void flush_() noexcept final
+	size_t internal_capacity() const noexcept
+	{
+		// Space in a partially-written buffer is not reused until the whole buffer is free
+		return this->log_buffer_.size() + this->log_buffer_.available();
+	}
+
+	void flush_() noexcept
 	{
 		writeBufferToSDFile();
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
-		log_buffer_.reset();
+		this->log_buffer_.reset();
+		rotate_offset_ = 0;
 	}
 
   private:
-	void errorHalt(const char* msg)
+	/** Called by recover()
+	 *
+	 * Logging continues in the next log file, since the end of the current file may be lost.
+	 */
+	bool reopen_file()
+	{
+		close_file();
+		return open_file();
+	}
+
+	/// Move the log buffer to the RAM ring. Overwritten data is reported as an overrun.
+	void hold_buffer() noexcept
+	{
+		// The held data is written to the next file, so a pending rotation is dropped
+		rotate_pending_ = false;
+		rotate_offset_ = 0;
+
+		BaseClass::hold_buffer();
+	}
+
+	/** Open the next log file and delete the oldest files, according to the rotation policy
+	 *
+	 * The file counter only advances once the file is open.
+	 *
+	 * @returns false if the file could not be opened.
+	 */
+	bool open_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
+		set_filename();
+
+		if(!this->file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
+			return false;
+		}
+
+		log_write_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR,
+							   log_next_file_number(file_number_));
+
+		// Clear current file contents
+		this->file_.truncate(0);
+
+		// Reserve contiguous clusters, so appending does not need to search the FAT
+		this->preallocated_ = (preallocate_size_ > 0) && this->file_.preAllocate(preallocate_size_);
+
+		if(preallocate_size_ > 0 && !this->preallocated_)
+		{
+			this->warning("Failed to pre-allocate %lu bytes for the log file\n",
+						  static_cast<unsigned long>(preallocate_size_));
+		}
+
+#if LOG_SD_COMPRESSION
+		uint8_t header[compressor_t::header_size];
+		compressor_.reset();
+		compressor_.header(header);
+
+		auto write_header = [&]() {
+			return this->file_.seekSet(0) &&
+				   this->file_.write(header, sizeof(header)) == sizeof(header);
+		};
+
+		if(!log_sd_retry(write_header, delay))
+		{
+			return false;
+		}
+#endif
+
+		rotation_.opened(millis());
+		remove_old_files();
+		return true;
+	}
+
+	/** Truncate a pre-allocated log file to the length of the log, and close it
+	 *
+	 * The file is not truncated while the card is unavailable.
+	 *
+	 * @returns false if the file could not be truncated.
+	 */
+	bool close_file()
+	{
+		bool truncated = !this->preallocated_ || !this->recovery_.available() ||
+						 this->file_.truncate(this->file_.curPosition());
+
+		this->file_.close();
+		this->preallocated_ = false;
+
+		return truncated;
+	}
+
+	void writeBufferToSDFile()
+	{
+		if(!this->recovery_.available() && !this->recover())
+		{
+			this->hold_buffer();
+			return;
+		}
+
+		// Data held while the card was unavailable is written first
+		if(!write_data(this->recovery_.fallback(), this->recovery_.fallback().size()))
+		{
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
+		}
+
+		size_t count = this->log_buffer_.size();
+
+		// An auto-flush cannot rotate, since that would stall the logging call. If the buffer
+		// only holds data for the next file, that data goes to the current file instead.
+		if(rotate_pending_ && rotate_offset_ == 0 && logging_)
+		{
+			rotate_pending_ = false;
+		}
+
+#if !LOG_SD_COMPRESSION
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(this->preallocated_ && !rotate_pending_)
+		{
+			count -= count % log_sd_sector_size;
+		}
+#endif
+
+		this->write_buffer(count);
+
+		if(this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
+	}
+
+	/** Write the oldest `count` bytes in the log buffer to the file
+	 *
+	 * While a rotation is pending, only the data which belongs to the current file is written.
+	 * If the write fails, the log buffer is held in RAM until the card is available again.
+	 *
+	 * @returns the number of bytes taken from the log buffer.
+	 */
+	size_t write_buffer(size_t count)
+	{
+		if(rotate_pending_)
+		{
+			count = (count < rotate_offset_) ? count : rotate_offset_;
+			rotate_offset_ -= count;
+		}
+
+		if(!write_data(this->log_buffer_, count))
+		{
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+		}
+
+		return count;
+	}
+
+	/** Write the oldest `count` bytes of a buffer to the file, retrying if a write fails
+	 *
+	 * Data which was written is consumed, so a retry only writes the rest.
+	 *
+	 * @returns true if all `count` bytes were written.
+	 */
+	template<class TBuffer>
+	bool write_data(TBuffer& buffer, size_t count)
+	{
+#if LOG_SD_COMPRESSION
+		// Each buffer is compressed into one block, which is written with a single call
+		while(count > 0)
+		{
+			typename TBuffer::span region, next;
+			buffer.peek_spans(region, next);
+			size_t size = (region.size < count) ? region.size : count;
+			size = (size < TBufferSize) ? size : TBufferSize;
+
+			compressor_.begin_block(compressed_, sizeof(compressed_));
+			compressor_.write(region.data, size);
+			size_t compressed_size = compressor_.end_block();
+			auto position = this->file_.curPosition();
+
+			auto write_block = [&]() {
+				return this->file_.seekSet(position) &&
+					   this->file_.write(compressed_, compressed_size) == compressed_size;
+			};
+
+			// After a failure, the compressor no longer matches the file. Recovery starts a new
+			// file, which also resets the compressor.
+			if(compressed_size == 0 || !log_sd_retry(write_block, delay))
 			{
-				printf("Try power cycling the SD card.\n");
+				return false;
 			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
+
+			buffer.consume(size);
+			count -= size;
 		}
-		while(true)
+
+		return true;
+#else
+		size_t remaining = buffer.size() - count;
+
+		return log_sd_retry(
+			[&]() { return log_write_buffer(this->file_, buffer, buffer.size() - remaining); },
+			delay);
+#endif
+	}
+
+#if LOG_SD_COMPRESSION
+	/** Called by sync_file()
+	 *
+	 * The partial sector is raw text, so it is never written to a compressed file. A compressed
+	 * file always holds whole blocks, and the buffer waits for the next flush.
+	 */
+	bool write_partial_sector() noexcept
+	{
+		return true;
+	}
+#endif
+
+	/** Mark the end of the buffered data as the end of the current file, if it should rotate
+	 *
+	 * The size compared with the policy's max_size is the file position plus the buffered
+	 * data. With LOG_SD_COMPRESSION, the file position is compressed but the buffered data is
+	 * not, so a file rotates once its compressed size plus the uncompressed buffer reaches
+	 * max_size, and the file on the card is usually smaller than max_size.
+	 */
+	void mark_rotation() noexcept
+	{
+		if(!rotate_pending_ && this->file_.isOpen() &&
+		   rotation_.due(this->file_.curPosition() + this->log_buffer_.size(), millis()))
 		{
+			rotate_pending_ = true;
+			rotate_offset_ = this->log_buffer_.size();
 		}
 	}
 
-	void writeBufferToSDFile()
+	/** Switch to the next log file once the current file's data has been written
+	 *
+	 * @returns true if a new file was started.
+	 */
+	bool rotate_if_pending()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(rotate_pending_ && rotate_offset_ == 0 && !logging_ && this->recovery_.available())
 		{
-			errorHalt("Failed to open file");
+			rotate_file();
+			return true;
 		}
 
-		int bytes_written = 0;
+		return false;
+	}
 
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
+	/// Close the current log file and continue logging in the next one
+	void rotate_file()
+	{
+		rotate_pending_ = false;
 
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		if(!close_file())
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written = file_.write(&buffer[tail], log_buffer_.capacity() - tail);
-			bytes_written += file_.write(buffer, head);
+			this->card_error("Failed to truncate log file");
+			return;
 		}
-		else
+
+		if(!open_file())
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(&buffer[tail], log_buffer_.size());
+			this->card_error("Failed to open file");
+			return;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		// Record the new file in the directory
+		this->sync_file();
+	}
+
+	/// Delete the log files older than the number kept by the rotation policy
+	void remove_old_files()
+	{
+		uint16_t max_files = rotation_.policy().max_files;
+
+		if(max_files == 0 || max_files >= log_file_number_max)
 		{
-			errorHalt("Failed to write to log file");
+			return;
 		}
 
-		log_buffer_.reset();
+		// Older files are deleted until a missing number is found. This also removes files
+		// left behind when the policy keeps fewer files than before.
+		char filename[FILENAME_SIZE];
+		uint16_t number = log_previous_file_number(file_number_, max_files);
 
-		file_.close();
+		for(uint16_t i = max_files; i < log_file_number_max; i++)
+		{
+			format_filename(filename, number);
+
+			if(!this->fs_->exists(filename) || !this->fs_->remove(filename))
+			{
+				break;
+			}
+
+			number = log_previous_file_number(number, 1);
+		}
 	}
 
 	/// Checks the kinetis SoC's reset reason registers and logs them
@@ -175,76 +615,92 @@ class TeensySDRotationalLogger final : public LoggerBase
 
 		if(srs0 & RCM_SRS0_LVD)
 		{
-			info("Low-voltage Detect Reset\n");
+			this->info("Low-voltage Detect Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOL)
 		{
-			info("Loss of Lock in PLL Reset\n");
+			this->info("Loss of Lock in PLL Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOC)
 		{
-			info("Loss of External Clock Reset\n");
+			this->info("Loss of External Clock Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_WDOG)
 		{
-			info("Watchdog Reset\n");
+			this->info("Watchdog Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_PIN)
 		{
-			info("External Pin Reset\n");
+			this->info("External Pin Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_POR)
 		{
-			info("Power-on Reset\n");
+			this->info("Power-on Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SACKERR)
 		{
-			info("Stop Mode Acknowledge Error Reset\n");
+			this->info("Stop Mode Acknowledge Error Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_MDM_AP)
 		{
-			info("MDM-AP Reset\n");
+			this->info("MDM-AP Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SW)
 		{
-			info("Software Reset\n");
+			this->info("Software Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_LOCKUP)
 		{
-			info("Core Lockup Event Reset\n");
+			this->info("Core Lockup Event Reset\n");
 		}
 	}
 
 	void set_filename()
 	{
-		uint8_t value = EEPROM.read(EEPROM_LOG_STORAGE_ADDR);
-
-		// 0xFF indicates a byte that's been reset, or value 255. Either way, reset to 0.
-		if(value == 0xFF)
-		{
-			value = 1;
-		}
-
-		snprintf(filename_, FILENAME_SIZE, "log_%d.txt", value);
+		file_number_ = log_read_file_counter(EEPROM, EEPROM_LOG_STORAGE_ADDR);
+		format_filename(filename_, file_number_);
+	}
 
-		EEPROM.write(EEPROM_LOG_STORAGE_ADDR, value + 1);
+	void format_filename(char* filename, uint16_t number)
+	{
+#if LOG_SD_COMPRESSION
+		snprintf(filename, FILENAME_SIZE, "log_%u.lz", static_cast<unsigned>(number));
+#else
+		snprintf(filename, FILENAME_SIZE, "log_%u.txt", static_cast<unsigned>(number));
+#endif
 	}
 
   private:
-	SdFs* fs_;
 	char filename_[FILENAME_SIZE];
-	mutable FsFile file_;
 
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
+	uint32_t preallocate_size_ = 0;
+
+	log_rotation_tracker rotation_;
+	uint16_t file_number_ = 0;
+	/// Set while a statement is logged, so rotation waits for a flush outside of log()
+	bool logging_ = false;
+	bool rotate_pending_ = false;
+	/// The number of buffered bytes which belong to the current file
+	size_t rotate_offset_ = 0;
+
+#if LOG_SD_COMPRESSION
+	using compressor_t = LogCompressor<>;
+
+	compressor_t compressor_;
+	uint8_t compressed_[compressor_t::max_block_size(TBufferSize)];
+#endif
 };
 
+/// Single-buffered TeensySDRotationalLogger with a 512-byte buffer
+using TeensySDRotationalLogger = TeensySDRotationalLoggerT<>;
+
 #endif // SD_FILE_LOGGER_H_
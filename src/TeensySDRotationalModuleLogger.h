@@ -5,6 +5,7 @@
 #include "ArduinoLogger.h"
 #include "SdFat.h"
 #include "internal/circular_buffer.hpp"
+#include "internal/sd_logging.hpp"
 #include <EEPROM.h>
 #include <kinetis.h>
 
@@ -16,6 +17,11 @@
  *
  * This class uses the SdFat Arduino Library.
  *
+ * SD errors do not halt the program. A failed write is retried, and if the card is still
+ * unavailable, log data is held in a RAM ring (see log_sd_recovery) until logging can resume.
+ * If the card needs to be initialized again (e.g., after it was removed), call `sd.begin()`;
+ * the log file is reopened on the next attempt.
+ *
  * NOTE that module APIs are not routed to the global instance manager,
  * so you cannot use that class or the macros with this strategy.
  * You can implement your own that forwards the appropriate APIs, however.
@@ -31,56 +37,113 @@
  * @ingroup LoggingSubsystem
  */
 template<size_t TModuleCount = 1>
-class TeensySDRotationalModuleLogger final : public LoggerBase
+class TeensySDRotationalModuleLogger final
+	: public SDLoggerBaseT<TeensySDRotationalModuleLogger<TModuleCount>,
+						   CircularBuffer<char, 512>>
 {
+	friend class LoggerBaseT<TeensySDRotationalModuleLogger<TModuleCount>>;
+	friend class SDLoggerBaseT<TeensySDRotationalModuleLogger<TModuleCount>,
+							   CircularBuffer<char, 512>>;
+	using BaseClass =
+		SDLoggerBaseT<TeensySDRotationalModuleLogger<TModuleCount>, CircularBuffer<char, 512>>;
+
   private:
-	static constexpr size_t BUFFER_SIZE = 512;
 	static constexpr size_t FILENAME_SIZE = 32;
 	static constexpr unsigned EEPROM_LOG_STORAGE_ADDR = 4095;
 
   public:
 	/// Default constructor
-	TeensySDRotationalModuleLogger() : LoggerBase() {}
+	TeensySDRotationalModuleLogger() : BaseClass() {}
 
 	/// Default destructor
 	~TeensySDRotationalModuleLogger() noexcept = default;
 
-	size_t size() const noexcept final
+	size_t size() const noexcept
 	{
-		return file_.size();
+		return this->file_.size();
 	}
 
-	size_t capacity() const noexcept final
+	size_t capacity() const noexcept
 	{
 		// size in blocks * bytes per block (512 Bytes = 2^9)
-		return fs_ ? fs_->card()->sectorCount() << 9 : 0;
+		return this->fs_ ? this->fs_->card()->sectorCount() << 9 : 0;
 	}
 
-	void log_customprefix() noexcept final
+	void log_customprefix() noexcept
 	{
-		print("[%d ms] ", millis());
+		this->print("[%d ms] ", millis());
 	}
 
-	void begin(SdFs& sd_inst)
+	/** Open a new log file and start logging to it
+	 *
+	 * @param sd_inst The SD card's file system.
+	 * @param preallocate If nonzero, this many bytes of contiguous clusters are reserved for
+	 *	the log file, so writes never wait for cluster allocation. The log is then written in
+	 *	whole 512-byte sectors, and the file is truncated to the length of the log by end().
+	 */
+	void begin(SdFs& sd_inst, uint32_t preallocate = LOG_SD_PREALLOCATE_SIZE)
 	{
-		fs_ = &sd_inst;
+		this->fs_ = &sd_inst;
+		this->preallocated_ = false;
+		this->resume_position_ = 0;
 
 		set_filename();
 
-		if(!file_.open(filename_, O_WRITE | O_CREAT))
+		if(!this->file_.open(filename_, O_WRITE | O_CREAT))
 		{
-			errorHalt("Failed to open file");
+			// Logging continues in RAM until the file can be opened
+			this->card_error("Failed to open file");
+
+			// The file is cleared once it can be opened, as if begin() had succeeded
+			this->resume_position_ = 0;
 		}
+		else
+		{
+			this->recovery_.recovered();
+
+			// Clear current file contents
+			this->file_.truncate(0);
 
-		// Clear current file contents
-		file_.truncate(0);
+			// Reserve contiguous clusters, so appending does not need to search the FAT
+			this->preallocated_ = (preallocate > 0) && this->file_.preAllocate(preallocate);
+
+			if(preallocate > 0 && !this->preallocated_)
+			{
+				BaseClass::warning("Failed to pre-allocate %lu bytes for the log file\n",
+								   static_cast<unsigned long>(preallocate));
+			}
+		}
 
 		log_reset_reason();
 
 		// Manually flush, since the file is open
-		flush();
+		this->sync();
+	}
+
+	/** Write the log buffer and close the log file
+	 *
+	 * A pre-allocated file is truncated to the length of the log. Call begin() to start
+	 * logging again. If the card is unavailable, the log data stays in RAM, and is written
+	 * once logging resumes.
+	 */
+	void end()
+	{
+		this->flush();
 
-		file_.close();
+		if(this->recovery_.available())
+		{
+			if(!this->write_buffer(this->log_buffer_.size()))
+			{
+				this->card_error("Failed to write to log file");
+			}
+			else if(this->preallocated_ && !this->file_.truncate(this->file_.curPosition()))
+			{
+				this->card_error("Failed to truncate log file");
+			}
+		}
+
+		this->file_.close();
+		this->preallocated_ = false;
 	}
 
 	// Resets the log file counter back to 1
@@ -121,14 +184,14 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	/// the global log level
 	log_level_e level(log_level_e l) noexcept
 	{
-		return LoggerBase::level(l);
+		return LoggerBaseT<TeensySDRotationalModuleLogger>::level(l);
 	}
 
 	/// Get the log level for ALL modules
 	/// We need to forward this version to the base class version
 	log_level_e level() const noexcept
 	{
-		return LoggerBase::level();
+		return LoggerBaseT<TeensySDRotationalModuleLogger>::level();
 	}
 
 	/// The following overrides should be used to log with module IDs
@@ -138,7 +201,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::critical)
 		{
-			log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -147,7 +210,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::critical)
 		{
-			log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::critical, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -156,7 +219,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::error)
 		{
-			log(log_level_e::error, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::error, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -165,7 +228,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::error)
 		{
-			log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::error, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -174,7 +237,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::warning)
 		{
-			log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -183,7 +246,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::warning)
 		{
-			log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::warning, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -192,7 +255,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::info)
 		{
-			log(log_level_e::info, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::info, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -201,7 +264,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::info)
 		{
-			log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::info, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -210,7 +273,7 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::debug)
 		{
-			log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+			this->log(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
@@ -219,91 +282,88 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	{
 		if(module_levels_[module_id] >= log_level_e::debug)
 		{
-			log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
+			this->log_interrupt(log_level_e::debug, fmt, std::forward<const Args>(args)...);
 		}
 	}
 
   protected:
-	void log_putc(char c) noexcept final
+	void log_putc(char c) noexcept
+	{
+		this->log_buffer_.put(c);
+	}
+
+	void log_write(const char* str, size_t len) noexcept
 	{
-		log_buffer_.put(c);
+		this->log_buffer_.put(str, len);
 	}
 
-	size_t internal_size() const noexcept override
+	size_t internal_size() const noexcept
 	{
-		return log_buffer_.size();
+		return this->log_buffer_.size();
 	}
 
-	size_t internal_capacity() const noexcept override
+	size_t internal_capacity() const noexcept
 	{
-		return log_buffer_.capacity();
+		return this->log_buffer_.capacity();
 	}
 
-	void flush_() noexcept final
+	void flush_() noexcept
 	{
 		writeBufferToSDFile();
 	}
 
-	void clear_() noexcept final
+	void clear_() noexcept
 	{
-		log_buffer_.reset();
+		this->log_buffer_.reset();
 	}
 
   private:
-	void errorHalt(const char* msg)
+	/// Called by recover()
+	bool reopen_file()
 	{
-		printf("Error: %s\n", msg);
-		if(fs_->sdErrorCode())
-		{
-			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
-			{
-				printf("Try power cycling the SD card.\n");
-			}
-			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
-			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
-		}
-		while(true)
-		{
-		}
+		return this->resume_file(filename_);
 	}
 
 	void writeBufferToSDFile()
 	{
-		if(!file_.open(filename_, O_WRITE | O_APPEND))
+		if(!this->recovery_.available() && !this->recover())
 		{
-			errorHalt("Failed to open file");
+			this->hold_buffer();
+			return;
 		}
 
-		int bytes_written = 0;
-
-		// We need to get the front, the rear, and potentially write the files in two steps
-		// to prevent ordering problems
-		size_t head = log_buffer_.head();
-		size_t tail = log_buffer_.tail();
-		const char* buffer = log_buffer_.storage();
+		// Data held while the card was unavailable is written first
+		auto& fallback = this->recovery_.fallback();
 
-		if((head < tail) || ((tail > 0) && (log_buffer_.size() == log_buffer_.capacity())))
+		if(!fallback.empty() &&
+		   !log_sd_retry([&]() { return log_write_buffer(this->file_, fallback, fallback.size()); },
+						 delay))
 		{
-			// we have a wraparound case
-			// We will write from buffer[tail] to buffer[size] in one go
-			// Then we'll reset head to 0 so that we can write 0 to tail next
-			bytes_written = file_.write(&buffer[tail], log_buffer_.capacity() - tail);
-			bytes_written += file_.write(buffer, head);
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
-		else
+
+		size_t count = this->log_buffer_.size();
+
+		// A pre-allocated file is only written in whole sectors. The partial sector at the end
+		// stays in the buffer until it is complete, or until the file is synced.
+		if(this->preallocated_)
 		{
-			// Write from tail position and send the specified number of bytes
-			bytes_written = file_.write(&buffer[tail], log_buffer_.size());
+			count -= count % log_sd_sector_size;
 		}
 
-		if(static_cast<size_t>(bytes_written) != log_buffer_.size())
+		if(!this->write_buffer(count))
 		{
-			errorHalt("Failed to write to log file");
+			this->card_error("Failed to write to log file");
+			this->hold_buffer();
+			return;
 		}
 
-		log_buffer_.reset();
-
-		file_.close();
+		if(this->sync_.flushed(millis()))
+		{
+			this->sync_file();
+		}
 	}
 
 	/// Checks the kinetis SoC's reset reason registers and logs them
@@ -319,52 +379,52 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 
 		if(srs0 & RCM_SRS0_LVD)
 		{
-			LoggerBase::info("Low-voltage Detect Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Low-voltage Detect Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOL)
 		{
-			LoggerBase::info("Loss of Lock in PLL Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Loss of Lock in PLL Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_LOC)
 		{
-			LoggerBase::info("Loss of External Clock Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Loss of External Clock Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_WDOG)
 		{
-			LoggerBase::info("Watchdog Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Watchdog Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_PIN)
 		{
-			LoggerBase::info("External Pin Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("External Pin Reset\n");
 		}
 
 		if(srs0 & RCM_SRS0_POR)
 		{
-			LoggerBase::info("Power-on Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Power-on Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SACKERR)
 		{
-			LoggerBase::info("Stop Mode Acknowledge Error Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Stop Mode Acknowledge Error Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_MDM_AP)
 		{
-			LoggerBase::info("MDM-AP Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("MDM-AP Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_SW)
 		{
-			LoggerBase::info("Software Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Software Reset\n");
 		}
 
 		if(srs1 & RCM_SRS1_LOCKUP)
 		{
-			LoggerBase::info("Core Lockup Event Reset\n");
+			LoggerBaseT<TeensySDRotationalModuleLogger>::info("Core Lockup Event Reset\n");
 		}
 	}
 
@@ -384,13 +444,9 @@ class TeensySDRotationalModuleLogger final : public LoggerBase
 	}
 
   private:
-	SdFs* fs_;
 	char filename_[FILENAME_SIZE];
-	mutable FsFile file_;
 
 	log_level_e module_levels_[TModuleCount] = {log_level_e(LOG_LEVEL)};
-
-	CircularBuffer<char, BUFFER_SIZE> log_buffer_;
 };
 
 #endif // SD_FILE_LOGGER_H_
@@ -0,0 +1,362 @@
+#ifndef TOKENIZED_LOG_BUFFER_LOGGER_H_
+#define TOKENIZED_LOG_BUFFER_LOGGER_H_
+
+// By default, this logging strategy does not auto-flush
+// You can still override this default setting if desired.
+#ifndef LOG_AUTOFLUSH_DEFAULT
+#define LOG_AUTOFLUSH_DEFAULT false
+#endif
+
+#ifndef LOG_TOKENIZED_MAX_RECORD_SIZE
+/// Maximum size of a single tokenized record (header + encoded arguments), in bytes.
+/// Must be less than 256. String arguments are truncated to fit.
+#if defined(__AVR__)
+#define LOG_TOKENIZED_MAX_RECORD_SIZE 64
+#else
+#define LOG_TOKENIZED_MAX_RECORD_SIZE 255
+#endif
+#endif
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#endif
+#include "ArduinoLogger.h"
+#include "internal/circular_buffer.hpp"
+#include "internal/log_args.hpp"
+
+/** Tokenized log buffer
+ *
+ * Log statements are stored as binary records which identify the format string by its
+ * token (see log_token()) instead of its text. The level is stored as a number rather than
+ * as the prefix text. flush() sends the binary records to the console with _putchar().
+ * tools/tokenized_log.py rebuilds the text from a dictionary of the format strings used
+ * by your program.
+ *
+ * Tokens are computed at compile time when the logging macros are used with
+ * LOG_TOKENIZE_MACROS set to true. Other calls compute the token when the statement is
+ * logged.
+ *
+ * Record layout (multi-byte values are little-endian):
+ *
+ * | Offset | Size | Contents                                   |
+ * |--------|------|--------------------------------------------|
+ * | 0      | 1    | Sync byte (0x1E)                           |
+ * | 1      | 1    | Total record length, including this header |
+ * | 2      | 1    | Log level (0 for print())                  |
+ * | 3      | 4    | Format string token                        |
+ * | 7      | 4    | Timestamp, from LOG_TIMESTAMP()            |
+ * | 11     | ...  | Encoded arguments (see log_args.hpp)       |
+ *
+ * Records are added whole. By default, when the buffer is full and auto-flush is disabled,
+ * the newest record is dropped and an overrun is reported. With the overwrite_oldest policy,
+ * whole records are evicted from the start of the buffer instead.
+ *
+ * log_interrupt() encodes the record on the interrupt's stack and adds it to the interrupt
+ * queue, so interrupts never call printf(). The main context copies queued records into the
+ * log buffer at the start of the next log() or flush() call.
+ *
+ * @tparam TBufferSize Defines the size of the circular log buffer.
+ * @tparam TFullPolicy Behavior when the buffer is full. See log_full_policy.
+ *
+ *	@code
+ *	#define LOG_TOKENIZE_MACROS true
+ *	#include <TokenizedLogBufferLogger.h>
+ *
+ *	using PlatformLogger =
+ *		PlatformLogger_t<TokenizedLogBufferLogger<1024>>;
+ *  @endcode
+ *
+ * @ingroup LoggingSubsystem
+ */
+template<size_t TBufferSize = (1 * 1024),
+		 log_full_policy TFullPolicy = log_full_policy::drop_newest>
+class TokenizedLogBufferLogger final
+	: public LoggerBaseT<TokenizedLogBufferLogger<TBufferSize, TFullPolicy>>
+{
+	friend class LoggerBaseT<TokenizedLogBufferLogger<TBufferSize, TFullPolicy>>;
+
+  public:
+	/// Behavior when the log buffer is full
+	static constexpr log_full_policy full_policy = TFullPolicy;
+
+	/// Records hold a token and arguments instead of formatted text
+	static constexpr bool accepts_statements = false;
+
+	/// Marks the start of each record in the output stream
+	static constexpr uint8_t RECORD_SYNC = 0x1E;
+	/// Size of the fixed portion of each record
+	static constexpr size_t RECORD_HEADER_SIZE = 11;
+
+	/// Default constructor
+	TokenizedLogBufferLogger() : LoggerBaseT<TokenizedLogBufferLogger>() {}
+
+	/** Initialize the tokenized log buffer with options
+	 *
+	 * @param enable If true, log statements will be output to the log buffer. If false,
+	 * logging will be disabled and log statements will not be output to the log buffer.
+	 * @param l Runtime log filtering level. Levels greater than the target will not be output
+	 * to the log buffer.
+	 * @param echo If true, log statements will be logged and printed to the console with printf().
+	 * If false, log statements will only be added to the log buffer.
+	 */
+	explicit TokenizedLogBufferLogger(bool enable, log_level_e l = LOG_LEVEL_LIMIT(),
+									  bool echo = LOG_ECHO_EN_DEFAULT) noexcept
+		: LoggerBaseT<TokenizedLogBufferLogger>(enable, l, echo)
+	{
+	}
+
+	/// Default destructor
+	~TokenizedLogBufferLogger() noexcept = default;
+
+	size_t size() const noexcept
+	{
+		return log_buffer_.size();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return log_buffer_.capacity();
+	}
+
+	/** Add a tokenized record to the log buffer
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param token The token for `fmt`, as computed by LOG_TOKEN().
+	 * @param fmt The log format string. Only used for echo.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_tokenized(log_level_e l, uint32_t token, const char* fmt, const Args&... args) noexcept
+	{
+		if(this->enabled() && l <= this->level())
+		{
+			// Keep statements from interrupts in order with this one
+			this->drain_interrupt_queue();
+			add_record(l, token, args...);
+
+			if(this->echo())
+			{
+				const char* prefix = LOG_LEVEL_TO_SHORT_C_STRING(l);
+				this->log_echo(prefix, strlen(prefix));
+				this->log_echo_print(fmt, args...);
+			}
+		}
+	}
+
+	/// Add a record to the log buffer, computing the format string token at run-time
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		log_tokenized(l, log_token(fmt), fmt, args...);
+	}
+
+	/** Add a tokenized record from an interrupt context
+	 *
+	 * The record is encoded on the caller's stack and added to the interrupt queue. See
+	 * LoggerBaseT::log_interrupt().
+	 *
+	 * @param l The log level associated with this statement.
+	 * @param fmt The log format string. Must remain valid until the record is flushed, since
+	 *	it is used to echo the record.
+	 * @param args The variadic arguments that are associated with the format string.
+	 */
+	template<typename... Args>
+	void log_interrupt(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+		if(this->enabled() && l <= this->level())
+		{
+			// The queued record starts with what is needed to echo it
+			uint8_t record[interrupt_record_size];
+			interrupt_header header = {fmt, &log_args::render_args<Args...>};
+			memcpy(record, &header, sizeof(header));
+
+			size_t length = encode_record(record + sizeof(header), sizeof(record) - sizeof(header),
+										  l, log_token(fmt), args...);
+			this->queue_interrupt_record(record, (length > 0) ? sizeof(header) + length : 0);
+		}
+#else
+		LoggerBaseT<TokenizedLogBufferLogger>::log_interrupt(l, fmt, args...);
+#endif
+	}
+
+	/// Prints directly to the log with no extra characters added to the message.
+	template<typename... Args>
+	void print(const char* fmt, const Args&... args) noexcept
+	{
+		add_record(log_level_e::off, log_token(fmt), args...);
+
+		if(this->echo())
+		{
+			this->log_echo_print(fmt, args...);
+		}
+	}
+
+  protected:
+	void flush_() noexcept
+	{
+		while(!log_buffer_.empty())
+		{
+			_putchar(static_cast<char>(log_buffer_.get()));
+		}
+	}
+
+	void clear_() noexcept
+	{
+		log_buffer_.reset();
+	}
+
+	/// Copy a record queued by log_interrupt() into the log buffer
+	void log_interrupt_record(const char* data, size_t len) noexcept
+	{
+		interrupt_header header;
+		memcpy(&header, data, sizeof(header));
+		const uint8_t* record = reinterpret_cast<const uint8_t*>(data) + sizeof(header);
+
+		if(!put_record(record, len - sizeof(header)))
+		{
+			return;
+		}
+
+		if(this->echo())
+		{
+			char buffer[LOG_STAGING_BUFFER_SIZE];
+			LogStagingBuffer stage(buffer, sizeof(buffer),
+								   &LoggerBaseT<TokenizedLogBufferLogger>::log_echo_bounce, this);
+			stage.puts(LOG_LEVEL_TO_SHORT_C_STRING(static_cast<log_level_e>(record[2])));
+			header.render(&LogStagingBuffer::putc_bounce, &stage, header.fmt,
+						  record + RECORD_HEADER_SIZE);
+			stage.commit();
+		}
+	}
+
+  private:
+	static_assert(LOG_TOKENIZED_MAX_RECORD_SIZE > RECORD_HEADER_SIZE &&
+					  LOG_TOKENIZED_MAX_RECORD_SIZE <= UINT8_MAX,
+				  "LOG_TOKENIZED_MAX_RECORD_SIZE must be between the header size and 255");
+
+	/// Stored in front of a record queued by log_interrupt(), so the record can be echoed
+	struct interrupt_header
+	{
+		const char* fmt;
+		log_args::render_fn render;
+	};
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+	/// Records from log_interrupt() must also fit in the interrupt queue
+	static constexpr size_t interrupt_record_size =
+		(sizeof(interrupt_header) + LOG_TOKENIZED_MAX_RECORD_SIZE <
+		 LoggerBaseT<TokenizedLogBufferLogger>::interrupt_record_size)
+			? sizeof(interrupt_header) + LOG_TOKENIZED_MAX_RECORD_SIZE
+			: LoggerBaseT<TokenizedLogBufferLogger>::interrupt_record_size;
+#endif
+
+	template<typename... Args>
+	void add_record(log_level_e l, uint32_t token, const Args&... args) noexcept
+	{
+		uint8_t record[LOG_TOKENIZED_MAX_RECORD_SIZE];
+		size_t length = encode_record(record, sizeof(record), l, token, args...);
+
+		if(length == 0)
+		{
+			// The arguments can never fit in a record
+			this->mark_overrun(0, 1);
+			return;
+		}
+
+		put_record(record, length);
+	}
+
+	/** Encode a record. Does not modify the logger, so it is safe to call from an interrupt.
+	 *
+	 * @returns the length of the record, or 0 if the arguments do not fit in `size` bytes.
+	 */
+	template<typename... Args>
+	static size_t encode_record(uint8_t* record, size_t size, log_level_e l, uint32_t token,
+								const Args&... args) noexcept
+	{
+		if(size <= RECORD_HEADER_SIZE)
+		{
+			return 0;
+		}
+
+		uint8_t* dst = &record[RECORD_HEADER_SIZE];
+		size_t avail = size - RECORD_HEADER_SIZE;
+
+		if(!log_args::pack<Args...>::encode(dst, avail, args...))
+		{
+			return 0;
+		}
+
+		uint32_t timestamp = static_cast<uint32_t>(LOG_TIMESTAMP());
+		size_t length = static_cast<size_t>(dst - record);
+
+		record[0] = RECORD_SYNC;
+		record[1] = static_cast<uint8_t>(length);
+		record[2] = static_cast<uint8_t>(l);
+		memcpy(&record[3], &token, sizeof(token));
+		memcpy(&record[7], &timestamp, sizeof(timestamp));
+
+		return length;
+	}
+
+	/// Add an encoded record to the log buffer. Returns false if the record was dropped.
+	bool put_record(const uint8_t* record, size_t length) noexcept
+	{
+		if(!make_room(length))
+		{
+			// Records are only added whole: we drop the newest record rather than
+			// overwriting part of an older one, which could not be decoded.
+			this->mark_overrun(length, 1);
+			return false;
+		}
+
+		log_buffer_.put(record, length);
+		this->track_occupancy();
+		return true;
+	}
+
+	/** Free space for a new record according to the full-buffer policy
+	 *
+	 * @param length The size of the new record.
+	 * @returns true if there is room for the new record.
+	 */
+	bool make_room(size_t length) noexcept
+	{
+		if(available() < length && this->flush_when_full())
+		{
+			this->flush();
+		}
+
+		if(full_policy == log_full_policy::overwrite_oldest)
+		{
+			while(available() < length && !log_buffer_.empty())
+			{
+				this->mark_overrun(drop_oldest(), 1);
+			}
+		}
+
+		return available() >= length;
+	}
+
+	/// Remove the oldest record. Returns the size of the record.
+	size_t drop_oldest() noexcept
+	{
+		log_buffer_.get(); // Sync byte
+		size_t length = log_buffer_.get();
+
+		log_buffer_.consume(length - 2);
+
+		return length;
+	}
+
+	size_t available() const noexcept
+	{
+		return log_buffer_.capacity() - log_buffer_.size();
+	}
+
+  private:
+	CircularBuffer<uint8_t, TBufferSize> log_buffer_;
+};
+
+#endif // TOKENIZED_LOG_BUFFER_LOGGER_H_
@@ -1,7 +1,60 @@
+#ifndef CIRCULAR_BUFFER_HPP_
+#define CIRCULAR_BUFFER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Compile-time type selection (<type_traits> is not available on AVR)
+template<bool TCondition, class TTrue, class TFalse>
+struct circular_buffer_select
+{
+	using type = TTrue;
+};
+
+template<class TTrue, class TFalse>
+struct circular_buffer_select<false, TTrue, TFalse>
+{
+	using type = TFalse;
+};
+
+/// The smallest unsigned type which can hold an index into a buffer of TCount elements
+template<size_t TCount>
+struct circular_buffer_index
+{
+	using type = typename circular_buffer_select<
+		(TCount - 1 <= UINT8_MAX), uint8_t,
+		typename circular_buffer_select<
+			(TCount - 1 <= UINT16_MAX), uint16_t,
+			typename circular_buffer_select<(TCount - 1 <= UINT32_MAX), uint32_t,
+											size_t>::type>::type>::type;
+};
+
+/** Fixed-size circular buffer
+ *
+ * When the buffer is full, new elements overwrite the oldest elements.
+ *
+ * Elements are copied with memcpy(), so T must be trivially copyable.
+ *
+ * @tparam T The element type.
+ * @tparam TCount The number of elements in the buffer. Indices are wrapped with a mask
+ *	instead of a division when TCount is a power of 2, and they are stored in the smallest
+ *	type which can hold them (e.g., uint8_t for up to 256 elements), which keeps index
+ *	arithmetic cheap on 8-bit targets.
+ */
 template<class T, size_t TCount>
 class CircularBuffer
 {
+	using index_t = typename circular_buffer_index<TCount>::type;
+
   public:
+	/// A contiguous region of the buffer's storage
+	struct span
+	{
+		const T* data;
+		size_t size;
+	};
+
 	CircularBuffer() = default;
 
 	void put(T item)
@@ -10,14 +63,44 @@ class CircularBuffer
 
 		if(full_)
 		{
-			tail_ = (tail_ + 1) % max_size_;
+			tail_ = wrap(tail_ + 1);
 		}
 
-		head_ = (head_ + 1) % max_size_;
+		head_ = wrap(head_ + 1);
 
 		full_ = head_ == tail_;
 	}
 
+	/** Add several elements
+	 *
+	 * The elements are copied in at most two segments. If there is not enough space, the
+	 * oldest elements are overwritten. If `count` exceeds the capacity, only the last
+	 * TCount elements are kept.
+	 */
+	void put(const T* items, size_t count)
+	{
+		if(count > TCount)
+		{
+			items += count - TCount;
+			count = TCount;
+		}
+
+		size_t stored = size();
+		size_t to_end = TCount - head_;
+		size_t first = (count < to_end) ? count : to_end;
+
+		memcpy(&buf_[head_], items, first * sizeof(T));
+		memcpy(&buf_[0], items + first, (count - first) * sizeof(T));
+		head_ = wrap(head_ + count);
+
+		if(stored + count >= TCount)
+		{
+			// The oldest elements were overwritten
+			tail_ = head_;
+			full_ = true;
+		}
+	}
+
 	T get()
 	{
 		if(empty())
@@ -28,11 +111,69 @@ class CircularBuffer
 		// Read data and advance the tail (we now have a free space)
 		auto val = buf_[tail_];
 		full_ = false;
-		tail_ = (tail_ + 1) % max_size_;
+		tail_ = wrap(tail_ + 1);
 
 		return val;
 	}
 
+	/** Remove several elements
+	 *
+	 * The elements are copied in at most two segments.
+	 *
+	 * @returns the number of elements which were copied into `items`, up to `count`.
+	 */
+	size_t get(T* items, size_t count)
+	{
+		span first;
+		span second;
+		size_t stored = peek_spans(first, second);
+		count = (count < stored) ? count : stored;
+
+		size_t first_count = (count < first.size) ? count : first.size;
+		memcpy(items, first.data, first_count * sizeof(T));
+		memcpy(items + first_count, second.data, (count - first_count) * sizeof(T));
+		consume(count);
+
+		return count;
+	}
+
+	/** Get the stored elements without removing them
+	 *
+	 * The stored elements are returned as at most two contiguous regions of the buffer's
+	 * storage, oldest first. `second` is only used when the stored elements wrap around the
+	 * end of the storage; otherwise its size is 0.
+	 *
+	 * The regions remain valid until the buffer is modified. Use consume() to remove the
+	 * elements which have been read.
+	 *
+	 * @returns the total number of elements in both regions.
+	 */
+	size_t peek_spans(span& first, span& second) const
+	{
+		size_t count = size();
+		size_t to_end = TCount - tail_;
+
+		first.data = &buf_[tail_];
+		first.size = (count < to_end) ? count : to_end;
+		second.data = &buf_[0];
+		second.size = count - first.size;
+
+		return count;
+	}
+
+	/// Remove up to `count` elements from the front of the buffer
+	void consume(size_t count)
+	{
+		size_t stored = size();
+		count = (count < stored) ? count : stored;
+
+		if(count > 0)
+		{
+			tail_ = wrap(tail_ + count);
+			full_ = false;
+		}
+	}
+
 	void reset()
 	{
 		head_ = tail_;
@@ -53,12 +194,12 @@ class CircularBuffer
 
 	size_t capacity() const
 	{
-		return max_size_;
+		return TCount;
 	}
 
 	size_t size() const
 	{
-		size_t size = max_size_;
+		size_t size = TCount;
 
 		if(!full_)
 		{
@@ -68,7 +209,7 @@ class CircularBuffer
 			}
 			else
 			{
-				size = max_size_ + head_ - tail_;
+				size = TCount + head_ - tail_;
 			}
 		}
 
@@ -91,9 +232,19 @@ class CircularBuffer
 	}
 
   private:
-	size_t head_ = 0;
-	size_t tail_ = 0;
-	const size_t max_size_ = TCount;
+	static constexpr bool is_power_of_2 = (TCount & (TCount - 1)) == 0;
+
+	/// Wrap an index into the buffer. The branch is resolved at compile time.
+	static index_t wrap(size_t index)
+	{
+		return static_cast<index_t>(is_power_of_2 ? (index & (TCount - 1)) : (index % TCount));
+	}
+
+  private:
+	index_t head_ = 0;
+	index_t tail_ = 0;
 	bool full_ = 0;
 	T buf_[TCount];
 };
+
+#endif // CIRCULAR_BUFFER_HPP_
@@ -0,0 +1,249 @@
+#ifndef CONCURRENT_LOGGING_HPP_
+#define CONCURRENT_LOGGING_HPP_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Helpers shared by the strategies which accept log statements from multiple threads.
+ *
+ * These strategies format each statement into a stack record on the calling thread (see
+ * log_record_writer), so they never touch the shared staging buffer, and they only update the
+ * logger's overrun statistics from the consumer thread (the thread calling flush()).
+ *
+ * Include ArduinoLogger.h before this header.
+ */
+
+/** Overruns noted by producer threads
+ *
+ * Producers cannot update the logger's overrun statistics, which are owned by the consumer.
+ * Instead, they add to these counters, and the consumer collects them with take() before
+ * flushing.
+ */
+struct log_pending_overruns
+{
+	std::atomic<uint32_t> events{0};
+	std::atomic<uint32_t> bytes{0};
+	std::atomic<uint32_t> records{0};
+
+	/// Safe to call from any thread
+	void note(size_t dropped_bytes, size_t dropped_records) noexcept
+	{
+		bytes.fetch_add(static_cast<uint32_t>(dropped_bytes), std::memory_order_relaxed);
+		records.fetch_add(static_cast<uint32_t>(dropped_records), std::memory_order_relaxed);
+		events.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool pending() const noexcept
+	{
+		return events.load(std::memory_order_relaxed) > 0;
+	}
+
+	/// Add the pending counts to `stats` without collecting them
+	void add_to(log_overrun_stats& stats) const noexcept
+	{
+		stats.events += events.load(std::memory_order_relaxed);
+		stats.dropped_bytes += bytes.load(std::memory_order_relaxed);
+		stats.dropped_records += records.load(std::memory_order_relaxed);
+	}
+
+	/** Collect and reset the pending counts. Must only be called by the consumer.
+	 *
+	 * @returns the number of pending overrun events. `dropped_bytes` and `dropped_records`
+	 * are only updated if this is non-zero.
+	 */
+	uint32_t take(uint32_t& dropped_bytes, uint32_t& dropped_records) noexcept
+	{
+		uint32_t count = events.exchange(0, std::memory_order_relaxed);
+
+		if(count)
+		{
+			dropped_bytes = bytes.exchange(0, std::memory_order_relaxed);
+			dropped_records = records.exchange(0, std::memory_order_relaxed);
+		}
+
+		return count;
+	}
+
+	void reset() noexcept
+	{
+		events.store(0, std::memory_order_relaxed);
+		bytes.store(0, std::memory_order_relaxed);
+		records.store(0, std::memory_order_relaxed);
+	}
+};
+
+/// Where a record added by a concurrent strategy comes from
+enum class log_record_origin : uint8_t
+{
+	/// log() or print(). The record is echoed.
+	statement,
+	/// log_interrupt(). The record is not echoed.
+	interrupt,
+	/// The overrun report added by flush(). A dropped report is not noted as an overrun, since
+	/// flush() keeps its statistics for the next report.
+	overrun_report,
+};
+
+/** Base class for the strategies which accept log statements from multiple threads
+ *
+ * Producers note overruns in `pending_overruns_`. The consumer moves them into the base class
+ * statistics with collect_overruns() before flushing, and has_overrun() and overrun_stats()
+ * include the overruns which have not been collected yet.
+ *
+ * The log buffers of these strategies can be written from an interrupt, so log_interrupt()
+ * adds statements directly and no interrupt queue is reserved.
+ *
+ * The strategy provides `bool add_record(level, origin, fmt, args...)`, which formats a record
+ * and adds it to the log buffer, and returns false if the record was dropped. Statements from
+ * print() use log_level_e::off.
+ *
+ * @tparam TDerived The strategy, as for LoggerBaseT.
+ */
+template<class TDerived>
+class ConcurrentLoggerBaseT : public LoggerBaseT<TDerived, 0>
+{
+	using BaseClass = LoggerBaseT<TDerived, 0>;
+
+  public:
+	using BaseClass::BaseClass;
+
+	/// Includes overruns which have not been reported by flush() yet
+	bool has_overrun() const noexcept
+	{
+		return BaseClass::has_overrun() || pending_overruns_.pending();
+	}
+
+	/// Includes overruns which have not been reported by flush() yet
+	log_overrun_stats overrun_stats() const noexcept
+	{
+		size_t size = static_cast<const TDerived*>(this)->size();
+		log_overrun_stats stats = BaseClass::overrun_stats();
+		pending_overruns_.add_to(stats);
+		stats.high_water_mark = stats.high_water_mark > size ? stats.high_water_mark : size;
+		return stats;
+	}
+
+  protected:
+	/// Added as a record, so a report which does not fit is not counted as a lost statement
+	bool log_overrun_report(const log_overrun_stats& stats) noexcept
+	{
+		if(!this->enabled() || log_level_e::critical > this->level())
+		{
+			return true;
+		}
+
+		return static_cast<TDerived*>(this)->add_record(
+			log_level_e::critical, log_record_origin::overrun_report,
+			BaseClass::overrun_report_format(), static_cast<unsigned long>(stats.events),
+			static_cast<unsigned long>(stats.dropped_bytes),
+			static_cast<unsigned long>(stats.dropped_records),
+			static_cast<unsigned long>(stats.high_water_mark));
+	}
+
+	/// The prefix formatted at the start of a record. Statements from print() have none.
+	static const char* record_prefix(log_level_e l) noexcept
+	{
+		return (l == log_level_e::off) ? "" : LOG_LEVEL_TO_SHORT_C_STRING(l);
+	}
+
+	/// Note a record which was dropped by add_record()
+	void note_dropped(log_record_origin origin, const log_record_writer& writer) noexcept
+	{
+		if(origin != log_record_origin::overrun_report)
+		{
+			pending_overruns_.note(writer.len + writer.truncated, 1);
+		}
+	}
+
+	/// Move overruns noted by producers into the base class statistics
+	void collect_overruns() noexcept
+	{
+		this->track_occupancy();
+
+		uint32_t bytes;
+		uint32_t records;
+		uint32_t events = pending_overruns_.take(bytes, records);
+
+		if(events)
+		{
+			this->mark_overrun(bytes, records, events);
+		}
+	}
+
+  protected:
+	log_pending_overruns pending_overruns_;
+};
+
+#ifndef LOG_MAX_THREAD_SLOTS
+/// Maximum number of threads which can hold a thread slot at the same time (up to 32)
+#define LOG_MAX_THREAD_SLOTS 32
+#endif
+
+/** Small, reusable index for the calling thread
+ *
+ * The first time a thread calls index(), it claims the lowest free slot. The slot is released
+ * when the thread exits, so a program which creates and destroys threads keeps reusing the
+ * same small set of indices.
+ *
+ * Slots are shared by all loggers in the program.
+ */
+class log_thread_slot
+{
+	static_assert(LOG_MAX_THREAD_SLOTS <= 32, "Thread slots are tracked in a 32-bit mask");
+
+  public:
+	/// The calling thread's slot, or -1 if all LOG_MAX_THREAD_SLOTS slots are in use
+	static int index() noexcept
+	{
+		static thread_local log_thread_slot slot;
+		return slot.index_;
+	}
+
+  private:
+	log_thread_slot() noexcept
+	{
+		uint32_t used = in_use().load(std::memory_order_relaxed);
+
+		for(int i = 0; i < LOG_MAX_THREAD_SLOTS; i++)
+		{
+			uint32_t bit = 1u << i;
+
+			if(used & bit)
+			{
+				continue;
+			}
+
+			// Acquire pairs with the release below, so a new owner sees the data written by
+			// the previous owner of the slot
+			if(in_use().compare_exchange_strong(used, used | bit, std::memory_order_acquire,
+												std::memory_order_relaxed))
+			{
+				index_ = i;
+				return;
+			}
+
+			// Another thread changed the mask. Start over with the updated value.
+			i = -1;
+		}
+	}
+
+	~log_thread_slot() noexcept
+	{
+		if(index_ >= 0)
+		{
+			in_use().fetch_and(~(1u << index_), std::memory_order_release);
+		}
+	}
+
+	static std::atomic<uint32_t>& in_use() noexcept
+	{
+		static std::atomic<uint32_t> mask{0};
+		return mask;
+	}
+
+  private:
+	int index_ = -1;
+};
+
+#endif // CONCURRENT_LOGGING_HPP_
@@ -0,0 +1,260 @@
+#ifndef INTERRUPT_LOG_QUEUE_HPP_
+#define INTERRUPT_LOG_QUEUE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#if !defined(__AVR__)
+#include <atomic>
+#endif
+
+/** Wait-free queue of log records written from an interrupt context
+ *
+ * The queue has a single producer (interrupt handlers, which must not preempt each other
+ * while logging) and a single consumer (the main context). Each record is stored as a one-byte
+ * length followed by its payload. A record becomes visible to the consumer only after it is
+ * completely written, and push() never waits or loops.
+ *
+ * Records which do not fit are dropped and counted. The drop counters are only written by the
+ * producer; the consumer collects the change since its last call with take_dropped(). Between
+ * two take_dropped() calls, the counts saturate at the range of the counters (255 on AVR)
+ * instead of wrapping around.
+ *
+ * On AVR, indices and counters are single bytes so they can be read and written atomically.
+ * Elsewhere, they use std::atomic with acquire/release ordering.
+ *
+ * @tparam TCount The size of the queue, in bytes. Must be a power of 2 (at most 128 on AVR).
+ */
+template<size_t TCount>
+class InterruptLogQueue
+{
+#if defined(__AVR__)
+	using index_t = uint8_t;
+	static_assert(TCount <= 128, "InterruptLogQueue is limited to 128 bytes on AVR");
+#else
+	using index_t = uint32_t;
+#endif
+	static_assert(TCount > 1 && (TCount & (TCount - 1)) == 0,
+				  "InterruptLogQueue size must be a power of 2");
+
+  public:
+	/// The largest payload which can be stored in a single record
+	static constexpr size_t max_payload = (TCount - 1 < UINT8_MAX) ? TCount - 1 : UINT8_MAX;
+
+	/** Add a record. Must only be called by the producer.
+	 *
+	 * @param data The record payload.
+	 * @param len The size of the payload, in bytes. Truncated to max_payload.
+	 * @returns true if the record was added, false if it was dropped.
+	 */
+	bool push(const char* data, size_t len) noexcept
+	{
+		len = (len < max_payload) ? len : max_payload;
+
+		index_t head = load(head_);
+		index_t used = static_cast<index_t>(head - load_acquire(tail_));
+
+		if(TCount - used < len + 1)
+		{
+			drop(len);
+			return false;
+		}
+
+		buf_[head & mask] = static_cast<uint8_t>(len);
+
+		for(size_t i = 0; i < len; i++)
+		{
+			buf_[(head + 1 + i) & mask] = static_cast<uint8_t>(data[i]);
+		}
+
+		store_release(head_, static_cast<index_t>(head + 1 + len));
+		return true;
+	}
+
+	/** Count a record which was not added. Must only be called by the producer.
+	 *
+	 * @param len The size of the record's payload, in bytes.
+	 */
+	void drop(size_t len) noexcept
+	{
+		// The consumer may collect the counts concurrently. An outdated view of what it has
+		// seen only makes the counts saturate early.
+		index_t records = load(dropped_records_);
+		index_t bytes = load(dropped_bytes_);
+		index_t pending_records = static_cast<index_t>(records - load(seen_records_));
+		index_t pending_bytes = static_cast<index_t>(bytes - load(seen_bytes_));
+		index_t room = static_cast<index_t>(max_count - pending_bytes);
+
+		if(pending_records < max_count)
+		{
+			store(dropped_records_, static_cast<index_t>(records + 1));
+		}
+
+		store(dropped_bytes_, static_cast<index_t>(bytes + ((len < room) ? len : room)));
+	}
+
+	/** Remove all visible records. Must only be called by the consumer.
+	 *
+	 * @param out Called with each record: out(const char* data, size_t len). The payload is
+	 *	copied into a contiguous temporary buffer first.
+	 * @returns The number of records which were removed.
+	 */
+	template<typename TOut>
+	size_t drain(TOut out) noexcept
+	{
+		index_t tail = load(tail_);
+		index_t head = load_acquire(head_);
+		size_t count = 0;
+
+		while(tail != head)
+		{
+			char record[max_payload];
+			size_t len = buf_[tail & mask];
+
+			for(size_t i = 0; i < len; i++)
+			{
+				record[i] = static_cast<char>(buf_[(tail + 1 + i) & mask]);
+			}
+
+			tail = static_cast<index_t>(tail + 1 + len);
+			store_release(tail_, tail);
+
+			out(record, len);
+			count++;
+		}
+
+		return count;
+	}
+
+	/** Collect the records dropped since the last call. Must only be called by the consumer.
+	 *
+	 * @returns the number of dropped records.
+	 */
+	size_t take_dropped(size_t& bytes) noexcept
+	{
+		index_t records = load(dropped_records_);
+		index_t dropped_bytes = load(dropped_bytes_);
+		size_t count = static_cast<index_t>(records - load(seen_records_));
+		bytes = static_cast<index_t>(dropped_bytes - load(seen_bytes_));
+		store(seen_records_, records);
+		store(seen_bytes_, dropped_bytes);
+		return count;
+	}
+
+	/// Discard all visible records and dropped counts. Must only be called by the consumer.
+	void reset() noexcept
+	{
+		size_t bytes;
+		drain([](const char*, size_t) {});
+		take_dropped(bytes);
+	}
+
+	/// True if there are no visible records
+	bool empty() const noexcept
+	{
+		return load_acquire(head_) == load(tail_);
+	}
+
+  private:
+	static constexpr index_t mask = static_cast<index_t>(TCount - 1);
+	/// The largest count which can be collected by take_dropped()
+	static constexpr index_t max_count = static_cast<index_t>(~static_cast<index_t>(0));
+
+#if defined(__AVR__)
+	using atomic_index_t = volatile index_t;
+
+	// Single-byte accesses are atomic on AVR. The barriers keep the compiler from moving
+	// buffer accesses across index updates.
+	static index_t load(const atomic_index_t& v) noexcept
+	{
+		return v;
+	}
+
+	static index_t load_acquire(const atomic_index_t& v) noexcept
+	{
+		index_t value = v;
+		asm volatile("" ::: "memory");
+		return value;
+	}
+
+	static void store(atomic_index_t& v, index_t value) noexcept
+	{
+		v = value;
+	}
+
+	static void store_release(atomic_index_t& v, index_t value) noexcept
+	{
+		asm volatile("" ::: "memory");
+		v = value;
+	}
+#else
+	using atomic_index_t = std::atomic<index_t>;
+
+	static index_t load(const atomic_index_t& v) noexcept
+	{
+		return v.load(std::memory_order_relaxed);
+	}
+
+	static index_t load_acquire(const atomic_index_t& v) noexcept
+	{
+		return v.load(std::memory_order_acquire);
+	}
+
+	static void store(atomic_index_t& v, index_t value) noexcept
+	{
+		v.store(value, std::memory_order_relaxed);
+	}
+
+	static void store_release(atomic_index_t& v, index_t value) noexcept
+	{
+		v.store(value, std::memory_order_release);
+	}
+#endif
+
+  private:
+	/// Written by the producer
+	atomic_index_t head_{0};
+	atomic_index_t dropped_records_{0};
+	atomic_index_t dropped_bytes_{0};
+	/// Written by the consumer
+	atomic_index_t tail_{0};
+	atomic_index_t seen_records_{0};
+	atomic_index_t seen_bytes_{0};
+	uint8_t buf_[TCount];
+};
+
+/// Used by strategies which add statements from interrupts directly, so they reserve no RAM
+/// for a queue. Nothing is ever queued.
+template<>
+class InterruptLogQueue<0>
+{
+  public:
+	static constexpr size_t max_payload = 0;
+
+	bool push(const char* /*data*/, size_t /*len*/) noexcept
+	{
+		return false;
+	}
+
+	void drop(size_t /*len*/) noexcept {}
+
+	template<typename TOut>
+	size_t drain(TOut /*out*/) noexcept
+	{
+		return 0;
+	}
+
+	size_t take_dropped(size_t& bytes) noexcept
+	{
+		bytes = 0;
+		return 0;
+	}
+
+	void reset() noexcept {}
+
+	bool empty() const noexcept
+	{
+		return true;
+	}
+};
+
+#endif // INTERRUPT_LOG_QUEUE_HPP_
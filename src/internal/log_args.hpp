@@ -0,0 +1,328 @@
+#ifndef LOG_ARGS_HPP_
+#define LOG_ARGS_HPP_
+
+#include <LibPrintf.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Binary encoding for log statement arguments.
+ *
+ * Each argument is stored as a one-byte tag followed by its payload. The upper nibble of the
+ * tag holds the argument kind, and the lower nibble holds the payload size in bytes:
+ *
+ * - Integers, floating point values, and pointers store their native (little-endian) bytes.
+ *   Enumerations are stored as their underlying integer type.
+ * - Strings store a one-byte length, the characters, and a NUL terminator. Strings are
+ *   truncated to fit the space available in the record. A null string has no characters,
+ *   and its tag's size is 1 instead of 0. It is rendered as "(null)".
+ *
+ * The encoding is self-describing, so records can be decoded without the original types.
+ * When the types are known (e.g., on the target), pack<Args...>::render() decodes the values
+ * and hands them to fctprintf() with the original format string.
+ */
+namespace log_args
+{
+/// Argument kinds, stored in the upper nibble of each argument tag
+enum kind : uint8_t
+{
+	kind_signed = 1,
+	kind_unsigned = 2,
+	kind_float = 3,
+	kind_string = 4,
+	kind_pointer = 5,
+};
+
+/// Output function signature used by fctprintf()
+using out_fn = void (*)(char c, void* ctx);
+
+/// Renders an encoded argument list with the supplied format string
+using render_fn = void (*)(out_fn out, void* ctx, const char* fmt, const uint8_t* src);
+
+constexpr uint8_t make_tag(kind k, size_t size)
+{
+	return static_cast<uint8_t>((k << 4) | size);
+}
+
+/// Encoding for arguments that are stored as their native bytes
+template<typename T, kind K>
+struct scalar_arg
+{
+	using value_type = T;
+
+	static constexpr size_t min_size = 1 + sizeof(T);
+
+	static bool encode(uint8_t*& dst, size_t& avail, const T& value) noexcept
+	{
+		if(avail < min_size)
+		{
+			return false;
+		}
+
+		dst[0] = make_tag(K, sizeof(T));
+		memcpy(&dst[1], &value, sizeof(T));
+		dst += min_size;
+		avail -= min_size;
+		return true;
+	}
+
+	static const uint8_t* decode(const uint8_t* src, T& value) noexcept
+	{
+		memcpy(&value, &src[1], sizeof(T));
+		return src + min_size;
+	}
+};
+
+/// Encoding for NUL-terminated strings, which are copied into the record
+struct string_arg
+{
+	using value_type = const char*;
+
+	/// Tag, length, and NUL terminator
+	static constexpr size_t min_size = 3;
+	static constexpr size_t max_length = UINT8_MAX;
+	/// Stored in the tag's size to mark a null string
+	static constexpr uint8_t null_flag = 1;
+
+	static bool encode(uint8_t*& dst, size_t& avail, const char* value) noexcept
+	{
+		if(avail < min_size)
+		{
+			return false;
+		}
+
+		size_t len = value ? strlen(value) : 0;
+		size_t limit = avail - min_size;
+		limit = limit < max_length ? limit : max_length;
+		len = len < limit ? len : limit;
+
+		dst[0] = make_tag(kind_string, value ? 0 : null_flag);
+		dst[1] = static_cast<uint8_t>(len);
+		memcpy(&dst[2], value, len);
+		dst[2 + len] = '\0';
+		dst += min_size + len;
+		avail -= min_size + len;
+		return true;
+	}
+
+	static const uint8_t* decode(const uint8_t* src, const char*& value) noexcept
+	{
+		value = (src[0] & null_flag) ? "(null)" : reinterpret_cast<const char*>(&src[2]);
+		return src + min_size + src[1];
+	}
+};
+
+/// Encoding for pointers, which are rendered by address (e.g., %p)
+struct pointer_arg
+{
+	using value_type = const void*;
+
+	static constexpr size_t min_size = 1 + sizeof(const void*);
+
+	static bool encode(uint8_t*& dst, size_t& avail, const void* value) noexcept
+	{
+		return scalar_arg<const void*, kind_pointer>::encode(dst, avail, value);
+	}
+
+	static const uint8_t* decode(const uint8_t* src, const void*& value) noexcept
+	{
+		return scalar_arg<const void*, kind_pointer>::decode(src, value);
+	}
+};
+
+template<typename T>
+struct arg;
+
+/// Encoding for enumerations, which are stored as their underlying integer type.
+/// Compiler built-ins are used, since <type_traits> is not available on AVR.
+template<typename T, bool TEnum = __is_enum(T)>
+struct enum_arg
+{
+	static_assert(sizeof(T) == 0, "Unsupported argument type for binary log encoding");
+};
+
+template<typename T>
+struct enum_arg<T, true>
+{
+	using underlying_type = __underlying_type(T);
+	using value_type = typename arg<underlying_type>::value_type;
+
+	static constexpr size_t min_size = arg<underlying_type>::min_size;
+
+	static bool encode(uint8_t*& dst, size_t& avail, const T& value) noexcept
+	{
+		return arg<underlying_type>::encode(dst, avail, static_cast<underlying_type>(value));
+	}
+
+	static const uint8_t* decode(const uint8_t* src, value_type& value) noexcept
+	{
+		return arg<underlying_type>::decode(src, value);
+	}
+};
+
+/// Maps an argument type to its encoding. Unsupported types fail to compile.
+template<typename T>
+struct arg : enum_arg<T>
+{
+};
+
+template<>
+struct arg<bool> : scalar_arg<int, kind_signed>
+{
+};
+template<>
+struct arg<char> : scalar_arg<char, kind_signed>
+{
+};
+template<>
+struct arg<signed char> : scalar_arg<signed char, kind_signed>
+{
+};
+template<>
+struct arg<unsigned char> : scalar_arg<unsigned char, kind_unsigned>
+{
+};
+template<>
+struct arg<short> : scalar_arg<short, kind_signed>
+{
+};
+template<>
+struct arg<unsigned short> : scalar_arg<unsigned short, kind_unsigned>
+{
+};
+template<>
+struct arg<int> : scalar_arg<int, kind_signed>
+{
+};
+template<>
+struct arg<unsigned> : scalar_arg<unsigned, kind_unsigned>
+{
+};
+template<>
+struct arg<long> : scalar_arg<long, kind_signed>
+{
+};
+template<>
+struct arg<unsigned long> : scalar_arg<unsigned long, kind_unsigned>
+{
+};
+template<>
+struct arg<long long> : scalar_arg<long long, kind_signed>
+{
+};
+template<>
+struct arg<unsigned long long> : scalar_arg<unsigned long long, kind_unsigned>
+{
+};
+// float arguments are promoted to double when passed to printf()
+template<>
+struct arg<float> : scalar_arg<double, kind_float>
+{
+};
+template<>
+struct arg<double> : scalar_arg<double, kind_float>
+{
+};
+template<>
+struct arg<const char*> : string_arg
+{
+};
+template<>
+struct arg<char*> : string_arg
+{
+};
+template<size_t N>
+struct arg<char[N]> : string_arg
+{
+};
+template<size_t N>
+struct arg<const char[N]> : string_arg
+{
+};
+template<typename T>
+struct arg<T*> : pointer_arg
+{
+};
+
+/** Encoder/decoder for an argument list
+ *
+ * @tparam Args The argument types, as deduced by the logging call.
+ */
+template<typename... Args>
+struct pack;
+
+template<>
+struct pack<>
+{
+	static constexpr size_t min_size = 0;
+
+	static bool encode(uint8_t*& /*dst*/, size_t& /*avail*/) noexcept
+	{
+		return true;
+	}
+
+	template<typename... Decoded>
+	static void render(out_fn out, void* ctx, const char* fmt, const uint8_t* /*src*/,
+					   const Decoded&... decoded) noexcept
+	{
+		// cppcheck-suppress wrongPrintfScanfArgNum
+		fctprintf(out, ctx, fmt, decoded...);
+	}
+};
+
+template<typename First, typename... Rest>
+struct pack<First, Rest...>
+{
+	static constexpr size_t min_size = arg<First>::min_size + pack<Rest...>::min_size;
+
+	/** Encode the arguments into a buffer
+	 *
+	 * Space for the minimum encoding of the remaining arguments is reserved before each
+	 * argument is encoded, so strings are truncated rather than causing later arguments to
+	 * be lost.
+	 *
+	 * @param dst Destination buffer. Advanced past the encoded arguments.
+	 * @param avail Space remaining in `dst`. Reduced by the encoded size.
+	 * @returns true if all arguments were encoded, false if there was not enough space.
+	 */
+	static bool encode(uint8_t*& dst, size_t& avail, const First& first,
+					   const Rest&... rest) noexcept
+	{
+		constexpr size_t reserved = pack<Rest...>::min_size;
+
+		if(avail < reserved)
+		{
+			return false;
+		}
+
+		size_t limit = avail - reserved;
+		uint8_t* start = dst;
+
+		if(!arg<First>::encode(dst, limit, first))
+		{
+			return false;
+		}
+
+		avail -= static_cast<size_t>(dst - start);
+		return pack<Rest...>::encode(dst, avail, rest...);
+	}
+
+	template<typename... Decoded>
+	static void render(out_fn out, void* ctx, const char* fmt, const uint8_t* src,
+					   const Decoded&... decoded) noexcept
+	{
+		typename arg<First>::value_type value;
+		src = arg<First>::decode(src, value);
+		pack<Rest...>::render(out, ctx, fmt, src, decoded..., value);
+	}
+};
+
+/// render_fn-compatible entry point for an argument list
+template<typename... Args>
+void render_args(out_fn out, void* ctx, const char* fmt, const uint8_t* src) noexcept
+{
+	pack<Args...>::render(out, ctx, fmt, src);
+}
+
+} // namespace log_args
+
+#endif // LOG_ARGS_HPP_
@@ -0,0 +1,461 @@
+#ifndef LOG_COMPRESSION_HPP_
+#define LOG_COMPRESSION_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/** @file
+ * Streaming LZ77 compression for log files
+ *
+ * The format is an LZSS bit stream, similar to heatshrink, which is split into blocks so that
+ * each flush produces a complete, decodable file:
+ *
+ * - Stream header (4 bytes): "LZL" followed by (window bits << 4) | length bits.
+ * - Blocks, one per flush: a 16-bit little-endian payload size, then the payload.
+ * - The payload is a sequence of tokens, most significant bit first:
+ *   - Literal: a 1 bit, then the 8-bit byte.
+ *   - Back-reference: a 0 bit, then (distance - 1) in window bits and
+ *     (length - min_match) in length bits. The referenced data may overlap the output.
+ * - The payload is padded with 0 bits to a whole byte. Every token is longer than the
+ *   padding, so decoding stops when fewer than 9 bits remain.
+ *
+ * The window of previous data carries over from one block to the next. Blocks must be
+ * decoded in order, starting at the stream header.
+ *
+ * tools/lz_log.py decompresses these files on a host.
+ */
+
+/// Parameters of the log compression format
+template<uint8_t TWindowBits, uint8_t TLengthBits>
+struct log_compression_format
+{
+	static_assert(TWindowBits >= 4 && TWindowBits <= 15, "Window bits must be in [4, 15]");
+	static_assert(TLengthBits >= 2 && TLengthBits <= 8, "Length bits must be in [2, 8]");
+	static_assert(TWindowBits + TLengthBits >= 8, "A back-reference must be longer than a byte");
+
+	static constexpr size_t header_size = 4;
+	static constexpr size_t block_header_size = 2;
+	static constexpr size_t window_size = size_t(1) << TWindowBits;
+	static constexpr size_t backref_bits = 1 + TWindowBits + TLengthBits;
+	/// The shortest match which is smaller as a back-reference than as literals
+	static constexpr size_t min_match = backref_bits / 9 + 1;
+	static constexpr size_t max_match = min_match + (size_t(1) << TLengthBits) - 1;
+	static constexpr uint8_t params = static_cast<uint8_t>((TWindowBits << 4) | TLengthBits);
+
+	static constexpr size_t smaller(size_t a, size_t b) noexcept
+	{
+		return (a < b) ? a : b;
+	}
+
+	/// The largest block produced for `input` bytes of data (every byte a literal)
+	static constexpr size_t max_block_size(size_t input) noexcept
+	{
+		return block_header_size + (input * 9 + 7) / 8;
+	}
+};
+
+/** Streaming LZ77 log compressor
+ *
+ * Compresses log data in blocks with a static RAM footprint: the window of previous data,
+ * which is used to find repeated strings, an index of the window, and the caller's output
+ * buffer.
+ *
+ * As in heatshrink, the index chains together the window positions which start with the same
+ * pair of bytes, so a match search only visits the positions which can match. The index takes
+ * 2 * (window_size + hash_size) bytes, which is 1 KiB with the default parameters. The
+ * longest match is still found, at the nearest distance, as by a search of the whole window.
+ *
+ *	@code
+ *	LogCompressor<> compressor;
+ *	uint8_t out[LogCompressor<>::max_block_size(512)];
+ *
+ *	compressor.header(out); // Once, at the start of the file
+ *
+ *	compressor.begin_block(out, sizeof(out));
+ *	compressor.write(data, len);
+ *	size_t compressed_size = compressor.end_block();
+ *  @endcode
+ *
+ * @tparam TWindowBits log2 of the window size, which is the farthest a match can be.
+ * @tparam TLengthBits The number of bits used for a match length.
+ */
+template<uint8_t TWindowBits = 8, uint8_t TLengthBits = 4>
+class LogCompressor : public log_compression_format<TWindowBits, TLengthBits>
+{
+	using format = log_compression_format<TWindowBits, TLengthBits>;
+
+  public:
+	/// Forget previous data. Call when starting a new file.
+	void reset() noexcept
+	{
+		// Positions keep counting, so the index entries are out of the empty window
+		window_head_ = 0;
+		window_fill_ = 0;
+	}
+
+	/// Write the stream header, which is format::header_size bytes
+	void header(uint8_t* out) const noexcept
+	{
+		out[0] = 'L';
+		out[1] = 'Z';
+		out[2] = 'L';
+		out[3] = format::params;
+	}
+
+	/// Start a block in `out`, which should hold format::max_block_size() of the input
+	void begin_block(uint8_t* out, size_t out_size) noexcept
+	{
+		out_ = out;
+		out_size_ = out_size;
+		out_pos_ = format::block_header_size;
+		bit_count_ = 0;
+		overflow_ = (out_size < format::block_header_size);
+	}
+
+	/// Compress data into the current block
+	void write(const char* data, size_t len) noexcept
+	{
+		if(len == 0)
+		{
+			return;
+		}
+
+		// The last byte of the previous write is indexed once the byte after it is known
+		if(window_fill_ > 0)
+		{
+			index(static_cast<uint16_t>(position_ - 1), window_[(window_head_ - 1) & mask],
+				  data[0]);
+		}
+
+		size_t i = 0;
+
+		while(i < len)
+		{
+			size_t distance = 0;
+			size_t length = find_match(data, len, i, distance);
+
+			if(length >= format::min_match)
+			{
+				put_bits(0, 1);
+				put_bits(distance - 1, TWindowBits);
+				put_bits(length - format::min_match, TLengthBits);
+			}
+			else
+			{
+				put_bits(0x100 | static_cast<uint8_t>(data[i]), 9);
+				length = 1;
+			}
+
+			for(size_t end = i + length; i < end; i++)
+			{
+				if(i + 1 < len)
+				{
+					index(static_cast<uint16_t>(position_ + i), data[i], data[i + 1]);
+				}
+			}
+		}
+
+		add_to_window(data, len);
+		position_ = static_cast<uint16_t>(position_ + len);
+	}
+
+	/** Finish the current block
+	 *
+	 * @returns the size of the block, including its header, or 0 if it did not fit in the
+	 * output buffer.
+	 */
+	size_t end_block() noexcept
+	{
+		if(bit_count_ > 0)
+		{
+			put_bits(0, 8 - bit_count_);
+		}
+
+		if(overflow_)
+		{
+			return 0;
+		}
+
+		size_t payload = out_pos_ - format::block_header_size;
+		out_[0] = static_cast<uint8_t>(payload);
+		out_[1] = static_cast<uint8_t>(payload >> 8);
+
+		return out_pos_;
+	}
+
+  public:
+	/// The number of chains in the index
+	static constexpr size_t hash_size = size_t(1) << format::smaller(TWindowBits, 10);
+
+  private:
+	static constexpr size_t mask = format::window_size - 1;
+	static constexpr size_t hash_mask = hash_size - 1;
+
+	/// The chain for the positions which start with a and b
+	static size_t hash(char a, char b) noexcept
+	{
+		return ((static_cast<uint8_t>(a) << 3) ^ static_cast<uint8_t>(b)) & hash_mask;
+	}
+
+	/// Add the position of a, followed by b, to the index
+	void index(uint16_t position, char a, char b) noexcept
+	{
+		size_t h = hash(a, b);
+		chain_[position & mask] = head_[h];
+		head_[h] = position;
+	}
+
+	/// The byte `back` positions before data[i], which may be in the window
+	char byte_before(const char* data, size_t i, size_t back) const noexcept
+	{
+		if(back <= i)
+		{
+			return data[i - back];
+		}
+
+		return window_[(window_head_ - (back - i)) & mask];
+	}
+
+	/// @returns the length of the longest match for data[i], and its distance
+	size_t find_match(const char* data, size_t len, size_t i, size_t& distance) const noexcept
+	{
+		size_t max_length = format::smaller(len - i, format::max_match);
+
+		if(max_length < format::min_match)
+		{
+			return 0;
+		}
+
+		size_t max_distance = format::smaller(i + window_fill_, format::window_size);
+		size_t best = 0;
+		uint16_t position = static_cast<uint16_t>(position_ + i);
+
+		// Positions are counted modulo 2^16, and a chain entry is overwritten once it leaves the
+		// window, so the walk stops when the distance no longer increases. A stale entry which
+		// lands in the window costs a comparison, but it cannot hide a match.
+		size_t last = 0;
+
+		for(uint16_t candidate = head_[hash(data[i], data[i + 1])];;
+			candidate = chain_[candidate & mask])
+		{
+			size_t d = static_cast<uint16_t>(position - candidate);
+
+			if(d <= last || d > max_distance)
+			{
+				break;
+			}
+
+			last = d;
+			size_t n = 0;
+
+			// The match may overlap data[i], since the decoder copies one byte at a time
+			while(n < max_length && byte_before(data, i + n, d) == data[i + n])
+			{
+				n++;
+			}
+
+			if(n > best)
+			{
+				best = n;
+				distance = d;
+
+				if(best == max_length)
+				{
+					break;
+				}
+			}
+		}
+
+		return best;
+	}
+
+	void add_to_window(const char* data, size_t len) noexcept
+	{
+		if(len > format::window_size)
+		{
+			data += len - format::window_size;
+			len = format::window_size;
+		}
+
+		for(size_t i = 0; i < len; i++)
+		{
+			window_[window_head_] = data[i];
+			window_head_ = (window_head_ + 1) & mask;
+		}
+
+		window_fill_ = format::smaller(window_fill_ + len, format::window_size);
+	}
+
+	void put_bits(uint32_t value, size_t count) noexcept
+	{
+		while(count > 0)
+		{
+			if(bit_count_ == 0)
+			{
+				if(out_pos_ >= out_size_)
+				{
+					overflow_ = true;
+					return;
+				}
+
+				out_[out_pos_] = 0;
+			}
+
+			size_t take = 8 - bit_count_;
+			take = (take < count) ? take : count;
+			count -= take;
+
+			uint8_t bits = static_cast<uint8_t>((value >> count) & ((1u << take) - 1));
+			out_[out_pos_] |= static_cast<uint8_t>(bits << (8 - bit_count_ - take));
+			bit_count_ += take;
+
+			if(bit_count_ == 8)
+			{
+				bit_count_ = 0;
+				out_pos_++;
+			}
+		}
+	}
+
+  private:
+	char window_[format::window_size] = {};
+	size_t window_head_ = 0;
+	size_t window_fill_ = 0;
+
+	/// The position of the next byte written, counted from the start
+	uint16_t position_ = 0;
+	/// The latest position in each chain
+	uint16_t head_[hash_size] = {};
+	/// The previous position in the chain of each window position
+	uint16_t chain_[format::window_size] = {};
+
+	uint8_t* out_ = nullptr;
+	size_t out_size_ = 0;
+	size_t out_pos_ = 0;
+	size_t bit_count_ = 0;
+	bool overflow_ = false;
+};
+
+/** Decompressor for streams produced by LogCompressor
+ *
+ * Intended for host tools and tests. tools/lz_log.py is the command-line equivalent.
+ *
+ * @tparam TWindowBits Must match the compressor.
+ * @tparam TLengthBits Must match the compressor.
+ */
+template<uint8_t TWindowBits = 8, uint8_t TLengthBits = 4>
+class LogDecompressor : public log_compression_format<TWindowBits, TLengthBits>
+{
+	using format = log_compression_format<TWindowBits, TLengthBits>;
+
+  public:
+	/** Decompress a whole stream, starting with its header
+	 *
+	 * @param data The compressed stream.
+	 * @param len The size of the compressed stream.
+	 * @param put Called with each decompressed character.
+	 * @returns false if the stream is malformed or uses different parameters. The data
+	 * which was decoded before the error has been output.
+	 */
+	template<class TPut>
+	bool decode(const uint8_t* data, size_t len, TPut put) noexcept
+	{
+		if(len < format::header_size || memcmp(data, "LZL", 3) != 0 ||
+		   data[3] != format::params)
+		{
+			return false;
+		}
+
+		window_head_ = 0;
+		window_fill_ = 0;
+		size_t pos = format::header_size;
+
+		while(pos < len)
+		{
+			if(len - pos < format::block_header_size)
+			{
+				return false;
+			}
+
+			size_t payload = data[pos] | (static_cast<size_t>(data[pos + 1]) << 8);
+			pos += format::block_header_size;
+
+			if(payload > len - pos || !decode_block(&data[pos], payload, put))
+			{
+				return false;
+			}
+
+			pos += payload;
+		}
+
+		return true;
+	}
+
+  private:
+	static constexpr size_t mask = format::window_size - 1;
+
+	template<class TPut>
+	bool decode_block(const uint8_t* payload, size_t len, TPut& put) noexcept
+	{
+		size_t bit = 0;
+		size_t total_bits = len * 8;
+
+		while(total_bits - bit >= 9)
+		{
+			if(get_bits(payload, bit, 1))
+			{
+				output(static_cast<char>(get_bits(payload, bit, 8)), put);
+				continue;
+			}
+
+			if(total_bits - bit < TWindowBits + TLengthBits)
+			{
+				return false;
+			}
+
+			size_t distance = get_bits(payload, bit, TWindowBits) + 1;
+			size_t length = get_bits(payload, bit, TLengthBits) + format::min_match;
+
+			if(distance > window_fill_)
+			{
+				return false;
+			}
+
+			for(size_t i = 0; i < length; i++)
+			{
+				output(window_[(window_head_ - distance) & mask], put);
+			}
+		}
+
+		return true;
+	}
+
+	template<class TPut>
+	void output(char c, TPut& put) noexcept
+	{
+		put(c);
+		window_[window_head_] = c;
+		window_head_ = (window_head_ + 1) & mask;
+		window_fill_ += (window_fill_ < format::window_size) ? 1 : 0;
+	}
+
+	static uint32_t get_bits(const uint8_t* data, size_t& bit, size_t count) noexcept
+	{
+		uint32_t value = 0;
+
+		for(size_t i = 0; i < count; i++, bit++)
+		{
+			value = (value << 1) | ((data[bit / 8] >> (7 - bit % 8)) & 1);
+		}
+
+		return value;
+	}
+
+  private:
+	char window_[format::window_size] = {};
+	size_t window_head_ = 0;
+	size_t window_fill_ = 0;
+};
+
+#endif // LOG_COMPRESSION_HPP_
@@ -0,0 +1,233 @@
+#ifndef MIRRORED_RING_BUFFER_HPP_
+#define MIRRORED_RING_BUFFER_HPP_
+
+#if !defined(__linux__)
+#error "MirroredRingBuffer requires memfd_create(), which is only available on Linux"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** Circular buffer which is mapped twice in virtual memory
+ *
+ * The buffer's pages are mapped a second time directly after the first mapping, so
+ * `storage[i]` and `storage[i + TCount]` are the same memory. Any region of up to TCount
+ * elements can be written or read as a single contiguous span, even when it wraps around the
+ * end of the buffer. The bulk put() and get() use a single memcpy(), and peek_spans() returns
+ * the stored elements as one span.
+ *
+ * The API matches CircularBuffer, so it can be used as the storage of CircularLogBufferLogger:
+ *
+ *	@code
+ *	#include <CircularBufferLogger.h>
+ *	#include <internal/mirrored_ring_buffer.hpp>
+ *
+ *	using PlatformLogger = PlatformLogger_t<CircularLogBufferLogger<
+ *		64 * 1024, log_full_policy::overwrite_oldest, MirroredRingBuffer>>;
+ *  @endcode
+ *
+ * The buffer is allocated with mmap() when it is constructed. If the mapping fails, the
+ * buffer's capacity is 0 and new data is dropped.
+ *
+ * @tparam T The element type. Elements are copied with memcpy(), so T must be trivially
+ *	copyable.
+ * @tparam TCount The number of elements in the buffer. Must be a power of 2, and
+ *	TCount * sizeof(T) must be a multiple of the page size.
+ */
+template<class T, size_t TCount>
+class MirroredRingBuffer
+{
+	static constexpr size_t bytes = TCount * sizeof(T);
+	static_assert((TCount & (TCount - 1)) == 0 && bytes >= 4096,
+				  "MirroredRingBuffer size must be a power of 2 and at least one page");
+
+  public:
+	/// A contiguous region of the buffer's storage
+	struct span
+	{
+		const T* data;
+		size_t size;
+	};
+
+	MirroredRingBuffer() noexcept
+	{
+		if(bytes % static_cast<size_t>(sysconf(_SC_PAGESIZE)) != 0)
+		{
+			return;
+		}
+
+		int fd = memfd_create("log_ring", MFD_CLOEXEC);
+
+		if(fd < 0)
+		{
+			return;
+		}
+
+		// Reserve space for both mappings, then map the same pages into each half
+		void* base = MAP_FAILED;
+
+		if(ftruncate(fd, bytes) == 0)
+		{
+			base = mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		}
+
+		if(base != MAP_FAILED)
+		{
+			auto half = static_cast<char*>(base) + bytes;
+
+			if(mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+				   MAP_FAILED ||
+			   mmap(half, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+				   MAP_FAILED)
+			{
+				munmap(base, 2 * bytes);
+			}
+			else
+			{
+				buf_ = static_cast<T*>(base);
+			}
+		}
+
+		close(fd);
+	}
+
+	~MirroredRingBuffer() noexcept
+	{
+		if(buf_)
+		{
+			munmap(buf_, 2 * bytes);
+		}
+	}
+
+	MirroredRingBuffer(const MirroredRingBuffer&) = delete;
+	MirroredRingBuffer& operator=(const MirroredRingBuffer&) = delete;
+
+	void put(T item) noexcept
+	{
+		if(!buf_)
+		{
+			return;
+		}
+
+		buf_[head_++ & mask] = item;
+
+		if(head_ - tail_ > TCount)
+		{
+			tail_++;
+		}
+	}
+
+	/// Add several elements with a single copy, overwriting the oldest elements if necessary
+	void put(const T* items, size_t count) noexcept
+	{
+		if(!buf_)
+		{
+			return;
+		}
+
+		if(count > TCount)
+		{
+			items += count - TCount;
+			count = TCount;
+		}
+
+		memcpy(&buf_[head_ & mask], items, count * sizeof(T));
+		head_ += count;
+
+		if(head_ - tail_ > TCount)
+		{
+			tail_ = head_ - TCount;
+		}
+	}
+
+	T get() noexcept
+	{
+		if(empty())
+		{
+			return T();
+		}
+
+		return buf_[tail_++ & mask];
+	}
+
+	/** Remove several elements with a single copy
+	 *
+	 * @returns the number of elements which were copied into `items`, up to `count`.
+	 */
+	size_t get(T* items, size_t count) noexcept
+	{
+		size_t stored = size();
+		count = (count < stored) ? count : stored;
+
+		if(count > 0)
+		{
+			memcpy(items, &buf_[tail_ & mask], count * sizeof(T));
+			tail_ += count;
+		}
+
+		return count;
+	}
+
+	/** Get the stored elements without removing them
+	 *
+	 * The stored elements are always contiguous, so `second` is always empty.
+	 *
+	 * @returns the number of stored elements.
+	 */
+	size_t peek_spans(span& first, span& second) const noexcept
+	{
+		first.data = buf_ ? &buf_[tail_ & mask] : nullptr;
+		first.size = size();
+		second.data = buf_;
+		second.size = 0;
+
+		return first.size;
+	}
+
+	/// Remove up to `count` elements from the front of the buffer
+	void consume(size_t count) noexcept
+	{
+		size_t stored = size();
+		tail_ += (count < stored) ? count : stored;
+	}
+
+	void reset() noexcept
+	{
+		tail_ = head_;
+	}
+
+	bool empty() const noexcept
+	{
+		return head_ == tail_;
+	}
+
+	bool full() const noexcept
+	{
+		return size() == capacity();
+	}
+
+	size_t capacity() const noexcept
+	{
+		return buf_ ? TCount : 0;
+	}
+
+	size_t size() const noexcept
+	{
+		return static_cast<size_t>(head_ - tail_);
+	}
+
+  private:
+	static constexpr size_t mask = TCount - 1;
+
+  private:
+	T* buf_ = nullptr;
+
+	/// Free-running indices. Only the low bits select an element.
+	size_t head_ = 0;
+	size_t tail_ = 0;
+};
+
+#endif // MIRRORED_RING_BUFFER_HPP_
@@ -0,0 +1,219 @@
+#ifndef MPSC_RING_BUFFER_HPP_
+#define MPSC_RING_BUFFER_HPP_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef LOG_CACHE_LINE_SIZE
+/// Used to keep the producer and consumer indices on separate cache lines
+#define LOG_CACHE_LINE_SIZE 64
+#endif
+
+/** Lock-free multi-producer, single-consumer ring buffer of variable-length records
+ *
+ * Producers reserve space for a whole record with a single compare-and-swap on the head
+ * index, copy their data into the reservation, and then publish the record by setting the
+ * committed bit in its header. Producers never wait for each other: a producer which is
+ * interrupted between reserving and publishing only delays the consumer.
+ *
+ * The consumer reads records in reservation order and stops at the first record which has
+ * not been published yet. Consumed space is zeroed before it is released to producers, so
+ * a stale header can never be mistaken for a published record.
+ *
+ * Records never wrap around the end of the storage. If a reservation would wrap, a padding
+ * record is placed at the end of the storage and the record starts at the beginning.
+ *
+ * @tparam TCount The size of the buffer, in bytes. Must be a power of 2.
+ */
+template<size_t TCount>
+class MPSCRingBuffer
+{
+	static_assert(TCount >= 64 && (TCount & (TCount - 1)) == 0,
+				  "MPSCRingBuffer size must be a power of 2, and at least 64 bytes");
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+				  "Record headers require a lock-free 32-bit atomic");
+
+  public:
+	/// Records are aligned so their headers can be accessed atomically
+	static constexpr size_t alignment = 8;
+	static constexpr size_t header_size = sizeof(uint32_t);
+
+	MPSCRingBuffer() noexcept
+	{
+		memset(buf_, 0, sizeof(buf_));
+	}
+
+	/** Add a record to the buffer
+	 *
+	 * Safe to call from any number of threads concurrently with each other and with the
+	 * consumer.
+	 *
+	 * @param data The record payload.
+	 * @param len The size of the payload, in bytes. Must not exceed max_payload().
+	 * @returns true if the record was added, false if there was not enough free space.
+	 */
+	bool put(const char* data, size_t len) noexcept
+	{
+		if(len > max_payload())
+		{
+			return false;
+		}
+
+		size_t record_size = align(header_size + len);
+		size_t head = head_.load(std::memory_order_relaxed);
+		size_t padding;
+
+		do
+		{
+			size_t contiguous = TCount - (head & mask);
+			padding = (record_size <= contiguous) ? 0 : contiguous;
+
+			if(head + padding + record_size - tail_.load(std::memory_order_acquire) > TCount)
+			{
+				return false;
+			}
+		} while(!head_.compare_exchange_weak(head, head + padding + record_size,
+											 std::memory_order_relaxed,
+											 std::memory_order_relaxed));
+
+		if(padding)
+		{
+			header_at(head).store(make_header(padding, padding_bit), std::memory_order_release);
+			head += padding;
+		}
+
+		memcpy(&buf_[(head & mask) + header_size], data, len);
+		header_at(head).store(make_header(len, 0), std::memory_order_release);
+		return true;
+	}
+
+	/** Remove published records from the buffer
+	 * Must only be called from a single thread at a time.
+	 *
+	 * @param out Called with each record's payload: out(const char* data, size_t len).
+	 * @returns The number of records which were consumed.
+	 */
+	template<typename TOut>
+	size_t consume(TOut out) noexcept
+	{
+		const char* data;
+		size_t len;
+		size_t count = 0;
+
+		while(front(data, len))
+		{
+			out(data, len);
+			pop_front();
+			count++;
+		}
+
+		return count;
+	}
+
+	/** Access the oldest published record without removing it
+	 *
+	 * Must only be called by the consumer.
+	 *
+	 * @param data Set to the record's payload. Valid until pop_front() is called.
+	 * @param len Set to the size of the payload, in bytes.
+	 * @returns false if the buffer is empty, or the oldest record has not been published yet.
+	 */
+	bool front(const char*& data, size_t& len) noexcept
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+
+		while(tail != head_.load(std::memory_order_acquire))
+		{
+			uint32_t header = header_at(tail).load(std::memory_order_acquire);
+
+			if(!(header & committed_bit))
+			{
+				// The producer which reserved this record has not finished writing it
+				return false;
+			}
+
+			if(!(header & padding_bit))
+			{
+				data = &buf_[(tail & mask) + header_size];
+				len = header & size_mask;
+				return true;
+			}
+
+			// Padding records store their total size, and they are released right away
+			tail = release(tail, header & size_mask);
+		}
+
+		return false;
+	}
+
+	/// Remove the record returned by front(). Must only be called by the consumer.
+	void pop_front() noexcept
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		uint32_t header = header_at(tail).load(std::memory_order_relaxed);
+		release(tail, align(header_size + (header & size_mask)));
+	}
+
+	/// Discard all published records. Must only be called by the consumer.
+	void reset() noexcept
+	{
+		consume([](const char*, size_t) {});
+	}
+
+	/// Bytes currently reserved by producers, including headers and padding
+	size_t size() const noexcept
+	{
+		return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed);
+	}
+
+	size_t capacity() const noexcept
+	{
+		return TCount;
+	}
+
+	/// The largest payload which can be stored in a single record
+	static constexpr size_t max_payload() noexcept
+	{
+		return TCount / 2 - header_size;
+	}
+
+  private:
+	static constexpr size_t mask = TCount - 1;
+	static constexpr uint32_t committed_bit = 0x80000000u;
+	static constexpr uint32_t padding_bit = 0x40000000u;
+	static constexpr uint32_t size_mask = 0x3FFFFFFFu;
+
+	static constexpr size_t align(size_t size) noexcept
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/// Headers hold the payload size, or the padding size for padding records
+	static uint32_t make_header(size_t size, uint32_t flags) noexcept
+	{
+		return static_cast<uint32_t>(size) | committed_bit | flags;
+	}
+
+	/// Zero a consumed record and return its space to the producers
+	size_t release(size_t tail, size_t record_size) noexcept
+	{
+		memset(&buf_[tail & mask], 0, record_size);
+		tail += record_size;
+		tail_.store(tail, std::memory_order_release);
+		return tail;
+	}
+
+	std::atomic<uint32_t>& header_at(size_t index) noexcept
+	{
+		return *reinterpret_cast<std::atomic<uint32_t>*>(&buf_[index & mask]);
+	}
+
+  private:
+	alignas(LOG_CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+	alignas(LOG_CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+	alignas(LOG_CACHE_LINE_SIZE) char buf_[TCount];
+};
+
+#endif // MPSC_RING_BUFFER_HPP_
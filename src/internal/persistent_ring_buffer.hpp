@@ -0,0 +1,241 @@
+#ifndef PERSISTENT_RING_BUFFER_HPP_
+#define PERSISTENT_RING_BUFFER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// CRC-32 (IEEE 802.3) of `len` bytes, continuing from `crc`
+inline uint32_t log_crc32(const void* data, size_t len, uint32_t crc = 0) noexcept
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+	crc = ~crc;
+
+	for(size_t i = 0; i < len; i++)
+	{
+		crc ^= bytes[i];
+
+		for(int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (UINT32_C(0xEDB88320) & (0 - (crc & 1)));
+		}
+	}
+
+	return ~crc;
+}
+
+/** Circular buffer in storage which outlives the program
+ *
+ * The buffer has the same semantics as CircularBuffer (new data overwrites the oldest data),
+ * but its indices are kept in the storage with the data, so the contents can be recovered
+ * by a later session (e.g., from RAM which is not cleared on reset, or from a mapped file).
+ *
+ * The indices are kept in a header with a magic value, a sequence number, and a CRC. The
+ * header is written after the data, alternating between two copies, so an update which is
+ * interrupted by a reset or crash leaves the previous copy intact. recover() picks the newest
+ * valid copy.
+ *
+ * @tparam TCount The size of the buffer, in bytes.
+ */
+template<size_t TCount>
+class PersistentRingBuffer
+{
+	static_assert(TCount > 0, "PersistentRingBuffer requires a buffer");
+
+	static constexpr uint32_t magic = UINT32_C(0x4C4F4752); // "LOGR"
+
+	struct header
+	{
+		uint32_t magic;
+		/// Incremented each time the buffer is recovered
+		uint32_t session;
+		/// Incremented each time the header is written
+		uint32_t sequence;
+		uint32_t head;
+		uint32_t count;
+		/// Covers the fields above and TCount
+		uint32_t crc;
+	};
+
+  public:
+	/** Layout of the buffer storage
+	 *
+	 * This type has no constructor, so static instances are not initialized at startup.
+	 */
+	struct storage_t
+	{
+		header headers[2];
+		char buf[TCount];
+	};
+
+	/// A contiguous region of the buffer's storage
+	struct span
+	{
+		const char* data;
+		size_t size;
+	};
+
+	/** Use `storage`, which may hold a buffer from a previous session
+	 *
+	 * If the storage holds a valid buffer, its contents are kept. Otherwise, the storage is
+	 * initialized as an empty buffer. Must be called before any other function.
+	 *
+	 * @returns true if a valid buffer was recovered.
+	 */
+	bool recover(storage_t* storage) noexcept
+	{
+		storage_ = storage;
+		const header* previous = latest_valid_header();
+
+		if(previous)
+		{
+			current_ = *previous;
+			current_.session++;
+		}
+		else
+		{
+			current_.magic = magic;
+			current_.session = 0;
+			current_.sequence = 0;
+			current_.head = 0;
+			current_.count = 0;
+		}
+
+		commit();
+
+		return previous != nullptr;
+	}
+
+	/// Stop using the storage. The contents are kept for a later session.
+	void detach() noexcept
+	{
+		storage_ = nullptr;
+	}
+
+	/// True if recover() has been called with storage
+	bool attached() const noexcept
+	{
+		return storage_ != nullptr;
+	}
+
+	/// Add data, overwriting the oldest data if there is not enough space
+	void put(const char* data, size_t len) noexcept
+	{
+		if(len > TCount)
+		{
+			data += len - TCount;
+			len = TCount;
+		}
+
+		size_t to_end = TCount - current_.head;
+		size_t first = (len < to_end) ? len : to_end;
+		memcpy(&storage_->buf[current_.head], data, first);
+		memcpy(&storage_->buf[0], data + first, len - first);
+
+		current_.head = static_cast<uint32_t>((current_.head + len) % TCount);
+		current_.count =
+			static_cast<uint32_t>((current_.count + len < TCount) ? current_.count + len : TCount);
+		commit();
+	}
+
+	/** Get the stored data without removing it
+	 *
+	 * The data is returned as at most two contiguous regions, oldest first.
+	 *
+	 * @returns the total number of bytes in both regions.
+	 */
+	size_t peek_spans(span& first, span& second) const noexcept
+	{
+		size_t tail = (current_.head + TCount - current_.count) % TCount;
+		size_t to_end = TCount - tail;
+
+		first.data = &storage_->buf[tail];
+		first.size = (current_.count < to_end) ? current_.count : to_end;
+		second.data = &storage_->buf[0];
+		second.size = current_.count - first.size;
+
+		return current_.count;
+	}
+
+	/// Remove up to `count` bytes from the front of the buffer
+	void consume(size_t count) noexcept
+	{
+		count = (count < current_.count) ? count : current_.count;
+
+		if(count > 0)
+		{
+			current_.count = static_cast<uint32_t>(current_.count - count);
+			commit();
+		}
+	}
+
+	void reset() noexcept
+	{
+		current_.head = 0;
+		current_.count = 0;
+		commit();
+	}
+
+	size_t size() const noexcept
+	{
+		return attached() ? current_.count : 0;
+	}
+
+	static constexpr size_t capacity() noexcept
+	{
+		return TCount;
+	}
+
+	/// The number of times the buffer has been recovered since it was initialized
+	uint32_t session() const noexcept
+	{
+		return current_.session;
+	}
+
+  private:
+	static uint32_t crc_of(const header& h) noexcept
+	{
+		return log_crc32(&h, offsetof(header, crc), static_cast<uint32_t>(TCount));
+	}
+
+	static bool valid(const header& h) noexcept
+	{
+		return h.magic == magic && h.head < TCount && h.count <= TCount && h.crc == crc_of(h);
+	}
+
+	/// The most recently written valid header, or nullptr if neither copy is valid
+	const header* latest_valid_header() const noexcept
+	{
+		const header& a = storage_->headers[0];
+		const header& b = storage_->headers[1];
+		bool a_valid = valid(a);
+		bool b_valid = valid(b);
+
+		if(a_valid && b_valid)
+		{
+			// The sequence number may have wrapped
+			return (static_cast<int32_t>(b.sequence - a.sequence) > 0) ? &b : &a;
+		}
+
+		return a_valid ? &a : (b_valid ? &b : nullptr);
+	}
+
+	/// Write the header after the data, replacing the older copy
+	void commit() noexcept
+	{
+		current_.sequence++;
+		current_.crc = crc_of(current_);
+
+		// Keep the compiler from moving data writes after the header update
+		asm volatile("" ::: "memory");
+		storage_->headers[current_.sequence & 1] = current_;
+	}
+
+  private:
+	storage_t* storage_ = nullptr;
+
+	/// Working copy of the newest header
+	header current_ = {};
+};
+
+#endif // PERSISTENT_RING_BUFFER_HPP_
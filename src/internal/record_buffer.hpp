@@ -0,0 +1,254 @@
+#ifndef RECORD_BUFFER_HPP_
+#define RECORD_BUFFER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Circular buffer of variable-length records
+ *
+ * Each record is stored as a fixed-size header (payload length, level, and timestamp)
+ * followed by its payload. A record is opened with begin(), filled with one or more write()
+ * calls, and made visible to readers with commit(). Readers only ever see whole, committed
+ * records, so the buffer never holds a partial record at its start.
+ *
+ * The buffer does not evict data on its own. When write() runs out of space, the owner
+ * decides how to make room (e.g., drop_front() or reading out the oldest records).
+ *
+ * Headers and payloads are copied with memcpy(), in at most two segments each.
+ *
+ * @tparam TCount The size of the buffer, in bytes. Indices are wrapped with a mask when TCount
+ *	is a power of 2.
+ */
+template<size_t TCount>
+class RecordBuffer
+{
+  public:
+	/// Record metadata, stored in front of each payload
+	struct header
+	{
+		uint16_t length;
+		uint8_t level;
+		uint32_t timestamp;
+	};
+
+	/// Size of the serialized header. Fields are stored without padding.
+	static constexpr size_t header_size = sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint32_t);
+
+	static_assert(TCount > header_size, "RecordBuffer must be larger than a record header");
+
+	RecordBuffer() = default;
+
+	/// Open a new record. Requires available() >= header_size and no open record.
+	void begin(uint8_t level, uint32_t timestamp)
+	{
+		header h = {0, level, timestamp};
+		write_header(offset(size_), h);
+		open_ = true;
+		open_size_ = header_size;
+	}
+
+	/** Add payload to the open record
+	 *
+	 * @returns The number of bytes written, which is less than `len` if the buffer does not
+	 * have enough free space or the record has reached its maximum length.
+	 */
+	size_t write(const char* data, size_t len)
+	{
+		if(!open_)
+		{
+			return 0;
+		}
+
+		size_t limit = available();
+		size_t length_limit = UINT16_MAX - (open_size_ - header_size);
+		limit = limit < length_limit ? limit : length_limit;
+		len = len < limit ? len : limit;
+
+		copy_in(offset(size_ + open_size_), data, len);
+		open_size_ += len;
+		return len;
+	}
+
+	/// Finalize the open record and make it visible to readers
+	void commit()
+	{
+		if(!open_)
+		{
+			return;
+		}
+
+		header h = read_header(offset(size_));
+		h.length = static_cast<uint16_t>(open_size_ - header_size);
+		write_header(offset(size_), h);
+
+		size_ += open_size_;
+		open_size_ = 0;
+		open_ = false;
+	}
+
+	/// Discard the open record
+	/// @returns the number of bytes freed, including the record header.
+	size_t abort()
+	{
+		size_t record_size = open_size_;
+		open_size_ = 0;
+		open_ = false;
+		return record_size;
+	}
+
+	/// Header of the oldest committed record. Requires !empty().
+	header front() const
+	{
+		return read_header(tail_);
+	}
+
+	/** Send the payload of the oldest committed record to `out` and remove the record
+	 *
+	 * @param out Called as `out(const char* data, size_t len)` with each contiguous part of
+	 *	the payload: twice if the payload wraps around the end of the buffer, otherwise once.
+	 */
+	template<typename TOut>
+	void pop_front(TOut out)
+	{
+		size_t length = front().length;
+		size_t pos = offset(header_size);
+		size_t first = contiguous(pos, length);
+
+		out(reinterpret_cast<const char*>(&buf_[pos]), first);
+
+		if(first < length)
+		{
+			out(reinterpret_cast<const char*>(&buf_[0]), length - first);
+		}
+
+		drop_front();
+	}
+
+	/// Remove the oldest committed record
+	/// @returns the number of bytes freed, including the record header.
+	size_t drop_front()
+	{
+		size_t record_size = header_size + front().length;
+		tail_ = offset(record_size);
+		size_ -= record_size;
+		return record_size;
+	}
+
+	/// Remove all records, including an open record
+	void reset()
+	{
+		tail_ = 0;
+		size_ = 0;
+		open_size_ = 0;
+		open_ = false;
+	}
+
+	/// True if there are no committed records
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	/// True if a record has been started with begin() and not yet committed
+	bool open() const
+	{
+		return open_;
+	}
+
+	/// Bytes used by committed records, including their headers
+	size_t size() const
+	{
+		return size_;
+	}
+
+	size_t capacity() const
+	{
+		return TCount;
+	}
+
+	/// Bytes which are not used by committed records or the open record
+	size_t available() const
+	{
+		return TCount - size_ - open_size_;
+	}
+
+  private:
+	static constexpr bool is_power_of_2 = (TCount & (TCount - 1)) == 0;
+
+	/// The position `distance` bytes after the oldest record. `distance` is at most TCount.
+	size_t offset(size_t distance) const
+	{
+		size_t pos = tail_ + distance;
+
+		// The branch is resolved at compile time
+		if(is_power_of_2)
+		{
+			return pos & (TCount - 1);
+		}
+
+		return (pos >= TCount) ? pos - TCount : pos;
+	}
+
+	/// The number of the `len` bytes at `pos` which come before the end of the storage
+	static size_t contiguous(size_t pos, size_t len)
+	{
+		size_t to_end = TCount - pos;
+		return (len < to_end) ? len : to_end;
+	}
+
+	void copy_in(size_t pos, const void* data, size_t len)
+	{
+		size_t first = contiguous(pos, len);
+		memcpy(&buf_[pos], data, first);
+		memcpy(&buf_[0], static_cast<const uint8_t*>(data) + first, len - first);
+	}
+
+	void copy_out(size_t pos, void* data, size_t len) const
+	{
+		size_t first = contiguous(pos, len);
+		memcpy(data, &buf_[pos], first);
+		memcpy(static_cast<uint8_t*>(data) + first, &buf_[0], len - first);
+	}
+
+	void write_header(size_t pos, const header& h)
+	{
+		uint8_t bytes[header_size] = {
+			static_cast<uint8_t>(h.length),
+			static_cast<uint8_t>(h.length >> 8),
+			h.level,
+			static_cast<uint8_t>(h.timestamp),
+			static_cast<uint8_t>(h.timestamp >> 8),
+			static_cast<uint8_t>(h.timestamp >> 16),
+			static_cast<uint8_t>(h.timestamp >> 24),
+		};
+
+		copy_in(pos, bytes, header_size);
+	}
+
+	header read_header(size_t pos) const
+	{
+		uint8_t bytes[header_size];
+		copy_out(pos, bytes, header_size);
+
+		header h;
+		h.length = static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+		h.level = bytes[2];
+		h.timestamp = static_cast<uint32_t>(bytes[3]) | (static_cast<uint32_t>(bytes[4]) << 8) |
+					  (static_cast<uint32_t>(bytes[5]) << 16) |
+					  (static_cast<uint32_t>(bytes[6]) << 24);
+		return h;
+	}
+
+  private:
+	/// Start of the oldest committed record
+	size_t tail_ = 0;
+	/// Bytes used by committed records
+	size_t size_ = 0;
+	/// Bytes used by the open record, including its header
+	size_t open_size_ = 0;
+	bool open_ = false;
+	uint8_t buf_[TCount];
+};
+
+#endif // RECORD_BUFFER_HPP_
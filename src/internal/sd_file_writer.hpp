@@ -0,0 +1,97 @@
+#ifndef SD_FILE_WRITER_HPP_
+#define SD_FILE_WRITER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LOG_SD_PREALLOCATE_SIZE
+/// Default number of bytes which the SD strategies pre-allocate for the log file in begin().
+/// 0 disables pre-allocation.
+#define LOG_SD_PREALLOCATE_SIZE 0
+#endif
+
+/// SD cards are written in 512-byte sectors
+constexpr size_t log_sd_sector_size = 512;
+
+/** Write the oldest data in a log buffer to a file
+ *
+ * The data is written directly from the buffer's storage, one contiguous region at a time.
+ * A CircularBuffer holds at most two regions (when the data wraps around the end of the
+ * storage); a SlotBuffer holds one region per slot.
+ *
+ * @param file The file to write to, at its current position.
+ * @param buffer The log buffer. Must provide peek_spans() and consume().
+ * @param count The number of bytes to write.
+ * @param consume If true, the data which was written is removed from the buffer. Only the data
+ *	which was actually written is removed, so a partial write loses nothing. If false, only the
+ *	first two regions can be written.
+ * @returns true if all `count` bytes were written.
+ */
+template<class TFile, class TBuffer>
+bool log_write_buffer(TFile& file, TBuffer& buffer, size_t count, bool consume = true)
+{
+	do
+	{
+		typename TBuffer::span spans[2];
+
+		if(buffer.peek_spans(spans[0], spans[1]) == 0)
+		{
+			break;
+		}
+
+		for(const auto& region : spans)
+		{
+			size_t size = (region.size < count) ? region.size : count;
+
+			if(size == 0)
+			{
+				continue;
+			}
+
+			// Some SdFat versions take a non-const pointer. The data is not modified.
+			int bytes_written = file.write(const_cast<char*>(region.data), size);
+
+			if(consume && bytes_written > 0)
+			{
+				buffer.consume(static_cast<size_t>(bytes_written));
+			}
+
+			if(static_cast<size_t>(bytes_written) != size)
+			{
+				return false;
+			}
+
+			count -= size;
+		}
+	} while(consume && count > 0);
+
+	return count == 0;
+}
+
+/** Write the partial sector held in a log buffer, then return to the start of the sector
+ *
+ * Used with pre-allocated files, which are only written in whole sectors. The partial sector
+ * is written so it can be synced, but it stays in the buffer. The next flush writes it again,
+ * as part of a whole sector, so the file position stays sector-aligned.
+ *
+ * The position is restored even if the write fails, so the write can be retried.
+ *
+ * @returns true if the data was written and the position was restored.
+ */
+template<class TFile, class TBuffer>
+bool log_write_partial_sector(TFile& file, TBuffer& buffer)
+{
+	size_t size = buffer.size();
+
+	if(size == 0)
+	{
+		return true;
+	}
+
+	auto position = file.curPosition();
+	bool written = log_write_buffer(file, buffer, size, false);
+
+	return file.seekSet(position) && written;
+}
+
+#endif // SD_FILE_WRITER_HPP_
@@ -0,0 +1,250 @@
+#ifndef SD_LOGGING_HPP_
+#define SD_LOGGING_HPP_
+
+#include "sd_file_writer.hpp"
+#include "sd_recovery.hpp"
+#include "sd_sync_policy.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Helpers shared by the strategies which log to an SD card with the SdFat library.
+ *
+ * Include Arduino.h, ArduinoLogger.h, and SdFat.h before this header.
+ */
+
+/** Base class for the SD card strategies
+ *
+ * Holds the log file and the RAM log buffer, and handles SD errors: a failed operation is
+ * retried, and if the card is still unavailable, log data is held in a RAM ring (see
+ * log_sd_recovery) until recover() can resume logging to the card. The file is synced
+ * according to the sync policy (see log_sync_policy).
+ *
+ * The strategy provides `bool reopen_file()`, which is called by recover(). Strategies which
+ * keep writing to the same file implement it with resume_file().
+ *
+ * @tparam TDerived The strategy, as for LoggerBaseT.
+ * @tparam TBuffer The type of the RAM log buffer. Must provide peek_spans() and consume().
+ */
+template<class TDerived, class TBuffer>
+class SDLoggerBaseT : public LoggerBaseT<TDerived>
+{
+	using BaseClass = LoggerBaseT<TDerived>;
+
+  public:
+	using BaseClass::BaseClass;
+
+	/// Set when the open log file is synced to the SD card. See log_sync_policy.
+	void sync_policy(const log_sync_policy& policy) noexcept
+	{
+		sync_.policy(policy);
+	}
+
+	/// Get the current sync policy
+	const log_sync_policy& sync_policy() const noexcept
+	{
+		return sync_.policy();
+	}
+
+	/// Flush the log buffer and sync the log file to the SD card
+	void sync()
+	{
+		if(fs_)
+		{
+			static_cast<TDerived*>(this)->flush();
+			sync_file();
+		}
+	}
+
+	/// Flush and sync critical statements immediately, if the sync policy enables it
+	template<typename... Args>
+	void log(log_level_e l, const char* fmt, const Args&... args) noexcept
+	{
+		BaseClass::log(l, fmt, args...);
+
+		if(this->enabled() && l <= this->level())
+		{
+			sync_critical(l);
+		}
+	}
+
+	/// See LoggerBaseT::end_statement(). Critical statements are synced as they are by log().
+	void end_statement(log_level_e l) noexcept
+	{
+		BaseClass::end_statement(l);
+		sync_critical(l);
+	}
+
+	/// See LoggerBaseT::flush()
+	void flush() noexcept
+	{
+		flushing_ = true;
+		BaseClass::flush();
+		flushing_ = false;
+	}
+
+  protected:
+	/// Flush and sync a statement which was added to the log buffer, if it is critical and the
+	/// sync policy enables it
+	void sync_critical(log_level_e l)
+	{
+		if(fs_ && l == log_level_e::critical && sync_.policy().on_critical)
+		{
+			// A critical statement logged by flush() (e.g., the overrun report) is synced
+			// when that flush completes
+			if(flushing_)
+			{
+				sync_.request();
+			}
+			else
+			{
+				sync();
+			}
+		}
+	}
+
+	/// Report an SD error. Until the card is available again, log data is held in RAM.
+	void card_error(const char* msg)
+	{
+		printf("Error: %s\n", msg);
+		if(fs_->sdErrorCode())
+		{
+			if(fs_->sdErrorCode() == SD_CARD_ERROR_ACMD41)
+			{
+				printf("Try power cycling the SD card.\n");
+			}
+			printSdErrorSymbol(&Serial, fs_->sdErrorCode());
+			printf(", ErrorData: 0x%x\n", fs_->sdErrorData());
+		}
+
+		// Anything written after the last successful operation is overwritten by resume_file().
+		// If the file is closed (e.g., after end()), resume_file() appends to it instead.
+		if(recovery_.available())
+		{
+			resume_position_ = file_.isOpen() ? file_.curPosition() : UINT64_MAX;
+		}
+
+		recovery_.failed(millis());
+	}
+
+	/** Try to resume logging to the card, once the recovery interval has passed
+	 *
+	 * @returns true if the strategy's reopen_file() succeeded.
+	 */
+	bool recover()
+	{
+		if(!recovery_.due(millis()))
+		{
+			return false;
+		}
+
+		if(!static_cast<TDerived*>(this)->reopen_file())
+		{
+			recovery_.failed(millis());
+			return false;
+		}
+
+		recovery_.recovered();
+		return true;
+	}
+
+	/** Reopen a log file at the position of the last successful write
+	 *
+	 * If the file was closed when the error occurred, it is reopened at its end. Truncating the
+	 * file releases any pre-allocated clusters, so writes are no longer sector-aligned.
+	 *
+	 * @returns false if the file could not be reopened.
+	 */
+	bool resume_file(const char* filename)
+	{
+		file_.close();
+
+		if(!file_.open(filename, O_WRITE | O_CREAT) ||
+		   !file_.seekSet(resume_position_ < file_.size() ? resume_position_ : file_.size()) ||
+		   !file_.truncate())
+		{
+			return false;
+		}
+
+		preallocated_ = false;
+		return true;
+	}
+
+	/// Move the log buffer to the RAM ring. Overwritten data is reported as an overrun.
+	void hold_buffer() noexcept
+	{
+		size_t dropped = recovery_.hold(log_buffer_);
+
+		if(dropped > 0)
+		{
+			this->mark_overrun(dropped);
+		}
+	}
+
+	/// Update the file's directory entry, so the data written so far survives a reset
+	void sync_file()
+	{
+		if(!recovery_.available())
+		{
+			return;
+		}
+
+		if(!static_cast<TDerived*>(this)->write_partial_sector())
+		{
+			card_error("Failed to write to log file");
+			return;
+		}
+
+		if(!log_sd_retry([this]() { return file_.sync(); }, delay))
+		{
+			card_error("Failed to sync log file");
+			return;
+		}
+
+		sync_.synced(millis());
+	}
+
+	/** Write the partial sector at the end of the log buffer to a pre-allocated file
+	 *
+	 * Called by sync_file(). Strategies which only write whole blocks to the file hide it.
+	 *
+	 * @returns false if the write failed.
+	 */
+	bool write_partial_sector()
+	{
+		return !preallocated_ ||
+			   log_sd_retry([this]() { return log_write_partial_sector(file_, log_buffer_); },
+							delay);
+	}
+
+	/// Write `count` bytes of the log buffer, retrying if the write fails
+	bool write_buffer(size_t count)
+	{
+		// Data which was written is consumed, so a retry only writes the rest
+		size_t remaining = log_buffer_.size() - count;
+
+		return log_sd_retry(
+			[this, remaining]() {
+				return log_write_buffer(file_, log_buffer_, log_buffer_.size() - remaining);
+			},
+			delay);
+	}
+
+  protected:
+	SdFs* fs_ = nullptr;
+	mutable FsFile file_;
+
+	TBuffer log_buffer_;
+
+	/// Set when the file's clusters are reserved, so it is written in whole sectors
+	bool preallocated_ = false;
+
+	log_sync_tracker sync_;
+	/// Set during flush(), so a critical statement logged by it is synced afterwards
+	bool flushing_ = false;
+
+	log_sd_recovery<> recovery_;
+	/// Where resume_file() continues the log, as recorded by card_error()
+	uint64_t resume_position_ = 0;
+};
+
+#endif // SD_LOGGING_HPP_
@@ -0,0 +1,165 @@
+#ifndef SD_RECOVERY_HPP_
+#define SD_RECOVERY_HPP_
+
+#include "circular_buffer.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LOG_SD_RETRY_ATTEMPTS
+/// Number of attempts for each SD operation before the card is treated as unavailable
+#define LOG_SD_RETRY_ATTEMPTS 3
+#endif
+
+#ifndef LOG_SD_RETRY_DELAY_MS
+/// Delay before the first retry of an SD operation, in ms. Doubles for each further retry.
+#define LOG_SD_RETRY_DELAY_MS 5
+#endif
+
+#ifndef LOG_SD_RECOVERY_INTERVAL_MS
+/// Time between an SD failure and the first attempt to resume logging to the card, in ms.
+/// Doubles after each failed attempt, up to LOG_SD_RECOVERY_MAX_INTERVAL_MS.
+#define LOG_SD_RECOVERY_INTERVAL_MS 1000
+#endif
+
+#ifndef LOG_SD_RECOVERY_MAX_INTERVAL_MS
+/// Longest time between attempts to resume logging to the SD card, in ms
+#define LOG_SD_RECOVERY_MAX_INTERVAL_MS 60000
+#endif
+
+#ifndef LOG_SD_FALLBACK_SIZE
+/// Size of the RAM ring which holds log data while the SD card is unavailable.
+/// Must be a power of 2.
+#if defined(__AVR__)
+#define LOG_SD_FALLBACK_SIZE 256
+#else
+#define LOG_SD_FALLBACK_SIZE 2048
+#endif
+#endif
+
+/** Run an SD operation, retrying it with a growing delay if it fails
+ *
+ * The operation is attempted up to LOG_SD_RETRY_ATTEMPTS times. The first retry waits
+ * LOG_SD_RETRY_DELAY_MS, and each further retry waits twice as long as the one before.
+ *
+ * @param operation Callable returning true on success. It is called again after a failure,
+ *	so it must be safe to repeat.
+ * @param wait Callable which waits for the given number of ms (e.g., delay()).
+ * @returns true if an attempt succeeded.
+ */
+template<class TOperation, class TWait>
+bool log_sd_retry(TOperation operation, TWait wait)
+{
+	uint32_t delay_ms = LOG_SD_RETRY_DELAY_MS;
+
+	for(unsigned attempt = 1;; attempt++)
+	{
+		if(operation())
+		{
+			return true;
+		}
+
+		if(attempt >= LOG_SD_RETRY_ATTEMPTS)
+		{
+			return false;
+		}
+
+		wait(delay_ms);
+		delay_ms *= 2;
+	}
+}
+
+/** Tracks SD card failures, and holds log data while the card is unavailable
+ *
+ * When an SD operation still fails after log_sd_retry(), the strategy calls failed(). Until
+ * the card is available again, flushed data is moved to a RAM ring instead of the card. When
+ * the ring is full, the oldest data is overwritten.
+ *
+ * The strategy tries to resume logging to the card once due() returns true. The time between
+ * attempts starts at LOG_SD_RECOVERY_INTERVAL_MS and doubles after each failed attempt, up to
+ * LOG_SD_RECOVERY_MAX_INTERVAL_MS. When the card is available again, the held data is written
+ * first, so the log stays in order.
+ *
+ * @tparam TFallbackSize The size of the RAM ring, in bytes. Must be a power of 2.
+ */
+template<size_t TFallbackSize = LOG_SD_FALLBACK_SIZE>
+class log_sd_recovery
+{
+  public:
+	using fallback_t = CircularBuffer<char, TFallbackSize>;
+
+	/// False from a failure until the strategy has resumed logging to the card
+	bool available() const noexcept
+	{
+		return available_;
+	}
+
+	/// Record a failed SD operation (or recovery attempt) at `now` (in ms)
+	void failed(uint32_t now) noexcept
+	{
+		if(available_)
+		{
+			interval_ = LOG_SD_RECOVERY_INTERVAL_MS;
+		}
+		else
+		{
+			interval_ = (interval_ < LOG_SD_RECOVERY_MAX_INTERVAL_MS / 2)
+							? interval_ * 2
+							: LOG_SD_RECOVERY_MAX_INTERVAL_MS;
+		}
+
+		available_ = false;
+		failed_at_ = now;
+	}
+
+	/// True if the card is unavailable, and it is time to try to resume logging to it
+	bool due(uint32_t now) const noexcept
+	{
+		return !available_ && now - failed_at_ >= interval_;
+	}
+
+	/// Record that the strategy has resumed logging to the card
+	void recovered() noexcept
+	{
+		available_ = true;
+	}
+
+	/** Move all of the data in a log buffer to the RAM ring
+	 *
+	 * @param buffer The log buffer. Must provide peek_spans() and consume().
+	 * @returns the number of older bytes which were overwritten in the ring.
+	 */
+	template<class TBuffer>
+	size_t hold(TBuffer& buffer) noexcept
+	{
+		size_t dropped = 0;
+		typename TBuffer::span spans[2];
+
+		while(buffer.peek_spans(spans[0], spans[1]) > 0)
+		{
+			for(const auto& region : spans)
+			{
+				size_t free = fallback_.capacity() - fallback_.size();
+				dropped += (region.size > free) ? region.size - free : 0;
+
+				fallback_.put(region.data, region.size);
+				buffer.consume(region.size);
+			}
+		}
+
+		return dropped;
+	}
+
+	/// The data held while the card was unavailable, which is written before new data
+	fallback_t& fallback() noexcept
+	{
+		return fallback_;
+	}
+
+  private:
+	fallback_t fallback_;
+	uint32_t failed_at_ = 0;
+	uint32_t interval_ = LOG_SD_RECOVERY_INTERVAL_MS;
+	bool available_ = true;
+};
+
+#endif // SD_RECOVERY_HPP_
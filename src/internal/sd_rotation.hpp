@@ -0,0 +1,134 @@
+#ifndef SD_ROTATION_HPP_
+#define SD_ROTATION_HPP_
+
+#include <stdint.h>
+
+#ifndef LOG_SD_ROTATE_SIZE
+/// Default size, in bytes, at which a rotational SD strategy starts a new log file. 0 disables.
+#define LOG_SD_ROTATE_SIZE 0
+#endif
+
+#ifndef LOG_SD_ROTATE_INTERVAL_MS
+/// Default age, in ms, at which a rotational SD strategy starts a new log file. 0 disables.
+#define LOG_SD_ROTATE_INTERVAL_MS 0
+#endif
+
+#ifndef LOG_SD_MAX_FILES
+/// Default number of log files kept by a rotational SD strategy. 0 keeps every file.
+#define LOG_SD_MAX_FILES 0
+#endif
+
+/// Rotated log files are numbered 1..9999, which keeps the file names in 8.3 format
+constexpr uint16_t log_file_number_max = 9999;
+
+/// The file number after `number`, wrapping back to 1
+inline uint16_t log_next_file_number(uint16_t number) noexcept
+{
+	return (number >= log_file_number_max) ? 1 : static_cast<uint16_t>(number + 1);
+}
+
+/// The file number `count` files before `number`, wrapping like log_next_file_number()
+inline uint16_t log_previous_file_number(uint16_t number, uint16_t count) noexcept
+{
+	count = static_cast<uint16_t>(count % log_file_number_max);
+
+	return (number > count) ? static_cast<uint16_t>(number - count)
+							: static_cast<uint16_t>(number + log_file_number_max - count);
+}
+
+/** Read the log file counter from EEPROM
+ *
+ * The counter is stored in two bytes: the high byte at `address - 1` and the low byte at
+ * `address`. Older versions stored an 8-bit counter at `address`, which is still read
+ * correctly, since the unused high byte is erased (0xFF).
+ *
+ * @returns the number of the next log file, in 1..log_file_number_max.
+ */
+template<class TEEPROM>
+uint16_t log_read_file_counter(TEEPROM& eeprom, unsigned address)
+{
+	uint8_t high = eeprom.read(static_cast<int>(address - 1));
+	uint8_t low = eeprom.read(static_cast<int>(address));
+
+	// Both bytes erased: no counter has been stored yet
+	if(high == 0xFF && low == 0xFF)
+	{
+		return 1;
+	}
+
+	uint16_t value = (high == 0xFF) ? low : static_cast<uint16_t>((high << 8) | low);
+
+	// An invalid value starts over at 1
+	if(value == 0 || value > log_file_number_max)
+	{
+		value = 1;
+	}
+
+	return value;
+}
+
+/// Store the log file counter in EEPROM. See log_read_file_counter().
+template<class TEEPROM>
+void log_write_file_counter(TEEPROM& eeprom, unsigned address, uint16_t value)
+{
+	eeprom.write(static_cast<int>(address - 1), static_cast<uint8_t>(value >> 8));
+	eeprom.write(static_cast<int>(address), static_cast<uint8_t>(value & 0xFF));
+}
+
+/** Controls when a rotational SD strategy starts a new log file
+ *
+ * A new file is always started by begin(). With a size or age limit, a new file is also
+ * started while logging, once the current file reaches the limit. Rotation happens between
+ * log statements, so a statement is never split across files.
+ */
+struct log_rotation_policy
+{
+	/// Start a new file once the log reaches this many bytes. 0 disables. With compression,
+	/// the bytes written to the file are compressed, and the buffered bytes are not.
+	uint32_t max_size = LOG_SD_ROTATE_SIZE;
+
+	/// Start a new file once the current file is this many ms old. 0 disables.
+	uint32_t max_age_ms = LOG_SD_ROTATE_INTERVAL_MS;
+
+	/// Delete the oldest log files, so at most this many remain. 0 keeps every file.
+	uint16_t max_files = LOG_SD_MAX_FILES;
+};
+
+/// Tracks the size and age of the current log file, according to a log_rotation_policy
+class log_rotation_tracker
+{
+  public:
+	const log_rotation_policy& policy() const noexcept
+	{
+		return policy_;
+	}
+
+	void policy(const log_rotation_policy& policy) noexcept
+	{
+		policy_ = policy;
+	}
+
+	/// Record that a new file was opened at `now` (in ms)
+	void opened(uint32_t now) noexcept
+	{
+		opened_at_ = now;
+	}
+
+	/** Check whether the current file should be rotated
+	 *
+	 * @param size The size of the log, including data which has not been written yet.
+	 * @param now The current time, in ms.
+	 * @returns true if the file has reached a limit of the policy.
+	 */
+	bool due(uint64_t size, uint32_t now) const noexcept
+	{
+		return (policy_.max_size > 0 && size >= policy_.max_size) ||
+			   (policy_.max_age_ms > 0 && now - opened_at_ >= policy_.max_age_ms);
+	}
+
+  private:
+	log_rotation_policy policy_;
+	uint32_t opened_at_ = 0;
+};
+
+#endif // SD_ROTATION_HPP_
@@ -0,0 +1,89 @@
+#ifndef SD_SYNC_POLICY_HPP_
+#define SD_SYNC_POLICY_HPP_
+
+#include <stdint.h>
+
+#ifndef LOG_SD_SYNC_FLUSHES
+/// Default number of flushes between syncs of an open SD log file. 0 disables.
+#define LOG_SD_SYNC_FLUSHES 8
+#endif
+
+#ifndef LOG_SD_SYNC_INTERVAL_MS
+/// Default maximum time between syncs of an open SD log file, in ms. 0 disables.
+#define LOG_SD_SYNC_INTERVAL_MS 1000
+#endif
+
+#ifndef LOG_SD_SYNC_ON_CRITICAL
+/// By default, critical statements are flushed and synced to the SD card immediately.
+#define LOG_SD_SYNC_ON_CRITICAL true
+#endif
+
+/** Controls when an SD logging strategy syncs its log file
+ *
+ * The SD strategies keep the log file open between flushes. Flushed data is written to the
+ * file, but the file's directory entry and FAT are only updated by sync() (or close()). Data
+ * written since the last sync may be lost on a reset or power loss.
+ *
+ * A sync happens after a flush when any of the enabled conditions is met.
+ */
+struct log_sync_policy
+{
+	/// Sync after this many flushes. 0 disables syncing by count.
+	uint16_t flushes = LOG_SD_SYNC_FLUSHES;
+
+	/// Sync on the first flush at least this many ms after the last sync. 0 disables.
+	uint32_t interval_ms = LOG_SD_SYNC_INTERVAL_MS;
+
+	/// Flush and sync immediately after a critical statement is logged
+	bool on_critical = LOG_SD_SYNC_ON_CRITICAL;
+};
+
+/// Tracks the flushes and time since the last sync, according to a log_sync_policy
+class log_sync_tracker
+{
+  public:
+	const log_sync_policy& policy() const noexcept
+	{
+		return policy_;
+	}
+
+	void policy(const log_sync_policy& policy) noexcept
+	{
+		policy_ = policy;
+	}
+
+	/// Sync after the next flush, regardless of the policy
+	void request() noexcept
+	{
+		requested_ = true;
+	}
+
+	/** Record a flush
+	 *
+	 * @param now The current time, in ms.
+	 * @returns true if the file should be synced now.
+	 */
+	bool flushed(uint32_t now) noexcept
+	{
+		flushes_++;
+
+		return requested_ || (policy_.flushes > 0 && flushes_ >= policy_.flushes) ||
+			   (policy_.interval_ms > 0 && now - last_sync_ >= policy_.interval_ms);
+	}
+
+	/// Record a sync at `now` (in ms)
+	void synced(uint32_t now) noexcept
+	{
+		flushes_ = 0;
+		last_sync_ = now;
+		requested_ = false;
+	}
+
+  private:
+	log_sync_policy policy_;
+	uint16_t flushes_ = 0;
+	uint32_t last_sync_ = 0;
+	bool requested_ = false;
+};
+
+#endif // SD_SYNC_POLICY_HPP_
@@ -0,0 +1,239 @@
+#ifndef SLOT_BUFFER_HPP_
+#define SLOT_BUFFER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Log buffer made of several fixed-size slots (ping-pong buffering)
+ *
+ * New data is added to the active slot. When the active slot is full, it is handed off by
+ * advancing to the next free slot, so new data goes to a different slot while the full one
+ * is written out. The hand-off only moves an index; data is never copied between slots.
+ *
+ * Each slot is filled from its start, so the data in a slot is always contiguous. Space which
+ * was consumed from the start of a slot is reused once the whole slot is free. The exception is
+ * the active slot, when it holds all of the data: if it fills up, its data is moved to the start
+ * of the slot. This only happens after a write which ended within the slot.
+ *
+ * The buffer provides the span interface of CircularBuffer (peek_spans() and consume()), so it
+ * can be used with log_write_buffer(). When every slot is full, put() stops adding data; old
+ * data is never overwritten.
+ *
+ * @tparam T The element type.
+ * @tparam TSlotSize The number of elements in each slot.
+ * @tparam TSlotCount The number of slots. With one slot, this is a linear buffer.
+ */
+template<class T, size_t TSlotSize, size_t TSlotCount>
+class SlotBuffer
+{
+	static_assert(TSlotSize > 0 && TSlotCount > 0, "SlotBuffer requires at least one slot");
+
+  public:
+	/// A contiguous region of the buffer's storage
+	struct span
+	{
+		const T* data;
+		size_t size;
+	};
+
+	/** Add data to the active slot, handing off slots as they fill
+	 *
+	 * @returns the number of elements which were added. Less than `count` if every slot is
+	 * full.
+	 */
+	size_t put(const T* items, size_t count) noexcept
+	{
+		size_t added = 0;
+
+		while(added < count)
+		{
+			if(fill_[active_] == TSlotSize)
+			{
+				if(oldest_ != active_ || read_ == 0)
+				{
+					break;
+				}
+
+				compact();
+			}
+
+			size_t space = TSlotSize - fill_[active_];
+			size_t n = (count - added < space) ? count - added : space;
+
+			memcpy(&slots_[active_][fill_[active_]], items + added, n * sizeof(T));
+			fill_[active_] += n;
+			size_ += n;
+			added += n;
+
+			if(fill_[active_] == TSlotSize)
+			{
+				hand_off();
+			}
+		}
+
+		return added;
+	}
+
+	/// True if a full slot has been handed off and is waiting to be written
+	bool ready() const noexcept
+	{
+		return oldest_ != active_;
+	}
+
+	/** Get the two oldest regions of data without removing them
+	 *
+	 * The first region is the rest of the oldest slot. The second region is the next slot, if
+	 * it holds data.
+	 *
+	 * @returns the total size of both regions.
+	 */
+	size_t peek_spans(span& first, span& second) const noexcept
+	{
+		first.data = &slots_[oldest_][read_];
+		first.size = fill_[oldest_] - read_;
+
+		size_t next = next_slot(oldest_);
+		bool has_next = ready();
+		second.data = slots_[next];
+		second.size = has_next ? fill_[next] : 0;
+
+		return first.size + second.size;
+	}
+
+	/// Remove up to `count` elements, oldest first. Emptied slots become free.
+	void consume(size_t count) noexcept
+	{
+		count = (count < size_) ? count : size_;
+		size_ -= count;
+
+		while(count > 0)
+		{
+			size_t available = fill_[oldest_] - read_;
+			size_t n = (count < available) ? count : available;
+			read_ += n;
+			count -= n;
+
+			if(read_ == fill_[oldest_])
+			{
+				release_oldest();
+			}
+		}
+	}
+
+	void reset() noexcept
+	{
+		for(size_t i = 0; i < TSlotCount; i++)
+		{
+			fill_[i] = 0;
+		}
+
+		oldest_ = 0;
+		active_ = 0;
+		read_ = 0;
+		size_ = 0;
+	}
+
+	bool empty() const noexcept
+	{
+		return size_ == 0;
+	}
+
+	bool full() const noexcept
+	{
+		return size_ == capacity();
+	}
+
+	static constexpr size_t capacity() noexcept
+	{
+		return TSlotSize * TSlotCount;
+	}
+
+	size_t size() const noexcept
+	{
+		return size_;
+	}
+
+	/** The number of elements which put() can add
+	 *
+	 * This is less than `capacity() - size()` while data remains in an older slot, since
+	 * consumed space is only reused once the whole slot is free.
+	 */
+	size_t available() const noexcept
+	{
+		size_t used_slots = ((active_ + TSlotCount - oldest_) % TSlotCount) + 1;
+		size_t reusable = (oldest_ == active_) ? read_ : 0;
+
+		return (TSlotSize - fill_[active_]) + reusable + (TSlotCount - used_slots) * TSlotSize;
+	}
+
+	static constexpr size_t slot_size() noexcept
+	{
+		return TSlotSize;
+	}
+
+  private:
+	static size_t next_slot(size_t slot) noexcept
+	{
+		return (slot + 1 < TSlotCount) ? slot + 1 : 0;
+	}
+
+	/// Make the next slot active, if it is free
+	void hand_off() noexcept
+	{
+		size_t next = next_slot(active_);
+
+		if(next != oldest_)
+		{
+			active_ = next;
+			fill_[active_] = 0;
+		}
+	}
+
+	/// Move the unread data in the active slot to the start of the slot
+	void compact() noexcept
+	{
+		size_t unread = fill_[active_] - read_;
+		memmove(slots_[active_], &slots_[active_][read_], unread * sizeof(T));
+		fill_[active_] = unread;
+		read_ = 0;
+	}
+
+	/// Free the oldest slot once all of its data has been consumed
+	void release_oldest() noexcept
+	{
+		read_ = 0;
+
+		if(oldest_ == active_)
+		{
+			// The active slot starts over, so new data is written from the start of the slot
+			fill_[active_] = 0;
+		}
+		else
+		{
+			bool was_full = (fill_[active_] == TSlotSize);
+			oldest_ = next_slot(oldest_);
+
+			// The active slot could not be handed off while every slot was in use
+			if(was_full)
+			{
+				hand_off();
+			}
+		}
+	}
+
+  private:
+	T slots_[TSlotCount][TSlotSize];
+	size_t fill_[TSlotCount] = {};
+
+	/// The slot which receives new data
+	size_t active_ = 0;
+
+	/// The slot holding the oldest data, and the number of elements consumed from it
+	size_t oldest_ = 0;
+	size_t read_ = 0;
+
+	size_t size_ = 0;
+};
+
+#endif // SLOT_BUFFER_HPP_
@@ -0,0 +1,185 @@
+#include <AsyncFlushLogger.h>
+#include <CircularBufferLogger.h>
+#include <MPSCLogBufferLogger.h>
+#include <atomic>
+#include <catch.hpp>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <test_helper.hpp>
+#include <thread>
+#include <vector>
+
+using Backend = CircularLogBufferLogger<128>;
+
+static void count_wakes(void* arg)
+{
+	(*reinterpret_cast<unsigned*>(arg))++;
+}
+
+TEST_CASE("Async: Create a logger", "[AsyncFlushLogger]")
+{
+	AsyncFlushLogger<Backend, 1024> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+	CHECK(true == logger.backend().auto_flush());
+	CHECK(false == logger.backend().echo());
+}
+
+TEST_CASE("Async: Flush moves statements through the backend", "[AsyncFlushLogger]")
+{
+	AsyncFlushLogger<Backend, 1024> logger;
+	log_buffer_output.clear();
+	std::string expected;
+
+	for(int i = 0; i < 20; i++)
+	{
+		logger.info("statement %d\n", i);
+		expected += construct_log_string(log_level_e::info, "statement ") + std::to_string(i) +
+					"\n";
+	}
+
+	// Nothing reaches the output until the buffer is flushed
+	CHECK(log_buffer_output.empty());
+
+	logger.flush();
+	CHECK(log_buffer_output == expected);
+	CHECK(0 == logger.size());
+	CHECK(0 == logger.backend().size());
+}
+
+TEST_CASE("Async: Wake hook is called at the high watermark", "[AsyncFlushLogger]")
+{
+	AsyncFlushLogger<Backend, 256> logger;
+	unsigned wakes = 0;
+	const log_wake_hook hook{&count_wakes, &wakes};
+	log_buffer_output.clear();
+
+	logger.set_watermarks(128, 32);
+	logger.set_wake_hook(&hook);
+
+	while(logger.size() < 128)
+	{
+		CHECK(0 == wakes);
+		logger.print("0123456789\n");
+	}
+
+	CHECK(1 == wakes);
+
+	// The hook is not called again until the worker drains the buffer
+	logger.print("0123456789\n");
+	CHECK(1 == wakes);
+
+	logger.drain();
+	CHECK(logger.size() <= 32);
+	CHECK(false == log_buffer_output.empty());
+
+	while(logger.size() < 128)
+	{
+		logger.print("0123456789\n");
+	}
+
+	CHECK(2 == wakes);
+
+	logger.flush();
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Async: Statements reach the backend with their level", "[AsyncFlushLogger]")
+{
+	log_buffer_output.clear();
+
+	SECTION("Backend which accepts statements")
+	{
+		AsyncFlushLogger<Backend, 1024> logger;
+		logger.backend().level(log_level_e::warning);
+
+		logger.info("info\n");
+		logger.error("error\n");
+		logger.print("print\n");
+		logger.flush();
+	}
+
+	SECTION("Backend which formats its own records")
+	{
+		AsyncFlushLogger<MPSCLogBufferLogger<1024>, 1024> logger;
+		logger.backend().level(log_level_e::warning);
+
+		logger.info("info\n");
+		logger.error("error\n");
+		logger.print("print\n");
+		logger.flush();
+	}
+
+	CHECK(log_buffer_output == construct_log_string(log_level_e::error, "error\n") + "print\n");
+}
+
+TEST_CASE("Async: Background worker", "[AsyncFlushLogger]")
+{
+	constexpr unsigned producer_count = 2;
+	constexpr unsigned statements = 2000;
+
+	static AsyncFlushLogger<Backend, 1024> logger;
+	logger.clear();
+	log_buffer_output.clear();
+	logger.start();
+
+	std::vector<std::thread> producers;
+
+	for(unsigned t = 0; t < producer_count; t++)
+	{
+		producers.emplace_back([t]() {
+			for(unsigned i = 0; i < statements; i++)
+			{
+				logger.info("thread %u statement %u\n", t, i);
+			}
+		});
+	}
+
+	for(auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	// Output is only safe to inspect once the worker has stopped
+	logger.stop();
+	CHECK(0 == logger.size());
+
+	std::istringstream output(log_buffer_output);
+	std::string line;
+	unsigned received = 0;
+	unsigned dropped = 0;
+	long last[producer_count];
+	std::fill(last, last + producer_count, -1L);
+
+	while(std::getline(output, line))
+	{
+		unsigned t;
+		unsigned i;
+		unsigned long events;
+		unsigned long bytes;
+		unsigned long records;
+
+		if(sscanf(line.c_str(), "<I> thread %u statement %u", &t, &i) == 2)
+		{
+			REQUIRE(t < producer_count);
+			CHECK(static_cast<long>(i) > last[t]);
+			last[t] = i;
+			received++;
+		}
+		else
+		{
+			REQUIRE(sscanf(line.c_str(),
+						   "<!> ---Log buffer overrun detected: %lu events, %lu bytes, %lu records",
+						   &events, &bytes, &records) == 3);
+			dropped += static_cast<unsigned>(records);
+		}
+	}
+
+	CHECK(received > 0);
+	CHECK(received + dropped == producer_count * statements);
+}
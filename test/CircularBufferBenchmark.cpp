@@ -0,0 +1,97 @@
+// Throughput benchmark for CircularBuffer
+//
+// Compares moving data through the buffer one element at a time with the bulk put()/get()
+// functions, for a power-of-2 size (mask indexing) and another size (modulo indexing).
+// On Linux, MirroredRingBuffer (single-copy wrap) is measured as well.
+
+#include <chrono>
+#include <cstdio>
+#include <internal/circular_buffer.hpp>
+#if defined(__linux__)
+#include <internal/mirrored_ring_buffer.hpp>
+#endif
+
+static constexpr size_t chunk_size = 64;
+static constexpr size_t total_bytes = 256 * 1024 * 1024;
+
+// Keeps the compiler from discarding the data which is read back
+static volatile unsigned checksum = 0;
+
+template<class TBuffer>
+static void run_per_element(const char* name)
+{
+	static TBuffer buffer;
+	char chunk[chunk_size];
+	unsigned sum = 0;
+
+	for(size_t i = 0; i < chunk_size; i++)
+	{
+		chunk[i] = static_cast<char>(i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for(size_t n = 0; n < total_bytes; n += chunk_size)
+	{
+		for(size_t i = 0; i < chunk_size; i++)
+		{
+			buffer.put(chunk[i]);
+		}
+
+		for(size_t i = 0; i < chunk_size; i++)
+		{
+			sum += static_cast<unsigned char>(buffer.get());
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	checksum = checksum + sum;
+
+	printf("%-8s %6zu bytes, per element: %.3f bytes/ns\n", name, buffer.capacity(),
+		   total_bytes / ns);
+}
+
+template<class TBuffer>
+static void run_bulk(const char* name)
+{
+	static TBuffer buffer;
+	char chunk[chunk_size];
+	char out[chunk_size];
+	unsigned sum = 0;
+
+	for(size_t i = 0; i < chunk_size; i++)
+	{
+		chunk[i] = static_cast<char>(i);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for(size_t n = 0; n < total_bytes; n += chunk_size)
+	{
+		buffer.put(chunk, chunk_size);
+		buffer.get(out, chunk_size);
+		sum += static_cast<unsigned char>(out[n % chunk_size]);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	checksum = checksum + sum;
+
+	printf("%-8s %6zu bytes, bulk:        %.3f bytes/ns\n", name, buffer.capacity(),
+		   total_bytes / ns);
+}
+
+int main()
+{
+	run_per_element<CircularBuffer<char, 4096>>("mask");
+	run_bulk<CircularBuffer<char, 4096>>("mask");
+	run_per_element<CircularBuffer<char, 4000>>("modulo");
+	run_bulk<CircularBuffer<char, 4000>>("modulo");
+#if defined(__linux__)
+	run_per_element<MirroredRingBuffer<char, 4096>>("mirrored");
+	run_bulk<MirroredRingBuffer<char, 4096>>("mirrored");
+#endif
+
+	return 0;
+}
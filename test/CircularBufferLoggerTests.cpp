@@ -1,7 +1,11 @@
 #include <CircularBufferLogger.h>
 #include <catch.hpp>
+#if defined(__linux__)
+#include <internal/mirrored_ring_buffer.hpp>
+#endif
 #include <string>
 #include <test_helper.hpp>
+#include <type_traits>
 
 TEST_CASE("CB: Create a logger", "[CircularBufferLogger]")
 {
@@ -96,3 +100,424 @@ TEST_CASE("CB: Log level checks", "[CircularBufferLogger]")
 	logger.flush();
 	CHECK(log_buffer_output == construct_log_string(log_level_e::debug, test_string));
 }
+
+TEST_CASE("CB: Statements longer than the staging buffer", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	std::string message(LOG_STAGING_BUFFER_SIZE * 3 + 5, 'x');
+	logger.info("%s\n", message.c_str());
+	CHECK(logger.size() == message.size() + 1 + prefix_len);
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, (message + "\n").c_str()));
+}
+
+TEST_CASE("CB: Auto-flush writes spans up to capacity", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<16> logger;
+	logger.auto_flush(true);
+	log_buffer_output.clear();
+
+	logger.info("0123456789abcdefghijklmnopqrstuvwxyz");
+	// Output flushed each time the buffer filled, so nothing was overwritten
+	CHECK(false == logger.has_overrun());
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_log_string(log_level_e::info, "0123456789abcdefghijklmnopqrstuvwxyz"));
+}
+
+TEST_CASE("CB: Overrun without auto-flush keeps the newest data", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<16> logger;
+	log_buffer_output.clear();
+
+	logger.print("0123456789abcdefghij");
+	CHECK(true == logger.has_overrun());
+	CHECK(16 == logger.size());
+
+	auto stats = logger.overrun_stats();
+	CHECK(1 == stats.events);
+	CHECK(4 == stats.dropped_bytes);
+	CHECK(0 == stats.dropped_records);
+	CHECK(16 == stats.high_water_mark);
+
+	logger.clear();
+	logger.print("klmnop");
+	logger.flush();
+	CHECK(log_buffer_output == "klmnop");
+}
+
+TEST_CASE("CB: Drop-newest policy keeps the oldest data", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<16, log_full_policy::drop_newest> logger;
+	log_buffer_output.clear();
+
+	logger.print("0123456789abcdefghij");
+	logger.print("klmnop");
+	CHECK(true == logger.has_overrun());
+	CHECK(16 == logger.size());
+	CHECK(2 == logger.overrun_stats().events);
+	CHECK(10 == logger.overrun_stats().dropped_bytes);
+
+	logger.clear();
+	logger.print("0123456789abcdef");
+	logger.flush();
+	CHECK(log_buffer_output == "0123456789abcdef");
+}
+
+TEST_CASE("CB: Flush-and-block policy flushes with auto-flush disabled", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<16, log_full_policy::flush_and_block> logger;
+	CHECK(false == logger.auto_flush());
+	log_buffer_output.clear();
+
+	logger.print("0123456789abcdefghij");
+	CHECK(false == logger.has_overrun());
+	CHECK(log_buffer_output == "0123456789abcdef");
+
+	logger.flush();
+	CHECK(log_buffer_output == "0123456789abcdefghij");
+}
+
+TEST_CASE("CB: Strategy hooks are statically dispatched", "[CircularBufferLogger]")
+{
+	// No vtable is required for LoggerBaseT strategies
+	CHECK(false == std::is_polymorphic<CircularLogBufferLogger<1024>>::value);
+
+	PlatformLogger_t<CircularLogBufferLogger<1024>>::clear();
+	log_buffer_output.clear();
+	PlatformLogger_t<CircularLogBufferLogger<1024>>::warning("static %s", "dispatch");
+	PlatformLogger_t<CircularLogBufferLogger<1024>>::flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::warning, "static dispatch"));
+}
+
+TEST_CASE("CB: Overrun statistics are reported by flush", "[CircularBufferLogger]")
+{
+	using Logger = PlatformLogger_t<CircularLogBufferLogger<128>>;
+	Logger::clear();
+	log_buffer_output.clear();
+
+	Logger::print("%s", std::string(100, 'x').c_str());
+	CHECK(100 == Logger::overrun_stats().high_water_mark);
+	Logger::print("%s", std::string(40, 'y').c_str());
+	Logger::print("%s", std::string(8, 'z').c_str());
+	CHECK(true == Logger::has_overrun());
+
+	auto stats = Logger::overrun_stats();
+	CHECK(2 == stats.events);
+	CHECK(20 == stats.dropped_bytes);
+	CHECK(128 == stats.high_water_mark);
+
+	Logger::flush();
+	CHECK(log_buffer_output.find("---Log buffer overrun detected: 2 events, 20 bytes, 0 records "
+								 "lost, 128 bytes peak---\n") != std::string::npos);
+	CHECK(false == Logger::has_overrun());
+	CHECK(0 == Logger::overrun_stats().events);
+}
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+TEST_CASE("CB: Interrupt statements are queued until the next log or flush",
+		  "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("first\n");
+	auto size = logger.size();
+
+	// Logger settings are not modified by the interrupt path
+	logger.echo(true);
+	logger.auto_flush(true);
+	logger.warning_interrupt("from interrupt %d\n", 1);
+	CHECK(size == logger.size());
+	CHECK(true == logger.echo());
+	CHECK(true == logger.auto_flush());
+	logger.echo(false);
+
+	logger.info("second\n");
+	logger.error_interrupt("from interrupt %d\n", 2);
+	logger.flush();
+
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "first\n") +
+								   construct_log_string(log_level_e::warning,
+														"from interrupt 1\n") +
+								   construct_log_string(log_level_e::info, "second\n") +
+								   construct_log_string(log_level_e::error,
+														"from interrupt 2\n"));
+}
+
+namespace
+{
+CircularLogBufferLogger<64>* interrupted_logger = nullptr;
+
+// Simulates an interrupt which logs once while the log buffer is written to the output
+void log_from_interrupt()
+{
+	putchar_hook = nullptr;
+	interrupted_logger->warning_interrupt("ISR\n");
+}
+} // namespace
+
+TEST_CASE("CB: Interrupt statements are not added in the middle of a statement",
+		  "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<64> logger;
+	std::string statement(300, 'a');
+	log_buffer_output.clear();
+	logger.auto_flush(true);
+
+	// The statement does not fit, so it is auto-flushed while it is committed
+	interrupted_logger = &logger;
+	putchar_hook = &log_from_interrupt;
+	logger.info("%s\n", statement.c_str());
+	putchar_hook = nullptr;
+	logger.flush();
+
+	CHECK(log_buffer_output ==
+		  construct_log_string(log_level_e::info, (statement + "\n").c_str()) +
+			  construct_log_string(log_level_e::warning, "ISR\n"));
+}
+
+TEST_CASE("CB: Interrupt statements which do not fit are reported", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 100; i++)
+	{
+		logger.info_interrupt("interrupt statement %d\n", i);
+	}
+
+	CHECK(0 == logger.size());
+
+	logger.flush();
+	CHECK(log_buffer_output.find("interrupt statement 0\n") != std::string::npos);
+	CHECK(log_buffer_output.find("interrupt statement 99\n") == std::string::npos);
+	CHECK(log_buffer_output.find("records lost") != std::string::npos);
+
+	// The queue is empty again after it is moved into the log buffer
+	log_buffer_output.clear();
+	logger.info_interrupt("interrupt statement %d\n", 100);
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_log_string(log_level_e::info, "interrupt statement 100\n"));
+}
+#endif
+
+TEST_CASE("CB: Buffer contents are returned as contiguous spans", "[CircularBuffer]")
+{
+	CircularBuffer<char, 8> buffer;
+	CircularBuffer<char, 8>::span first;
+	CircularBuffer<char, 8>::span second;
+
+	CHECK(0 == buffer.peek_spans(first, second));
+	CHECK(0 == first.size);
+	CHECK(0 == second.size);
+
+	buffer.put("abcde", 5);
+	CHECK(5 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "abcde");
+	CHECK(0 == second.size);
+
+	// Wrap around the end of the storage
+	buffer.consume(3);
+	buffer.put("fghij", 5);
+	CHECK(7 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "defgh");
+	CHECK(std::string(second.data, second.size) == "ij");
+
+	// Overwritten data is not returned
+	buffer.put("kl", 2);
+	CHECK(8 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) + std::string(second.data, second.size) ==
+		  "efghijkl");
+}
+
+TEST_CASE("CB: Consume removes data from the front", "[CircularBuffer]")
+{
+	CircularBuffer<char, 8> buffer;
+	CircularBuffer<char, 8>::span first;
+	CircularBuffer<char, 8>::span second;
+
+	buffer.put("abcdefgh", 8);
+	CHECK(true == buffer.full());
+
+	// A partial read only releases what was read
+	buffer.consume(3);
+	CHECK(false == buffer.full());
+	CHECK(5 == buffer.size());
+	CHECK('d' == buffer.get());
+
+	buffer.consume(100);
+	CHECK(true == buffer.empty());
+	CHECK(0 == buffer.peek_spans(first, second));
+}
+
+TEST_CASE("CB: Bulk put and get wrap around the storage", "[CircularBuffer]")
+{
+	CircularBuffer<char, 6> buffer;
+	char out[8] = {};
+
+	buffer.put("abcd", 4);
+	CHECK(2 == buffer.get(out, 2));
+	CHECK(std::string(out, 2) == "ab");
+
+	buffer.put("efgh", 4);
+	CHECK(true == buffer.full());
+	CHECK(6 == buffer.get(out, sizeof(out)));
+	CHECK(std::string(out, 6) == "cdefgh");
+	CHECK(true == buffer.empty());
+	CHECK(0 == buffer.get(out, sizeof(out)));
+}
+
+TEST_CASE("CB: Bulk put overwrites the oldest data", "[CircularBuffer]")
+{
+	CircularBuffer<char, 8> buffer;
+	char out[8] = {};
+
+	buffer.put("abcdef", 6);
+	buffer.put("ghij", 4);
+	CHECK(8 == buffer.size());
+	CHECK(8 == buffer.get(out, sizeof(out)));
+	CHECK(std::string(out, 8) == "cdefghij");
+
+	// Only the newest data is kept when more than the capacity is added at once
+	buffer.put("0123456789", 10);
+	CHECK(true == buffer.full());
+	CHECK(8 == buffer.get(out, sizeof(out)));
+	CHECK(std::string(out, 8) == "23456789");
+}
+
+TEST_CASE("CB: Indices use the smallest type for the buffer size", "[CircularBuffer]")
+{
+	CHECK(std::is_same<circular_buffer_index<1>::type, uint8_t>::value);
+	CHECK(std::is_same<circular_buffer_index<256>::type, uint8_t>::value);
+	CHECK(std::is_same<circular_buffer_index<257>::type, uint16_t>::value);
+	CHECK(std::is_same<circular_buffer_index<64 * 1024>::type, uint16_t>::value);
+	CHECK(std::is_same<circular_buffer_index<64 * 1024 + 1>::type, uint32_t>::value);
+
+	// Two indices and the full flag
+	CHECK(sizeof(CircularBuffer<char, 256>) == 256 + 3);
+}
+
+TEST_CASE("CB: A 256-byte buffer wraps with 8-bit indices", "[CircularBuffer]")
+{
+	CircularBuffer<char, 256> buffer;
+	std::string expected;
+
+	for(int i = 0; i < 300; i++)
+	{
+		buffer.put(static_cast<char>('a' + i % 26));
+	}
+
+	for(int i = 300 - 256; i < 300; i++)
+	{
+		expected += static_cast<char>('a' + i % 26);
+	}
+
+	CHECK(256 == buffer.size());
+
+	std::string output;
+	while(!buffer.empty())
+	{
+		output += buffer.get();
+	}
+
+	CHECK(output == expected);
+}
+
+#if defined(__linux__)
+TEST_CASE("CB: Mirrored buffer returns wrapped data as one span", "[MirroredRingBuffer]")
+{
+	MirroredRingBuffer<char, 4096> buffer;
+	MirroredRingBuffer<char, 4096>::span first;
+	MirroredRingBuffer<char, 4096>::span second;
+	std::string data(4000, 'a');
+
+	REQUIRE(4096 == buffer.capacity());
+
+	buffer.put(data.data(), data.size());
+	buffer.consume(data.size());
+
+	// Straddles the end of the storage
+	buffer.put("0123456789abcdefghij", 20);
+	CHECK(20 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "0123456789abcdefghij");
+	CHECK(0 == second.size);
+
+	buffer.put(std::string(100, 'b').data(), 100);
+	CHECK(120 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, 20) == "0123456789abcdefghij");
+	CHECK(std::string(first.data + 20, 100) == std::string(100, 'b'));
+	CHECK(0 == second.size);
+
+	char out[120];
+	CHECK(120 == buffer.get(out, sizeof(out)));
+	CHECK(std::string(out, 20) == "0123456789abcdefghij");
+	CHECK(true == buffer.empty());
+}
+
+TEST_CASE("CB: Mirrored buffer overwrites the oldest data", "[MirroredRingBuffer]")
+{
+	MirroredRingBuffer<char, 4096> buffer;
+	std::string data;
+
+	for(int i = 0; i < 5000; i++)
+	{
+		data += static_cast<char>('a' + i % 26);
+	}
+
+	buffer.put(data.data(), 3000);
+	buffer.put(data.data() + 3000, 2000);
+	CHECK(true == buffer.full());
+
+	std::string output;
+	while(!buffer.empty())
+	{
+		output += buffer.get();
+	}
+
+	CHECK(output == data.substr(5000 - 4096));
+
+	// Only the newest data is kept when more than the capacity is added at once
+	buffer.put(data.data(), data.size());
+	buffer.put('!');
+	CHECK(4096 == buffer.size());
+	CHECK(data.substr(5000 - 4095) + "!" == [&buffer] {
+		std::string contents;
+		while(!buffer.empty())
+		{
+			contents += buffer.get();
+		}
+		return contents;
+	}());
+}
+
+TEST_CASE("CB: Logger with mirrored storage", "[CircularBufferLogger]")
+{
+	CircularLogBufferLogger<4096, log_full_policy::overwrite_oldest, MirroredRingBuffer> logger;
+	log_buffer_output.clear();
+
+	CHECK(4096 == logger.capacity());
+
+	logger.debug("Hello world\n");
+	CHECK(logger.size() == strlen("Hello world\n") + prefix_len);
+	logger.flush();
+	CHECK(log_buffer_output == "<D> Hello world\n");
+	CHECK(0 == logger.size());
+
+	// Keep wrapping past the end of the storage; only the newest data is kept
+	for(int i = 0; i < 500; i++)
+	{
+		logger.print("%03d-456789\n", i);
+	}
+
+	CHECK(4096 == logger.size());
+	CHECK(true == logger.has_overrun());
+	log_buffer_output.clear();
+	logger.flush();
+	CHECK(log_buffer_output.substr(4096 - 11, 11) == "499-456789\n");
+}
+#endif
@@ -87,3 +87,78 @@ TEST_CASE("Log Level to Short String", "[CoreLogger]")
 	auto off = LOG_LEVEL_TO_SHORT_C_STRING(log_level_e::off);
 	CHECK(0 == strcmp("O", off));
 }
+
+namespace
+{
+/// Strategy using the dynamically-dispatched LoggerBase interface
+class VirtualStringLogger final : public LoggerBase
+{
+  public:
+	size_t size() const noexcept final
+	{
+		return buffer_.size();
+	}
+
+	size_t capacity() const noexcept final
+	{
+		return 1024;
+	}
+
+	std::string buffer_;
+	std::string echo_;
+	size_t echo_calls_ = 0;
+
+  protected:
+	void log_echo(const char* data, size_t len) noexcept final
+	{
+		echo_.append(data, len);
+		echo_calls_++;
+	}
+
+	void log_putc(char c) noexcept final
+	{
+		buffer_ += c;
+	}
+
+	void flush_() noexcept final
+	{
+		log_buffer_output += buffer_;
+		buffer_.clear();
+	}
+};
+} // namespace
+
+TEST_CASE("LoggerBase strategies dispatch through virtual hooks", "[CoreLogger]")
+{
+	VirtualStringLogger logger;
+	LoggerBase& base = logger;
+	log_buffer_output.clear();
+
+	logger.info("value %d\n", 42);
+	CHECK(logger.buffer_ == construct_log_string(log_level_e::info, "value 42\n"));
+	CHECK(base.size() == logger.buffer_.size());
+
+	base.flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "value 42\n"));
+	CHECK(0 == base.size());
+}
+
+TEST_CASE("Echo receives the formatted statement in spans", "[CoreLogger]")
+{
+	VirtualStringLogger logger;
+	log_buffer_output.clear();
+	logger.echo(true);
+
+	logger.warning("value %d\n", 42);
+	logger.print("raw %s\n", "text");
+
+	// Each statement is formatted once and sent to the buffer and the console together
+	CHECK(logger.echo_ == logger.buffer_);
+	CHECK(logger.echo_ == construct_log_string(log_level_e::warning, "value 42\n") + "raw text\n");
+	CHECK(2 == logger.echo_calls_);
+	CHECK(log_buffer_output.empty());
+
+	logger.echo(false);
+	logger.info("quiet\n");
+	CHECK(2 == logger.echo_calls_);
+}
@@ -0,0 +1,236 @@
+#include <DeferredLogBufferLogger.h>
+#include <catch.hpp>
+#include <string>
+#include <test_helper.hpp>
+
+// LOG_TIMESTAMP() is 0 on the host
+static std::string construct_deferred_string(log_level_e level, const char* str)
+{
+	return std::string(LOG_LEVEL_TO_SHORT_C_STRING(level)) + "[0 ms] " + std::string(str);
+}
+
+TEST_CASE("Deferred: Create a logger", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Deferred: Records are rendered at flush", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("%d %u %s\n", -42, 7u, "text");
+	CHECK(logger.size() > 0);
+	CHECK(log_buffer_output.empty());
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_deferred_string(log_level_e::info, "-42 7 text\n"));
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Deferred: Argument types", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	const char* str = "ptr";
+	char mutable_str[] = "array";
+	long long big = -1234567890123LL;
+	unsigned long long ubig = 9876543210ULL;
+	float f = 1.5f;
+	double d = 2.25;
+	char c = 'z';
+	bool b = true;
+	short s = -3;
+	unsigned char uc = 200;
+
+	logger.debug("%s %s %lld %llu %.1f %.2f %c %d %hd %u", str, mutable_str, big, ubig, f, d, c, b,
+				 s, uc);
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_deferred_string(log_level_e::debug,
+									"ptr array -1234567890123 9876543210 1.5 2.25 z 1 -3 200"));
+}
+
+TEST_CASE("Deferred: Enumerations are logged as integers", "[DeferredLogBufferLogger]")
+{
+	enum class small_enum : uint8_t
+	{
+		value = 200,
+	};
+
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.debug("%d %u", log_level_e::warning, small_enum::value);
+	logger.flush();
+	CHECK(log_buffer_output == construct_deferred_string(log_level_e::debug, "3 200"));
+}
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+TEST_CASE("Deferred: Interrupt records are kept in order", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("first\n");
+	size_t size = logger.size();
+
+	// The record is queued until the main context logs or flushes
+	logger.warning_interrupt("interrupt %d %s\n", 7, "text");
+	CHECK(size == logger.size());
+	logger.info("second\n");
+
+	logger.error_interrupt("interrupt %u\n", 8u);
+	logger.flush();
+	CHECK(log_buffer_output == construct_deferred_string(log_level_e::info, "first\n") +
+								   construct_deferred_string(log_level_e::warning,
+															 "interrupt 7 text\n") +
+								   construct_deferred_string(log_level_e::info, "second\n") +
+								   construct_deferred_string(log_level_e::error, "interrupt 8\n"));
+}
+#endif
+
+TEST_CASE("Deferred: Strings are copied at the call site", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	std::string temporary = "original";
+	logger.warning("%s", temporary.c_str());
+	temporary = "modified";
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_deferred_string(log_level_e::warning, "original"));
+}
+
+TEST_CASE("Deferred: Null strings are rendered as (null)", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	const char* null_string = nullptr;
+	logger.warning("[%s] [%s]", null_string, "");
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_deferred_string(log_level_e::warning, "[(null)] []"));
+}
+
+TEST_CASE("Deferred: Long strings are truncated to fit a record", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<4096> logger;
+	log_buffer_output.clear();
+
+	std::string long_string(LOG_DEFERRED_MAX_RECORD_SIZE * 2, 'a');
+	logger.error("%s|%d", long_string.c_str(), 5);
+	logger.flush();
+
+	// The trailing integer must survive truncation of the string before it
+	CHECK(log_buffer_output.size() < long_string.size());
+	CHECK(log_buffer_output.substr(log_buffer_output.size() - 2) == "|5");
+}
+
+TEST_CASE("Deferred: Binary records are smaller than formatted text", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	const char* fmt = "Sensor %d reading %d of %d samples, average %d, peak %d\n";
+	logger.info(fmt, 1, 2, 3, 4, 5);
+
+	log_buffer_output.clear();
+	logger.flush();
+	logger.info(fmt, 1, 2, 3, 4, 5);
+	CHECK(logger.size() < log_buffer_output.size());
+}
+
+TEST_CASE("Deferred: Print adds no prefix", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.print("raw %d\n", 1);
+	logger.flush();
+	CHECK(log_buffer_output == "raw 1\n");
+}
+
+TEST_CASE("Deferred: Run-time Filtering", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<1024> logger;
+	logger.level(log_level_e::warning);
+
+	logger.debug("This should not be added %d", 1);
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Deferred: Full buffer drops whole records", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<128> logger;
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 20; i++)
+	{
+		logger.info("record %d\n", i);
+	}
+
+	CHECK(true == logger.has_overrun());
+	CHECK(logger.size() <= logger.capacity());
+
+	// Each dropped statement is one event and one record
+	auto stats = logger.overrun_stats();
+	CHECK(stats.events > 0);
+	CHECK(stats.events == stats.dropped_records);
+	CHECK(stats.high_water_mark == logger.size());
+
+	logger.flush();
+
+	// The oldest records are intact, followed by the overrun notice
+	CHECK(log_buffer_output.find(construct_deferred_string(log_level_e::info, "record 0\n")) == 0);
+	CHECK(log_buffer_output.find("---Log buffer overrun detected: ") != std::string::npos);
+	CHECK(false == logger.has_overrun());
+}
+
+TEST_CASE("Deferred: Overwrite-oldest policy evicts whole records", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<128, log_full_policy::overwrite_oldest> logger;
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 20; i++)
+	{
+		logger.info("record %d\n", i);
+	}
+
+	CHECK(true == logger.has_overrun());
+	auto stats = logger.overrun_stats();
+	CHECK(stats.events == stats.dropped_records);
+
+	logger.flush();
+
+	// The output starts with a whole record, and the newest records are intact
+	CHECK(log_buffer_output.find(construct_deferred_string(log_level_e::info, "record ")) == 0);
+	CHECK(log_buffer_output.find(construct_deferred_string(log_level_e::info, "record 0\n")) ==
+		  std::string::npos);
+	CHECK(log_buffer_output.find(construct_deferred_string(log_level_e::info, "record 19\n")) !=
+		  std::string::npos);
+}
+
+TEST_CASE("Deferred: Auto-flush makes room for new records", "[DeferredLogBufferLogger]")
+{
+	DeferredLogBufferLogger<128> logger;
+	logger.auto_flush(true);
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 20; i++)
+	{
+		logger.info("record %d\n", i);
+	}
+
+	logger.flush();
+	CHECK(false == logger.has_overrun());
+	CHECK(log_buffer_output.find(construct_deferred_string(log_level_e::info, "record 19\n")) !=
+		  std::string::npos);
+}
@@ -0,0 +1,156 @@
+#include <CircularBufferLogger.h>
+#include <DeferredLogBufferLogger.h>
+#include <FanoutLogger.h>
+#include <RecordBufferLogger.h>
+#include <catch.hpp>
+#include <string>
+#include <test_helper.hpp>
+
+using RamSink = CircularLogBufferLogger<256>;
+using Fanout = FanoutLogger<RamSink, CircularLogBufferLogger<128>>;
+
+TEST_CASE("Fanout: Create a logger", "[FanoutLogger]")
+{
+	Fanout logger;
+
+	CHECK(2 == Fanout::sink_count());
+	CHECK(0 == logger.size());
+	CHECK(256 + 128 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Fanout: Sink echo is disabled", "[FanoutLogger]")
+{
+	FanoutLogger<RamSink> logger(true, LOG_LEVEL_LIMIT(), true);
+
+	CHECK(true == logger.echo());
+	CHECK(false == logger.sink<0>().echo());
+}
+
+TEST_CASE("Fanout: Each sink receives the statement", "[FanoutLogger]")
+{
+	Fanout logger;
+	log_buffer_output.clear();
+
+	logger.info("Hello %s\n", "world");
+	logger.print("raw\n");
+
+	std::string expected = construct_log_string(log_level_e::info, "Hello world\n") + "raw\n";
+	CHECK(expected.size() == logger.sink<0>().size());
+	CHECK(expected.size() == logger.sink<1>().size());
+	CHECK(2 * expected.size() == logger.size());
+
+	logger.flush();
+	CHECK(log_buffer_output == expected + expected);
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Fanout: Sinks filter by their own level", "[FanoutLogger]")
+{
+	Fanout logger;
+	log_buffer_output.clear();
+
+	logger.sink<1>().level(log_level_e::warning);
+
+	logger.info("info\n");
+	logger.error("error\n");
+
+	logger.sink<0>().flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "info\n") +
+								   construct_log_string(log_level_e::error, "error\n"));
+
+	log_buffer_output.clear();
+	logger.sink<1>().flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::error, "error\n"));
+}
+
+TEST_CASE("Fanout: Output from print() reaches every sink", "[FanoutLogger]")
+{
+	Fanout logger;
+
+	logger.sink<0>().level(log_level_e::off);
+	logger.info("info\n");
+	CHECK(0 == logger.sink<0>().size());
+
+	logger.print("raw\n");
+	CHECK(strlen("raw\n") == logger.sink<0>().size());
+}
+
+TEST_CASE("Fanout: The logger level limits every sink", "[FanoutLogger]")
+{
+	Fanout logger;
+
+	logger.level(log_level_e::error);
+	logger.info("info\n");
+
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Fanout: Long statements reach each sink whole", "[FanoutLogger]")
+{
+	FanoutLogger<CircularLogBufferLogger<1024>, CircularLogBufferLogger<512>> logger;
+	log_buffer_output.clear();
+
+	std::string message(3 * LOG_STAGING_BUFFER_SIZE, 'x');
+	logger.info("%s\n", message.c_str());
+	logger.flush();
+
+	std::string expected = construct_log_string(log_level_e::info, message.c_str()) + "\n";
+	CHECK(log_buffer_output == expected + expected);
+}
+
+TEST_CASE("Fanout: Deferred sinks receive the log() call", "[FanoutLogger]")
+{
+	FanoutLogger<CircularLogBufferLogger<1024>, DeferredLogBufferLogger<1024>> logger;
+	log_buffer_output.clear();
+
+	logger.info("value %d\n", 5);
+	logger.print("raw\n");
+	logger.flush();
+
+	// The deferred sink renders its own record format
+	std::string deferred = std::string(LOG_LEVEL_TO_SHORT_C_STRING(log_level_e::info)) +
+						   "[0 ms] value 5\nraw\n";
+	CHECK(log_buffer_output ==
+		  construct_log_string(log_level_e::info, "value 5\n") + "raw\n" + deferred);
+}
+
+TEST_CASE("Fanout: Record sinks store one record per statement", "[FanoutLogger]")
+{
+	FanoutLogger<CircularLogBufferLogger<1024>, RecordBufferLogger<1024>> logger;
+	log_buffer_output.clear();
+
+	std::string message(3 * LOG_STAGING_BUFFER_SIZE, 'x');
+	logger.info("Hello %s\n", "world");
+	logger.warning("%s\n", message.c_str());
+	logger.print("raw\n");
+
+	// The level prefix is not stored as text, and each statement is a single record
+	size_t payload = strlen("Hello world\n") + message.size() + strlen("\n") + strlen("raw\n");
+	CHECK(3 * RecordBuffer<1024>::header_size + payload == logger.sink<1>().size());
+
+	// The records keep their levels, so they can be filtered at flush time
+	logger.sink<1>().flush(log_level_e::warning);
+	CHECK(log_buffer_output == std::string(LOG_LEVEL_TO_SHORT_C_STRING(log_level_e::warning)) +
+								   "[0 ms] " + message + "\n" + "raw\n");
+
+	log_buffer_output.clear();
+	logger.sink<0>().flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "Hello world\n") +
+								   construct_log_string(log_level_e::warning, message.c_str()) +
+								   "\nraw\n");
+}
+
+TEST_CASE("Fanout: Clear empties every sink", "[FanoutLogger]")
+{
+	Fanout logger;
+
+	logger.info("info\n");
+	CHECK(0 < logger.size());
+
+	logger.clear();
+	CHECK(0 == logger.sink<0>().size());
+	CHECK(0 == logger.sink<1>().size());
+}
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <catch.hpp>
+#include <cstdio>
+#include <internal/log_compression.hpp>
+#include <string>
+#include <vector>
+
+namespace
+{
+/// Compress `chunks` as one stream, one block per chunk
+template<class TCompressor>
+std::vector<uint8_t> compress(TCompressor& compressor, const std::vector<std::string>& chunks)
+{
+	std::vector<uint8_t> stream(TCompressor::header_size);
+	compressor.reset();
+	compressor.header(stream.data());
+
+	for(const auto& chunk : chunks)
+	{
+		std::vector<uint8_t> block(TCompressor::max_block_size(chunk.size()));
+		compressor.begin_block(block.data(), block.size());
+		compressor.write(chunk.data(), chunk.size());
+		size_t size = compressor.end_block();
+		REQUIRE(size > 0);
+		stream.insert(stream.end(), block.begin(), block.begin() + static_cast<long>(size));
+	}
+
+	return stream;
+}
+
+template<class TDecompressor>
+bool decompress(TDecompressor& decompressor, const std::vector<uint8_t>& stream,
+				std::string& output)
+{
+	output.clear();
+	return decompressor.decode(stream.data(), stream.size(), [&output](char c) {
+		output += c;
+	});
+}
+
+std::string join(const std::vector<std::string>& chunks)
+{
+	std::string text;
+
+	for(const auto& chunk : chunks)
+	{
+		text += chunk;
+	}
+
+	return text;
+}
+
+/// Typical log output, split into 512-byte flushes
+std::vector<std::string> log_chunks(int statements)
+{
+	std::string text;
+	char line[80];
+
+	for(int i = 0; i < statements; i++)
+	{
+		snprintf(line, sizeof(line), "<I> [%d ms] Sensor %d reading: %d mV\n", 1000 + i * 250,
+				 i % 4, 3300 - (i * 7) % 50);
+		text += line;
+	}
+
+	std::vector<std::string> chunks;
+
+	for(size_t i = 0; i < text.size(); i += 512)
+	{
+		chunks.push_back(text.substr(i, 512));
+	}
+
+	return chunks;
+}
+} // namespace
+
+TEST_CASE("LZ: Round trip of a single block", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	std::vector<std::string> chunks = {"<I> Hello world\n<I> Hello world\n<I> Hello!\n"};
+	std::string output;
+
+	auto stream = compress(compressor, chunks);
+	CHECK(stream[0] == 'L');
+	CHECK(stream[3] == 0x84);
+	CHECK(stream.size() < LogCompressor<>::header_size + join(chunks).size());
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == join(chunks));
+}
+
+TEST_CASE("LZ: Matches refer to data from previous blocks", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	std::string output;
+
+	auto single = compress(compressor, {"<W> Battery voltage low\n"});
+	auto stream = compress(compressor, {"<W> Battery voltage low\n", "<W> Battery voltage low\n"});
+
+	// The second block is a single back-reference
+	size_t first_block = single.size() - LogCompressor<>::header_size;
+	CHECK(stream.size() - single.size() < first_block / 4);
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == "<W> Battery voltage low\n<W> Battery voltage low\n");
+}
+
+TEST_CASE("LZ: Repetitive log text compresses at least 3x", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	std::string output;
+
+	auto chunks = log_chunks(400);
+	std::string text = join(chunks);
+	auto stream = compress(compressor, chunks);
+
+	INFO("ratio " << static_cast<double>(text.size()) / static_cast<double>(stream.size()));
+	CHECK(stream.size() * 3 < text.size());
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == text);
+}
+
+TEST_CASE("LZ: Incompressible data stays within the block bound", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	std::string data;
+	std::string output;
+	uint32_t x = 12345;
+
+	for(int i = 0; i < 512; i++)
+	{
+		x = x * 1103515245 + 12345;
+		data += static_cast<char>(x >> 24);
+	}
+
+	auto stream = compress(compressor, {data});
+	CHECK(stream.size() <=
+		  LogCompressor<>::header_size + LogCompressor<>::max_block_size(data.size()));
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == data);
+}
+
+TEST_CASE("LZ: Overlapping matches and long runs", "[LogCompression]")
+{
+	LogCompressor<4, 4> compressor;
+	LogDecompressor<4, 4> decompressor;
+	std::vector<std::string> chunks = {std::string(300, '='), "abababababababab\n",
+									   std::string(40, '-') + "\n"};
+	std::string output;
+
+	auto stream = compress(compressor, chunks);
+	CHECK(stream[3] == 0x44);
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == join(chunks));
+}
+
+TEST_CASE("LZ: Short writes past 64 KiB of positions", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	std::string output;
+
+	// The index spans the ends of the writes, and its positions wrap around
+	std::string text = join(log_chunks(2000));
+	REQUIRE(text.size() > 65536);
+
+	std::vector<uint8_t> stream(LogCompressor<>::header_size);
+	compressor.reset();
+	compressor.header(stream.data());
+
+	for(size_t i = 0; i < text.size(); i += 512)
+	{
+		size_t len = std::min<size_t>(512, text.size() - i);
+		std::vector<uint8_t> block(LogCompressor<>::max_block_size(len));
+		compressor.begin_block(block.data(), block.size());
+
+		for(size_t j = 0, n = 1; j < len; j += n, n = n % 9 + 1)
+		{
+			compressor.write(&text[i + j], std::min(n, len - j));
+		}
+
+		size_t size = compressor.end_block();
+		REQUIRE(size > 0);
+		stream.insert(stream.end(), block.begin(), block.begin() + static_cast<long>(size));
+	}
+
+	CHECK(true == decompress(decompressor, stream, output));
+	CHECK(output == text);
+
+	// Without matches, every byte would take 9 bits
+	CHECK(stream.size() < text.size());
+}
+
+TEST_CASE("LZ: A block which does not fit is rejected", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	uint8_t block[8];
+
+	compressor.begin_block(block, sizeof(block));
+	compressor.write("0123456789", 10);
+	CHECK(0 == compressor.end_block());
+}
+
+TEST_CASE("LZ: Malformed streams are rejected", "[LogCompression]")
+{
+	LogCompressor<> compressor;
+	LogDecompressor<> decompressor;
+	LogDecompressor<10, 4> other_parameters;
+	std::string output;
+
+	auto stream = compress(compressor, {"<I> first block\n", "<I> second block\n"});
+
+	CHECK(false == decompress(other_parameters, stream, output));
+
+	// A truncated stream keeps the data from the complete blocks
+	stream.pop_back();
+	CHECK(false == decompress(decompressor, stream, output));
+	CHECK(output.substr(0, 16) == "<I> first block\n");
+
+	std::vector<uint8_t> not_compressed = {'<', 'I', '>', ' ', 'x'};
+	CHECK(false == decompress(decompressor, not_compressed, output));
+}
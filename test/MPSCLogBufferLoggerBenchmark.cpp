@@ -0,0 +1,85 @@
+// Throughput benchmark for MPSCLogBufferLogger
+//
+// Measures the rate at which several producer threads can add statements to the log buffer
+// while a single consumer thread flushes it.
+
+#include <MPSCLogBufferLogger.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Output is only produced by the consumer thread
+static size_t bytes_output = 0;
+static unsigned statements_output = 0;
+static size_t line_position = 0;
+
+void _putchar(char character)
+{
+	// flush() reports overruns with a "<!>" line, so only "<I>" lines are counted
+	if(line_position == 1 && character == 'I')
+	{
+		statements_output++;
+	}
+
+	line_position = (character == '\n') ? 0 : line_position + 1;
+	bytes_output++;
+}
+
+static MPSCLogBufferLogger<64 * 1024> logger;
+
+static void run(unsigned producer_count, unsigned statements)
+{
+	logger.clear();
+	bytes_output = 0;
+	statements_output = 0;
+
+	std::atomic<unsigned> running{producer_count};
+	std::vector<std::thread> producers;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for(unsigned t = 0; t < producer_count; t++)
+	{
+		producers.emplace_back([t, statements, &running]() {
+			for(unsigned i = 0; i < statements; i++)
+			{
+				logger.info("thread %u statement %u value %d\n", t, i, -42);
+			}
+
+			running--;
+		});
+	}
+
+	while(running > 0)
+	{
+		logger.flush();
+	}
+
+	for(auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	logger.flush();
+
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	unsigned total = producer_count * statements;
+
+	printf("%u producers: %.0f statements/s logged, %.0f statements/s flushed (%.1f MB/s), "
+		   "%u of %u statements dropped\n",
+		   producer_count, total / seconds, statements_output / seconds,
+		   bytes_output / seconds / 1e6, total - statements_output, total);
+}
+
+int main()
+{
+	for(unsigned producers : {1u, 2u, 4u, 8u})
+	{
+		run(producers, 200000);
+	}
+
+	return 0;
+}
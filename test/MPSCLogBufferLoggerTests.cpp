@@ -0,0 +1,173 @@
+#include <MPSCLogBufferLogger.h>
+#include <atomic>
+#include <catch.hpp>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <test_helper.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("MPSC: Create a logger", "[MPSCLogBufferLogger]")
+{
+	MPSCLogBufferLogger<1024> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("MPSC: Log and flush", "[MPSCLogBufferLogger]")
+{
+	MPSCLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("Hello %s\n", "world");
+	logger.print("raw\n");
+	CHECK(logger.size() > 0);
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "Hello world\n") + "raw\n");
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("MPSC: Interrupt statements are kept in order", "[MPSCLogBufferLogger]")
+{
+	MPSCLogBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("first\n");
+	logger.warning_interrupt("interrupt %d\n", 1);
+	logger.info("second\n");
+	logger.flush();
+	CHECK(log_buffer_output == construct_log_string(log_level_e::info, "first\n") +
+								   construct_log_string(log_level_e::warning, "interrupt 1\n") +
+								   construct_log_string(log_level_e::info, "second\n"));
+}
+
+#if LOG_INTERRUPT_BUFFER_SIZE > 0
+TEST_CASE("MPSC: No interrupt queue is reserved", "[MPSCLogBufferLogger]")
+{
+	// Only the logger settings are added to the ring buffer
+	CHECK(sizeof(MPSCLogBufferLogger<1024>) - sizeof(MPSCRingBuffer<1024>) <
+		  LOG_INTERRUPT_BUFFER_SIZE);
+}
+#endif
+
+TEST_CASE("MPSC: Records wrap around the end of the buffer", "[MPSCLogBufferLogger]")
+{
+	MPSCLogBufferLogger<256> logger;
+	std::string expected;
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 100; i++)
+	{
+		logger.print("record %d\n", i);
+		expected += "record " + std::to_string(i) + "\n";
+
+		if(i % 7 == 0)
+		{
+			logger.flush();
+		}
+	}
+
+	logger.flush();
+	CHECK(log_buffer_output == expected);
+	CHECK(false == logger.has_overrun());
+}
+
+TEST_CASE("MPSC: Full buffer drops new statements", "[MPSCLogBufferLogger]")
+{
+	MPSCLogBufferLogger<256> logger;
+	log_buffer_output.clear();
+
+	for(int i = 0; i < 40; i++)
+	{
+		logger.print("record %d\n", i);
+	}
+
+	CHECK(true == logger.has_overrun());
+	auto stats = logger.overrun_stats();
+	CHECK(stats.events == stats.dropped_records);
+	CHECK(stats.high_water_mark <= logger.capacity());
+
+	logger.flush();
+	CHECK(log_buffer_output.find("record 0\n") == 0);
+	CHECK(log_buffer_output.find("record 39\n") == std::string::npos);
+	CHECK(false == logger.has_overrun());
+}
+
+TEST_CASE("MPSC: Concurrent producers", "[MPSCLogBufferLogger]")
+{
+	constexpr unsigned producer_count = 4;
+	constexpr unsigned statements = 5000;
+
+	static MPSCLogBufferLogger<4096> logger;
+	logger.clear();
+	log_buffer_output.clear();
+
+	std::atomic<unsigned> running{producer_count};
+	std::vector<std::thread> producers;
+
+	for(unsigned t = 0; t < producer_count; t++)
+	{
+		producers.emplace_back([t, &running]() {
+			for(unsigned i = 0; i < statements; i++)
+			{
+				logger.info("thread %u statement %u\n", t, i);
+			}
+
+			running--;
+		});
+	}
+
+	// The test thread is the single consumer
+	while(running > 0)
+	{
+		logger.flush();
+	}
+
+	for(auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	logger.flush();
+	CHECK(false == logger.has_overrun());
+
+	// Every statement is whole, and each thread's statements are in order
+	std::istringstream output(log_buffer_output);
+	std::string line;
+	unsigned received = 0;
+	unsigned dropped = 0;
+	long last[producer_count];
+	std::fill(last, last + producer_count, -1L);
+
+	while(std::getline(output, line))
+	{
+		unsigned t;
+		unsigned i;
+		unsigned long events;
+		unsigned long bytes;
+		unsigned long records;
+
+		if(sscanf(line.c_str(), "<I> thread %u statement %u", &t, &i) == 2)
+		{
+			REQUIRE(t < producer_count);
+			CHECK(static_cast<long>(i) > last[t]);
+			last[t] = i;
+			received++;
+		}
+		else
+		{
+			REQUIRE(sscanf(line.c_str(),
+						   "<!> ---Log buffer overrun detected: %lu events, %lu bytes, %lu records",
+						   &events, &bytes, &records) == 3);
+			dropped += static_cast<unsigned>(records);
+		}
+	}
+
+	CHECK(received + dropped == producer_count * statements);
+}
@@ -0,0 +1,189 @@
+#include <MappedFileLogger.h>
+#include <catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <test_helper.hpp>
+#include <unistd.h>
+
+using Logger = MappedFileLogger<1024>;
+using storage_t = PersistentRingBuffer<1024>::storage_t;
+
+static std::string test_path()
+{
+	return std::string(P_tmpdir) + "/arduino_logger_mapped_" + std::to_string(getpid()) +
+		   ".ring";
+}
+
+TEST_CASE("Mapped: Create a logger", "[MappedFileLogger]")
+{
+	Logger logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Mapped: Begin creates the log file", "[MappedFileLogger]")
+{
+	std::string path = test_path();
+	unlink(path.c_str());
+
+	Logger logger;
+	logger.info("dropped\n");
+	CHECK(0 == logger.size());
+
+	REQUIRE(true == logger.begin(path.c_str()));
+	CHECK(0 == logger.recovered_size());
+	CHECK(0 == logger.session());
+
+	struct stat st;
+	REQUIRE(0 == stat(path.c_str(), &st));
+	CHECK(sizeof(storage_t) == static_cast<size_t>(st.st_size));
+
+	logger.end();
+	unlink(path.c_str());
+}
+
+TEST_CASE("Mapped: Flush keeps the log", "[MappedFileLogger]")
+{
+	std::string path = test_path();
+	unlink(path.c_str());
+
+	Logger logger;
+	REQUIRE(logger.begin(path.c_str()));
+
+	logger.info("Hello %s\n", "world");
+	std::string expected = construct_log_string(log_level_e::info, "Hello world\n");
+	CHECK(expected.size() == logger.size());
+
+	log_buffer_output.clear();
+	logger.flush();
+	CHECK(log_buffer_output.empty());
+	CHECK(expected.size() == logger.size());
+
+	logger.dump();
+	CHECK(log_buffer_output == expected);
+
+	logger.clear();
+	CHECK(0 == logger.size());
+
+	logger.end();
+	unlink(path.c_str());
+}
+
+TEST_CASE("Mapped: The log is recovered after the process exits uncleanly", "[MappedFileLogger]")
+{
+	std::string path = test_path();
+	unlink(path.c_str());
+
+	pid_t child = fork();
+	REQUIRE(child >= 0);
+
+	if(child == 0)
+	{
+		Logger logger;
+		logger.begin(path.c_str());
+		logger.info("before crash\n");
+
+		// Exit without unmapping or syncing the file
+		_exit(0);
+	}
+
+	int status = 0;
+	waitpid(child, &status, 0);
+
+	Logger logger;
+	REQUIRE(logger.begin(path.c_str()));
+	std::string expected = construct_log_string(log_level_e::info, "before crash\n");
+	CHECK(1 == logger.session());
+	CHECK(expected.size() == logger.recovered_size());
+
+	logger.info("after crash\n");
+	log_buffer_output.clear();
+	logger.dump();
+	CHECK(log_buffer_output ==
+		  expected + construct_log_string(log_level_e::info, "after crash\n"));
+
+	logger.end();
+	unlink(path.c_str());
+}
+
+TEST_CASE("Mapped: Recovery uses the remaining valid header", "[MappedFileLogger]")
+{
+	std::string path = test_path();
+	unlink(path.c_str());
+
+	{
+		Logger logger;
+		REQUIRE(logger.begin(path.c_str()));
+		logger.print("first\n");
+		logger.print("second\n");
+	}
+
+	// Corrupt one header copy
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(0);
+		file.put('X');
+	}
+
+	{
+		Logger logger;
+		REQUIRE(logger.begin(path.c_str()));
+		CHECK(0 < logger.recovered_size());
+
+		log_buffer_output.clear();
+		logger.dump();
+		CHECK(log_buffer_output.find("first\n") == 0);
+	}
+
+	// Corrupt both header copies. The log is initialized.
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(0);
+		file.put('X');
+		file.seekp(sizeof(storage_t::headers) / 2);
+		file.put('X');
+	}
+
+	Logger logger;
+	REQUIRE(logger.begin(path.c_str()));
+	CHECK(0 == logger.recovered_size());
+	CHECK(0 == logger.session());
+
+	logger.end();
+	unlink(path.c_str());
+}
+
+TEST_CASE("Mapped: A file with a different buffer size is initialized", "[MappedFileLogger]")
+{
+	std::string path = test_path();
+	unlink(path.c_str());
+
+	{
+		MappedFileLogger<512> logger;
+		REQUIRE(logger.begin(path.c_str()));
+		logger.print("small\n");
+	}
+
+	Logger logger;
+	REQUIRE(logger.begin(path.c_str()));
+	CHECK(0 == logger.recovered_size());
+
+	logger.end();
+	unlink(path.c_str());
+}
+
+TEST_CASE("Mapped: Begin fails for a path which cannot be opened", "[MappedFileLogger]")
+{
+	Logger logger;
+
+	CHECK(false == logger.begin("/nonexistent-directory/log.ring"));
+	logger.info("dropped\n");
+	CHECK(0 == logger.size());
+}
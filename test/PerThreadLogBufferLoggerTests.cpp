@@ -0,0 +1,172 @@
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+// Statements are routed to buffers and ordered by values which the tests control
+static thread_local int test_slot = 0;
+static std::atomic<uint64_t> test_timestamp{1};
+#define LOG_THREAD_SLOT() test_slot
+#define LOG_MERGE_TIMESTAMP() test_timestamp.fetch_add(1)
+
+#include <PerThreadLogBufferLogger.h>
+#include <catch.hpp>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <test_helper.hpp>
+#include <vector>
+
+TEST_CASE("PerThread: Create a logger", "[PerThreadLogBufferLogger]")
+{
+	PerThreadLogBufferLogger<1024, 4> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(4096 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("PerThread: Buffers are merged by timestamp", "[PerThreadLogBufferLogger]")
+{
+	PerThreadLogBufferLogger<256, 3> logger;
+	log_buffer_output.clear();
+
+	test_slot = 1;
+	test_timestamp = 20;
+	logger.print("b\n");
+	test_slot = 0;
+	test_timestamp = 10;
+	logger.print("a\n");
+	test_slot = 2;
+	test_timestamp = 30;
+	logger.info("c\n");
+	test_slot = 0;
+	test_timestamp = 40;
+	logger.print("d\n");
+	test_slot = 0;
+
+	logger.flush();
+	CHECK(log_buffer_output == "a\nb\n" + construct_log_string(log_level_e::info, "c\n") + "d\n");
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("PerThread: Statements without a buffer are dropped", "[PerThreadLogBufferLogger]")
+{
+	PerThreadLogBufferLogger<256, 2> logger;
+	log_buffer_output.clear();
+
+	test_slot = 2;
+	logger.print("dropped\n");
+	test_slot = -1;
+	logger.print("dropped\n");
+	test_slot = 0;
+	logger.print("kept\n");
+
+	CHECK(true == logger.has_overrun());
+	auto stats = logger.overrun_stats();
+	CHECK(2 == stats.events);
+	CHECK(2 == stats.dropped_records);
+	CHECK(16 == stats.dropped_bytes);
+
+	logger.flush();
+	CHECK(log_buffer_output.find("kept\n") == 0);
+	CHECK(log_buffer_output.find("dropped") == std::string::npos);
+	CHECK(false == logger.has_overrun());
+}
+
+TEST_CASE("PerThread: Thread slots are reused", "[PerThreadLogBufferLogger]")
+{
+	int main_slot = log_thread_slot::index();
+	int first_slot = -1;
+	int second_slot = -1;
+
+	std::thread first([&first_slot]() { first_slot = log_thread_slot::index(); });
+	first.join();
+	std::thread second([&second_slot]() { second_slot = log_thread_slot::index(); });
+	second.join();
+
+	CHECK(main_slot >= 0);
+	CHECK(first_slot >= 0);
+	CHECK(first_slot != main_slot);
+	CHECK(first_slot == second_slot);
+}
+
+TEST_CASE("PerThread: Concurrent producers", "[PerThreadLogBufferLogger]")
+{
+	constexpr unsigned producer_count = 4;
+	constexpr unsigned statements = 5000;
+
+	// The consumer has its own slot for the overrun reports
+	static PerThreadLogBufferLogger<2048, producer_count + 1> logger;
+	logger.clear();
+	log_buffer_output.clear();
+
+	std::atomic<unsigned> running{producer_count};
+	std::vector<std::thread> producers;
+
+	for(unsigned t = 0; t < producer_count; t++)
+	{
+		producers.emplace_back([t, &running]() {
+			test_slot = static_cast<int>(t);
+
+			for(unsigned i = 0; i < statements; i++)
+			{
+				logger.info("thread %u statement %u\n", t, i);
+			}
+
+			running--;
+		});
+	}
+
+	// The test thread is the single consumer
+	test_slot = static_cast<int>(producer_count);
+
+	while(running > 0)
+	{
+		logger.flush();
+	}
+
+	for(auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	logger.flush();
+	test_slot = 0;
+	CHECK(false == logger.has_overrun());
+
+	// Every statement is whole, and each thread's statements are in order
+	std::istringstream output(log_buffer_output);
+	std::string line;
+	unsigned received = 0;
+	unsigned dropped = 0;
+	long last[producer_count];
+	std::fill(last, last + producer_count, -1L);
+
+	while(std::getline(output, line))
+	{
+		unsigned t;
+		unsigned i;
+		unsigned long events;
+		unsigned long bytes;
+		unsigned long records;
+
+		if(sscanf(line.c_str(), "<I> thread %u statement %u", &t, &i) == 2)
+		{
+			REQUIRE(t < producer_count);
+			CHECK(static_cast<long>(i) > last[t]);
+			last[t] = i;
+			received++;
+		}
+		else
+		{
+			REQUIRE(sscanf(line.c_str(),
+						   "<!> ---Log buffer overrun detected: %lu events, %lu bytes, %lu records",
+						   &events, &bytes, &records) == 3);
+			dropped += static_cast<unsigned>(records);
+		}
+	}
+
+	CHECK(received + dropped == producer_count * statements);
+}
@@ -0,0 +1,216 @@
+#include <RecordBufferLogger.h>
+#include <catch.hpp>
+#include <string>
+#include <test_helper.hpp>
+
+// LOG_TIMESTAMP() is 0 on the host
+static std::string construct_record_string(log_level_e level, const char* str)
+{
+	return std::string(LOG_LEVEL_TO_SHORT_C_STRING(level)) + "[0 ms] " + std::string(str);
+}
+
+static constexpr size_t header_size = RecordBuffer<1024>::header_size;
+
+TEST_CASE("Record: Create a logger", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Record: Log and flush", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("Hello %s\n", "world");
+	// The level prefix is stored in the header rather than as text
+	CHECK(header_size + strlen("Hello world\n") == logger.size());
+
+	logger.print("raw\n");
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_record_string(log_level_e::info, "Hello world\n") + "raw\n");
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Record: Interrupt statements are kept in order", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.info("first\n");
+	logger.warning_interrupt("interrupt %d\n", 1);
+	logger.info("second\n");
+	logger.flush();
+	CHECK(log_buffer_output == construct_record_string(log_level_e::info, "first\n") +
+								   construct_record_string(log_level_e::warning, "interrupt 1\n") +
+								   construct_record_string(log_level_e::info, "second\n"));
+}
+
+TEST_CASE("Record: Statements longer than the staging buffer", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	std::string message(LOG_STAGING_BUFFER_SIZE * 3 + 5, 'x');
+	logger.debug("%s\n", message.c_str());
+	CHECK(header_size + message.size() + 1 == logger.size());
+
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_record_string(log_level_e::debug, (message + "\n").c_str()));
+}
+
+TEST_CASE("Record: Wrapping evicts whole records", "[RecordBufferLogger]")
+{
+	// Room for two 40-byte records (7 byte header + 33 byte message)
+	RecordBufferLogger<100> logger;
+	log_buffer_output.clear();
+	std::string padding(28, '.');
+
+	logger.error("one %s\n", padding.c_str());
+	logger.error("two %s\n", padding.c_str());
+	CHECK(false == logger.has_overrun());
+	logger.error("tri %s\n", padding.c_str());
+	CHECK(true == logger.has_overrun());
+	CHECK(80 == logger.size());
+
+	auto stats = logger.overrun_stats();
+	CHECK(1 == stats.events);
+	CHECK(40 == stats.dropped_bytes);
+	CHECK(1 == stats.dropped_records);
+	CHECK(80 == stats.high_water_mark);
+
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  construct_record_string(log_level_e::error, ("two " + padding + "\n").c_str()) +
+			  construct_record_string(log_level_e::error, ("tri " + padding + "\n").c_str()) +
+			  construct_record_string(log_level_e::critical,
+									  "---Log buffer overrun detected: 1 events, 40 bytes, "
+									  "1 records lost, 80 bytes peak---\n"));
+	CHECK(false == logger.has_overrun());
+	CHECK(0 == logger.overrun_stats().high_water_mark);
+}
+
+TEST_CASE("Record: Headers and payloads which wrap around", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<64> logger;
+
+	// Records of varying length start at every offset, so headers and payloads are split
+	for(int i = 0; i < 40; i++)
+	{
+		log_buffer_output.clear();
+		std::string expected;
+
+		for(int j = 0; j < 2; j++)
+		{
+			std::string message(static_cast<size_t>((i * 7 + j * 3) % 19), 'a' + j);
+			logger.info("%s\n", message.c_str());
+			expected += construct_record_string(log_level_e::info, (message + "\n").c_str());
+		}
+
+		logger.flush();
+		CHECK(log_buffer_output == expected);
+		CHECK(false == logger.has_overrun());
+	}
+}
+
+TEST_CASE("Record: Output printed during a statement is part of its record",
+		  "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	// As if printed by log_customprefix()
+	logger.begin_statement(log_level_e::info);
+	logger.print("[prefix] ");
+	logger.write_statement("message\n", 8);
+	logger.end_statement(log_level_e::info);
+
+	CHECK(header_size + strlen("[prefix] message\n") == logger.size());
+	CHECK(false == logger.has_overrun());
+
+	logger.flush();
+	CHECK(log_buffer_output == construct_record_string(log_level_e::info, "[prefix] message\n"));
+}
+
+TEST_CASE("Record: Records larger than the buffer are truncated", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<16> logger;
+	log_buffer_output.clear();
+
+	logger.warning("0123456789abcdefghij");
+	CHECK(true == logger.has_overrun());
+	CHECK(16 == logger.size());
+
+	logger.clear();
+	logger.warning("012345678");
+	logger.flush();
+	CHECK(log_buffer_output == construct_record_string(log_level_e::warning, "012345678"));
+}
+
+TEST_CASE("Record: Drop-newest policy drops whole records", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<30, log_full_policy::drop_newest> logger;
+	log_buffer_output.clear();
+
+	logger.error("one!\n");
+	logger.error("two!\n");
+	logger.error("tri!\n");
+	logger.error("0123456789abcdefghijklmnopqrstuvwxyz");
+	CHECK(24 == logger.size());
+
+	auto stats = logger.overrun_stats();
+	CHECK(2 == stats.events);
+	CHECK(2 == stats.dropped_records);
+
+	logger.clear();
+	logger.error("0123456789abcdefghijklmnopqrstuvwxyz");
+	CHECK(0 == logger.size());
+	CHECK(1 == logger.overrun_stats().dropped_records);
+}
+
+TEST_CASE("Record: Auto-flush outputs older records first", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<30> logger;
+	logger.auto_flush(true);
+	log_buffer_output.clear();
+
+	logger.info("one!\n");
+	logger.info("two!\n");
+	logger.info("tri!\n");
+	CHECK(false == logger.has_overrun());
+	CHECK(log_buffer_output == construct_record_string(log_level_e::info, "one!\n") +
+								   construct_record_string(log_level_e::info, "two!\n"));
+
+	log_buffer_output.clear();
+	logger.flush();
+	CHECK(log_buffer_output == construct_record_string(log_level_e::info, "tri!\n"));
+}
+
+TEST_CASE("Record: Flush a subset of levels", "[RecordBufferLogger]")
+{
+	RecordBufferLogger<1024> logger;
+	log_buffer_output.clear();
+
+	logger.debug("debug\n");
+	logger.warning("warning\n");
+	logger.print("raw\n");
+	logger.info("info\n");
+
+	logger.flush(log_level_e::warning);
+	CHECK(log_buffer_output ==
+		  construct_record_string(log_level_e::warning, "warning\n") + "raw\n");
+	CHECK(0 == logger.size());
+
+	// The filter only applies to a single flush
+	log_buffer_output.clear();
+	logger.debug("debug\n");
+	logger.flush();
+	CHECK(log_buffer_output == construct_record_string(log_level_e::debug, "debug\n"));
+}
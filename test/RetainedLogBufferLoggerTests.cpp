@@ -0,0 +1,101 @@
+#include <RetainedLogBufferLogger.h>
+#include <catch.hpp>
+#include <string>
+#include <test_helper.hpp>
+
+// Each buffer size has its own retained buffer, so tests use different sizes to start from
+// uninitialized storage. A reset is simulated by constructing a new logger.
+
+TEST_CASE("Retained: Create a logger", "[RetainedLogBufferLogger]")
+{
+	RetainedLogBufferLogger<1024> logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Retained: Statements before begin() are dropped", "[RetainedLogBufferLogger]")
+{
+	RetainedLogBufferLogger<1000> logger;
+
+	logger.info("dropped\n");
+	CHECK(0 == logger.size());
+
+	CHECK(false == logger.begin());
+	CHECK(0 == logger.recovered_size());
+	CHECK(0 == logger.session());
+
+	logger.info("kept\n");
+	CHECK(strlen("<I> kept\n") == logger.size());
+}
+
+TEST_CASE("Retained: The log survives a reset", "[RetainedLogBufferLogger]")
+{
+	std::string expected = construct_log_string(log_level_e::info, "before reset\n");
+
+	{
+		RetainedLogBufferLogger<1001> logger;
+		CHECK(false == logger.begin());
+		logger.info("before reset\n");
+	}
+
+	RetainedLogBufferLogger<1001> logger;
+	CHECK(true == logger.begin());
+	CHECK(1 == logger.session());
+	CHECK(expected.size() == logger.recovered_size());
+	CHECK(expected.size() == logger.size());
+
+	logger.info("after reset\n");
+	log_buffer_output.clear();
+	logger.flush();
+	CHECK(log_buffer_output ==
+		  expected + construct_log_string(log_level_e::info, "after reset\n"));
+	CHECK(0 == logger.recovered_size());
+
+	// A flushed log is not output again after the next reset
+	RetainedLogBufferLogger<1001> next;
+	CHECK(true == next.begin());
+	CHECK(2 == next.session());
+	CHECK(0 == next.recovered_size());
+}
+
+TEST_CASE("Retained: The newest data is kept when the buffer wraps", "[RetainedLogBufferLogger]")
+{
+	{
+		RetainedLogBufferLogger<64> logger;
+		logger.begin();
+
+		for(int i = 0; i < 30; i++)
+		{
+			logger.print("%02d\n", i);
+		}
+	}
+
+	RetainedLogBufferLogger<64> logger;
+	CHECK(true == logger.begin());
+	CHECK(64 == logger.recovered_size());
+
+	log_buffer_output.clear();
+	logger.flush();
+	CHECK(64 == log_buffer_output.size());
+	CHECK(log_buffer_output.find("29\n") != std::string::npos);
+	CHECK(log_buffer_output.find("03\n") == std::string::npos);
+}
+
+TEST_CASE("Retained: Clear discards the retained log", "[RetainedLogBufferLogger]")
+{
+	{
+		RetainedLogBufferLogger<1002> logger;
+		logger.begin();
+		logger.info("discarded\n");
+		logger.clear();
+	}
+
+	RetainedLogBufferLogger<1002> logger;
+	CHECK(true == logger.begin());
+	CHECK(0 == logger.recovered_size());
+	CHECK(0 == logger.size());
+}
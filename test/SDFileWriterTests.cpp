@@ -0,0 +1,190 @@
+#include <catch.hpp>
+#include <internal/circular_buffer.hpp>
+#include <internal/sd_file_writer.hpp>
+#include <internal/slot_buffer.hpp>
+#include <string>
+
+namespace
+{
+/// Minimal stand-in for an SdFat file
+class fake_file
+{
+  public:
+	int write(const void* data, size_t len)
+	{
+		size_t n = (len < write_limit) ? len : write_limit;
+		write_limit -= n;
+		contents.replace(position, n, static_cast<const char*>(data), n);
+		position += n;
+		writes++;
+		return static_cast<int>(n);
+	}
+
+	uint64_t curPosition() const
+	{
+		return position;
+	}
+
+	bool seekSet(uint64_t pos)
+	{
+		position = static_cast<size_t>(pos);
+		return true;
+	}
+
+	std::string contents;
+	size_t position = 0;
+	size_t writes = 0;
+	size_t write_limit = SIZE_MAX;
+};
+} // namespace
+
+TEST_CASE("SD writer: Buffered data is written in order", "[SDFileWriter]")
+{
+	CircularBuffer<char, 8> buffer;
+	fake_file file;
+
+	// Wrap around the end of the storage
+	buffer.put("abcdef", 6);
+	buffer.consume(4);
+	buffer.put("ghij", 4);
+
+	CHECK(true == log_write_buffer(file, buffer, buffer.size()));
+	CHECK(file.contents == "efghij");
+	CHECK(2 == file.writes);
+	CHECK(true == buffer.empty());
+}
+
+TEST_CASE("SD writer: Only whole sectors are written from a pre-allocated file",
+		  "[SDFileWriter]")
+{
+	CircularBuffer<char, 2 * log_sd_sector_size> buffer;
+	fake_file file;
+	std::string data(log_sd_sector_size + 100, 'x');
+
+	buffer.put(data.data(), data.size());
+	size_t count = buffer.size() - buffer.size() % log_sd_sector_size;
+
+	CHECK(true == log_write_buffer(file, buffer, count));
+	CHECK(log_sd_sector_size == file.contents.size());
+	CHECK(100 == buffer.size());
+
+	// The partial sector is written for a sync, but kept for the next whole-sector write
+	CHECK(true == log_write_partial_sector(file, buffer));
+	CHECK(log_sd_sector_size + 100 == file.contents.size());
+	CHECK(log_sd_sector_size == file.position);
+	CHECK(100 == buffer.size());
+
+	data = std::string(log_sd_sector_size - 100, 'y');
+	buffer.put(data.data(), data.size());
+	CHECK(true == log_write_buffer(file, buffer, buffer.size()));
+	CHECK(2 * log_sd_sector_size == file.contents.size());
+	CHECK(file.contents.substr(log_sd_sector_size, 100) == std::string(100, 'x'));
+	CHECK(true == buffer.empty());
+}
+
+TEST_CASE("SD writer: A failed write keeps the unwritten data", "[SDFileWriter]")
+{
+	CircularBuffer<char, 16> buffer;
+	fake_file file;
+
+	buffer.put("0123456789", 10);
+	file.write_limit = 4;
+
+	CHECK(false == log_write_buffer(file, buffer, buffer.size()));
+	CHECK(file.contents == "0123");
+	CHECK(6 == buffer.size());
+	CHECK('4' == buffer.get());
+}
+
+TEST_CASE("SD writer: A failed partial sector write restores the position", "[SDFileWriter]")
+{
+	CircularBuffer<char, 16> buffer;
+	fake_file file;
+
+	buffer.put("0123456789", 10);
+	file.write_limit = 4;
+
+	CHECK(false == log_write_partial_sector(file, buffer));
+	CHECK(0 == file.position);
+	CHECK(10 == buffer.size());
+}
+
+TEST_CASE("Slot buffer: Full slots are handed off", "[SlotBuffer]")
+{
+	SlotBuffer<char, 4, 2> buffer;
+	SlotBuffer<char, 4, 2>::span first, second;
+
+	CHECK(3 == buffer.put("abc", 3));
+	CHECK(false == buffer.ready());
+
+	CHECK(3 == buffer.put("def", 3));
+	CHECK(true == buffer.ready());
+	CHECK(6 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "abcd");
+	CHECK(std::string(second.data, second.size) == "ef");
+
+	// Every slot is full: new data is not added, and old data is not overwritten
+	CHECK(2 == buffer.put("ghijk", 5));
+	CHECK(true == buffer.full());
+	CHECK(0 == buffer.available());
+	CHECK(0 == buffer.put("k", 1));
+
+	// Writing out the oldest slot frees it for new data, without moving the data in the
+	// other slot
+	const char* active = second.data;
+	buffer.consume(4);
+	CHECK(4 == buffer.available());
+	CHECK(4 == buffer.peek_spans(first, second));
+	CHECK(active == first.data);
+	CHECK(std::string(first.data, first.size) == "efgh");
+
+	CHECK(2 == buffer.put("ij", 2));
+	buffer.consume(4);
+	CHECK(false == buffer.ready());
+	CHECK(2 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "ij");
+}
+
+TEST_CASE("Slot buffer: Consumed space is reused once the slot is free", "[SlotBuffer]")
+{
+	SlotBuffer<char, 8, 2> buffer;
+
+	buffer.put("0123456789", 10);
+	buffer.consume(4);
+	CHECK(6 == buffer.size());
+	CHECK(6 == buffer.available());
+
+	buffer.consume(4);
+	CHECK(2 == buffer.size());
+	CHECK(14 == buffer.available());
+}
+
+TEST_CASE("Slot buffer: A full slot holding all of the data is compacted", "[SlotBuffer]")
+{
+	SlotBuffer<char, 8, 1> buffer;
+	SlotBuffer<char, 8, 1>::span first, second;
+
+	buffer.put("abcdef", 6);
+	buffer.consume(4);
+	CHECK(6 == buffer.available());
+
+	CHECK(6 == buffer.put("ghijkl", 6));
+	CHECK(true == buffer.full());
+	CHECK(8 == buffer.peek_spans(first, second));
+	CHECK(std::string(first.data, first.size) == "efghijkl");
+}
+
+TEST_CASE("SD writer: Every slot of a slot buffer is written in order", "[SDFileWriter]")
+{
+	SlotBuffer<char, 4, 4> buffer;
+	fake_file file;
+
+	buffer.put("0123456789ab", 12);
+	buffer.consume(2);
+	buffer.put("cdef", 4);
+
+	CHECK(true == log_write_buffer(file, buffer, buffer.size()));
+	CHECK(file.contents == "23456789abcdef");
+	CHECK(4 == file.writes);
+	CHECK(true == buffer.empty());
+}
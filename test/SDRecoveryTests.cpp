@@ -0,0 +1,138 @@
+#include <catch.hpp>
+#include <internal/circular_buffer.hpp>
+#include <internal/sd_file_writer.hpp>
+#include <internal/sd_recovery.hpp>
+#include <string>
+#include <vector>
+
+namespace
+{
+/// Minimal stand-in for an SdFat file, which fails once its write limit is reached
+class fake_file
+{
+  public:
+	int write(const void* data, size_t len)
+	{
+		size_t n = (len < write_limit) ? len : write_limit;
+		write_limit -= n;
+		contents.append(static_cast<const char*>(data), n);
+		return static_cast<int>(n);
+	}
+
+	std::string contents;
+	size_t write_limit = SIZE_MAX;
+};
+
+std::string drain(CircularBuffer<char, LOG_SD_FALLBACK_SIZE>& buffer)
+{
+	std::string data;
+
+	while(!buffer.empty())
+	{
+		data += buffer.get();
+	}
+
+	return data;
+}
+} // namespace
+
+TEST_CASE("SD recovery: A failed operation is retried with a growing delay", "[SDRecovery]")
+{
+	std::vector<uint32_t> waits;
+	auto wait = [&](uint32_t ms) { waits.push_back(ms); };
+	unsigned attempts = 0;
+
+	CHECK(true == log_sd_retry([&]() { return ++attempts == 2; }, wait));
+	CHECK(2 == attempts);
+	CHECK(waits == std::vector<uint32_t>{LOG_SD_RETRY_DELAY_MS});
+
+	attempts = 0;
+	waits.clear();
+
+	CHECK(false == log_sd_retry([&]() { return ++attempts == 0; }, wait));
+	CHECK(LOG_SD_RETRY_ATTEMPTS == attempts);
+	REQUIRE(LOG_SD_RETRY_ATTEMPTS - 1 == waits.size());
+
+	for(size_t i = 1; i < waits.size(); i++)
+	{
+		CHECK(waits[i] == 2 * waits[i - 1]);
+	}
+}
+
+TEST_CASE("SD recovery: Recovery attempts back off", "[SDRecovery]")
+{
+	log_sd_recovery<> recovery;
+
+	CHECK(true == recovery.available());
+	CHECK(false == recovery.due(0));
+
+	recovery.failed(100);
+	CHECK(false == recovery.available());
+	CHECK(false == recovery.due(100 + LOG_SD_RECOVERY_INTERVAL_MS - 1));
+	CHECK(true == recovery.due(100 + LOG_SD_RECOVERY_INTERVAL_MS));
+
+	// A failed attempt doubles the interval
+	recovery.failed(2000);
+	CHECK(false == recovery.due(2000 + 2 * LOG_SD_RECOVERY_INTERVAL_MS - 1));
+	CHECK(true == recovery.due(2000 + 2 * LOG_SD_RECOVERY_INTERVAL_MS));
+
+	// Up to the maximum interval
+	for(int i = 0; i < 16; i++)
+	{
+		recovery.failed(0);
+	}
+
+	CHECK(false == recovery.due(LOG_SD_RECOVERY_MAX_INTERVAL_MS - 1));
+	CHECK(true == recovery.due(LOG_SD_RECOVERY_MAX_INTERVAL_MS));
+
+	// The next failure starts over at the first interval
+	recovery.recovered();
+	CHECK(true == recovery.available());
+	recovery.failed(0);
+	CHECK(true == recovery.due(LOG_SD_RECOVERY_INTERVAL_MS));
+}
+
+TEST_CASE("SD recovery: Held data keeps the newest bytes", "[SDRecovery]")
+{
+	log_sd_recovery<> recovery;
+	CircularBuffer<char, LOG_SD_FALLBACK_SIZE> buffer;
+	std::string first(LOG_SD_FALLBACK_SIZE - 10, 'a');
+	std::string second(30, 'b');
+
+	buffer.put(first.data(), first.size());
+	CHECK(0 == recovery.hold(buffer));
+	CHECK(true == buffer.empty());
+
+	buffer.put(second.data(), second.size());
+	CHECK(20 == recovery.hold(buffer));
+	CHECK(drain(recovery.fallback()) == first.substr(20) + second);
+}
+
+TEST_CASE("SD recovery: Held data is written before new data", "[SDRecovery]")
+{
+	log_sd_recovery<> recovery;
+	CircularBuffer<char, 64> buffer;
+	fake_file file;
+
+	buffer.put("held ", 5);
+	recovery.hold(buffer);
+	buffer.put("new", 3);
+
+	// A partial write is retried from where it stopped
+	file.write_limit = 2;
+	auto& fallback = recovery.fallback();
+	unsigned attempts = 0;
+	auto replay = [&]() {
+		attempts++;
+		file.write_limit += 2;
+		return log_write_buffer(file, fallback, fallback.size());
+	};
+
+	CHECK(true == log_sd_retry(replay, [](uint32_t) {}));
+	CHECK(2 == attempts);
+	CHECK(true == fallback.empty());
+
+	file.write_limit = SIZE_MAX;
+	CHECK(true == log_write_buffer(file, buffer, buffer.size()));
+	CHECK(file.contents == "held new");
+}
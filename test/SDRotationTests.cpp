@@ -0,0 +1,108 @@
+#include <catch.hpp>
+#include <internal/sd_rotation.hpp>
+
+namespace
+{
+/// Minimal stand-in for the Arduino EEPROM class
+struct fake_eeprom
+{
+	fake_eeprom()
+	{
+		for(auto& byte : bytes)
+		{
+			byte = 0xFF;
+		}
+	}
+
+	uint8_t read(int address) const
+	{
+		return bytes[address];
+	}
+
+	void write(int address, uint8_t value)
+	{
+		bytes[address] = value;
+	}
+
+	uint8_t bytes[4096];
+};
+} // namespace
+
+TEST_CASE("SD rotation: File numbers wrap around", "[SDRotation]")
+{
+	CHECK(2 == log_next_file_number(1));
+	CHECK(1 == log_next_file_number(log_file_number_max));
+
+	CHECK(6 == log_previous_file_number(10, 4));
+	CHECK(log_file_number_max == log_previous_file_number(1, 1));
+	CHECK(log_file_number_max - 2 == log_previous_file_number(2, 4));
+}
+
+TEST_CASE("SD rotation: The file counter is stored in two EEPROM bytes", "[SDRotation]")
+{
+	fake_eeprom eeprom;
+
+	// An erased counter starts at 1
+	CHECK(1 == log_read_file_counter(eeprom, 4095));
+
+	log_write_file_counter(eeprom, 4095, 300);
+	CHECK(0x01 == eeprom.bytes[4094]);
+	CHECK(0x2C == eeprom.bytes[4095]);
+	CHECK(300 == log_read_file_counter(eeprom, 4095));
+
+	// Out of range values start over
+	log_write_file_counter(eeprom, 4095, 0);
+	CHECK(1 == log_read_file_counter(eeprom, 4095));
+	log_write_file_counter(eeprom, 4095, log_file_number_max + 1);
+	CHECK(1 == log_read_file_counter(eeprom, 4095));
+}
+
+TEST_CASE("SD rotation: An 8-bit counter from older versions is kept", "[SDRotation]")
+{
+	fake_eeprom eeprom;
+
+	eeprom.bytes[4095] = 42;
+	CHECK(42 == log_read_file_counter(eeprom, 4095));
+
+	// The counter continues past 255 once it is stored in two bytes
+	log_write_file_counter(eeprom, 4095, 256);
+	CHECK(256 == log_read_file_counter(eeprom, 4095));
+}
+
+TEST_CASE("SD rotation: The counter steps past 255", "[SDRotation]")
+{
+	fake_eeprom eeprom;
+	uint16_t number = 254;
+
+	log_write_file_counter(eeprom, 4095, number);
+
+	for(uint16_t expected = 254; expected <= 256; expected++)
+	{
+		number = log_read_file_counter(eeprom, 4095);
+		CHECK(expected == number);
+		log_write_file_counter(eeprom, 4095, log_next_file_number(number));
+	}
+
+	CHECK(257 == log_read_file_counter(eeprom, 4095));
+}
+
+TEST_CASE("SD rotation: Files rotate by size or age", "[SDRotation]")
+{
+	log_rotation_tracker tracker;
+	log_rotation_policy policy;
+
+	// Disabled by default
+	CHECK(false == tracker.due(UINT32_MAX, UINT32_MAX));
+
+	policy.max_size = 4096;
+	tracker.policy(policy);
+	CHECK(false == tracker.due(4095, 0));
+	CHECK(true == tracker.due(4096, 0));
+
+	policy.max_size = 0;
+	policy.max_age_ms = 1000;
+	tracker.policy(policy);
+	tracker.opened(UINT32_MAX - 100);
+	CHECK(false == tracker.due(0, UINT32_MAX));
+	CHECK(true == tracker.due(0, 899)); // millis() wrapped around
+}
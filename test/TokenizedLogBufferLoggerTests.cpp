@@ -0,0 +1,140 @@
+#include <TokenizedLogBufferLogger.h>
+#include <catch.hpp>
+#include <cstring>
+#include <string>
+#include <test_helper.hpp>
+
+// Known FNV-1a values, which tools/tokenized_log.py must match
+static_assert(log_token("") == 2166136261u, "Unexpected token for empty string");
+static_assert(log_token("a") == 0xe40c292cu, "Unexpected token for \"a\"");
+static_assert(log_token("foobar") == 0xbf9cf968u, "Unexpected token for \"foobar\"");
+
+using TestLogger = TokenizedLogBufferLogger<1024>;
+
+static uint32_t read_u32(const std::string& str, size_t offset)
+{
+	uint32_t value;
+	memcpy(&value, &str[offset], sizeof(value));
+	return value;
+}
+
+TEST_CASE("Tokenized: Create a logger", "[TokenizedLogBufferLogger]")
+{
+	TestLogger logger;
+
+	CHECK(0 == logger.size());
+	CHECK(1024 == logger.capacity());
+	CHECK(true == logger.enabled());
+	CHECK(false == logger.echo());
+	CHECK(LOG_LEVEL_LIMIT() == logger.level());
+}
+
+TEST_CASE("Tokenized: Record layout", "[TokenizedLogBufferLogger]")
+{
+	TestLogger logger;
+	log_buffer_output.clear();
+
+	logger.log_tokenized(log_level_e::warning, LOG_TOKEN("%d %s\n"), "%d %s\n", -2, "ab");
+	// Header, int argument, string argument
+	constexpr size_t expected_size = TestLogger::RECORD_HEADER_SIZE + (1 + sizeof(int)) + (3 + 2);
+	CHECK(expected_size == logger.size());
+
+	logger.flush();
+	REQUIRE(expected_size == log_buffer_output.size());
+	CHECK(TestLogger::RECORD_SYNC == static_cast<uint8_t>(log_buffer_output[0]));
+	CHECK(expected_size == static_cast<uint8_t>(log_buffer_output[1]));
+	CHECK(log_level_e::warning == static_cast<uint8_t>(log_buffer_output[2]));
+	CHECK(log_token("%d %s\n") == read_u32(log_buffer_output, 3));
+	// LOG_TIMESTAMP() is 0 on the host
+	CHECK(0 == read_u32(log_buffer_output, 7));
+
+	const char* args = &log_buffer_output[TestLogger::RECORD_HEADER_SIZE];
+	CHECK(log_args::make_tag(log_args::kind_signed, sizeof(int)) == static_cast<uint8_t>(args[0]));
+	int value;
+	memcpy(&value, &args[1], sizeof(value));
+	CHECK(-2 == value);
+	args += 1 + sizeof(int);
+	CHECK(log_args::make_tag(log_args::kind_string, 0) == static_cast<uint8_t>(args[0]));
+	CHECK(2 == args[1]);
+	CHECK(std::string("ab") == &args[2]);
+}
+
+TEST_CASE("Tokenized: Null strings are marked in the tag", "[TokenizedLogBufferLogger]")
+{
+	TestLogger logger;
+	log_buffer_output.clear();
+
+	const char* null_string = nullptr;
+	logger.log_tokenized(log_level_e::info, LOG_TOKEN("%s\n"), "%s\n", null_string);
+	logger.flush();
+
+	const char* args = &log_buffer_output[TestLogger::RECORD_HEADER_SIZE];
+	CHECK(log_args::make_tag(log_args::kind_string, log_args::string_arg::null_flag) ==
+		  static_cast<uint8_t>(args[0]));
+	CHECK(0 == args[1]);
+}
+
+TEST_CASE("Tokenized: Run-time tokens match compile-time tokens", "[TokenizedLogBufferLogger]")
+{
+	TestLogger logger;
+	log_buffer_output.clear();
+
+	logger.info("Value: %u\n", 5u);
+	logger.print("raw\n");
+	logger.flush();
+
+	CHECK(LOG_TOKEN("Value: %u\n") == read_u32(log_buffer_output, 3));
+
+	size_t second = static_cast<uint8_t>(log_buffer_output[1]);
+	CHECK(log_level_e::off == static_cast<uint8_t>(log_buffer_output[second + 2]));
+	CHECK(LOG_TOKEN("raw\n") == read_u32(log_buffer_output, second + 3));
+}
+
+TEST_CASE("Tokenized: Interrupt records keep their token and order", "[TokenizedLogBufferLogger]")
+{
+	TestLogger logger;
+	log_buffer_output.clear();
+
+	logger.info("first\n");
+	logger.warning_interrupt("interrupt %d\n", 7);
+	logger.info("second\n");
+	logger.flush();
+
+	size_t second = static_cast<uint8_t>(log_buffer_output[1]);
+	size_t third = second + static_cast<uint8_t>(log_buffer_output[second + 1]);
+	CHECK(LOG_TOKEN("first\n") == read_u32(log_buffer_output, 3));
+	CHECK(log_level_e::warning == static_cast<uint8_t>(log_buffer_output[second + 2]));
+	CHECK(LOG_TOKEN("interrupt %d\n") == read_u32(log_buffer_output, second + 3));
+	CHECK(LOG_TOKEN("second\n") == read_u32(log_buffer_output, third + 3));
+}
+
+TEST_CASE("Tokenized: Full buffer drops the newest record", "[TokenizedLogBufferLogger]")
+{
+	TokenizedLogBufferLogger<32> logger;
+	log_buffer_output.clear();
+
+	// Each record is 16 bytes
+	logger.error("first %d", 1);
+	logger.error("second %d", 2);
+	CHECK(32 == logger.size());
+	logger.error("third %d", 3);
+	CHECK(32 == logger.size());
+	CHECK(logger.has_overrun());
+
+	logger.clear();
+	CHECK(0 == logger.size());
+}
+
+TEST_CASE("Tokenized: Auto-flush makes room for the next record", "[TokenizedLogBufferLogger]")
+{
+	TokenizedLogBufferLogger<32> logger;
+	logger.auto_flush(true);
+	log_buffer_output.clear();
+
+	logger.error("first %d", 1);
+	logger.error("second %d", 2);
+	logger.error("third %d", 3);
+	CHECK(false == logger.has_overrun());
+	CHECK(32 == log_buffer_output.size());
+	CHECK(16 == logger.size());
+}
@@ -0,0 +1,2 @@
+#include "Arduino.h"
+#include "../../examples/RetainedLogBuffer/RetainedLogBuffer.ino"
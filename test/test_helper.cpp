@@ -2,8 +2,14 @@
 #include "printf.h"
 
 std::string log_buffer_output;
+void (*putchar_hook)() = nullptr;
 
 void _putchar(char character)
 {
 	log_buffer_output += character;
+
+	if(putchar_hook)
+	{
+		putchar_hook();
+	}
 }
@@ -14,4 +14,7 @@ static inline std::string construct_log_string(log_level_e level, const char* st
 
 extern std::string log_buffer_output;
 
+/// Called by _putchar() after each character, if set (e.g., to simulate an interrupt)
+extern void (*putchar_hook)();
+
 #endif
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Host-side decompressor for compressed SD log files.
+
+Decompress a log file written with LOG_SD_COMPRESSION enabled:
+
+    lz_log.py log_3.lz > log_3.txt
+
+The format is described in src/internal/log_compression.hpp: a 4-byte header ("LZL" and
+the window/length bit counts), followed by one block per flush. Each block is a 16-bit
+little-endian payload size and an LZSS bit stream. The window carries over between blocks.
+If the file ends in the middle of a block (e.g., power was lost during a write), the data
+decoded up to that point is output and a warning is printed.
+"""
+
+import argparse
+import sys
+
+MAGIC = b"LZL"
+HEADER_SIZE = 4
+BLOCK_HEADER_SIZE = 2
+
+
+class FormatError(Exception):
+    pass
+
+
+def decompress(data):
+    """Decompress a whole stream, returning (output bytes, error message or None)"""
+    if len(data) < HEADER_SIZE or data[:3] != MAGIC:
+        raise FormatError("not a compressed log file")
+
+    window_bits = data[3] >> 4
+    length_bits = data[3] & 0x0F
+    if not 4 <= window_bits <= 15 or not 2 <= length_bits <= 8:
+        raise FormatError("unsupported parameters 0x%02x" % data[3])
+
+    min_match = (1 + window_bits + length_bits) // 9 + 1
+    out = bytearray()
+    pos = HEADER_SIZE
+
+    while pos < len(data):
+        if len(data) - pos < BLOCK_HEADER_SIZE:
+            return out, "truncated block header at offset %d" % pos
+
+        payload = data[pos] | (data[pos + 1] << 8)
+        pos += BLOCK_HEADER_SIZE
+
+        if payload > len(data) - pos:
+            return out, "truncated block at offset %d" % (pos - BLOCK_HEADER_SIZE)
+
+        bits = int.from_bytes(data[pos:pos + payload], "big")
+        remaining = payload * 8
+        pos += payload
+
+        def take(count):
+            nonlocal remaining
+            remaining -= count
+            return (bits >> remaining) & ((1 << count) - 1)
+
+        while remaining >= 9:
+            if take(1):
+                out.append(take(8))
+                continue
+
+            if remaining < window_bits + length_bits:
+                return out, "truncated token at offset %d" % pos
+
+            distance = take(window_bits) + 1
+            length = take(length_bits) + min_match
+
+            if distance > min(len(out), 1 << window_bits):
+                return out, "invalid back-reference at offset %d" % pos
+
+            # Copy one byte at a time, since the reference may overlap the output
+            for _ in range(length):
+                out.append(out[-distance])
+
+    return out, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", help="compressed log file (default: stdin)")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    if args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    try:
+        out, error = decompress(data)
+    except FormatError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(out)
+    else:
+        sys.stdout.buffer.write(out)
+
+    if error:
+        print("warning: %s" % error, file=sys.stderr)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
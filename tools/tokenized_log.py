@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""Host-side support for TokenizedLogBufferLogger.
+
+Generate a token dictionary from the program's sources:
+
+    tokenized_log.py dictionary -o tokens.json src/*.cpp src/*.h
+
+Decode a captured log stream (serial capture, file, or stdin):
+
+    tokenized_log.py decode -d tokens.json capture.bin
+
+Tokens are the 32-bit FNV-1a hash of the format string, matching log_token() in
+ArduinoLogger.h. The dictionary is built from every string literal in the supplied sources
+(adjacent literals are joined, as the compiler does), so it must be regenerated when the
+format strings change.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+RECORD_SYNC = 0x1E
+RECORD_HEADER_SIZE = 11
+
+KIND_SIGNED = 1
+KIND_UNSIGNED = 2
+KIND_FLOAT = 3
+KIND_STRING = 4
+KIND_POINTER = 5
+# Set in the size of a string argument's tag for a null string
+STRING_NULL_FLAG = 1
+
+LEVEL_PREFIX = {
+    1: "<!> ",
+    2: "<E> ",
+    3: "<W> ",
+    4: "<I> ",
+    5: "<D> ",
+}
+
+STRING_LITERAL = re.compile(r'(?:u8|u|U|L)?"((?:[^"\\\n]|\\.)*)"')
+CONVERSION = re.compile(
+    r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diuxXoscpfFeEgG%])")
+ESCAPES = {
+    "n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\", '"': '"', "'": "'",
+    "a": "\a", "b": "\b", "f": "\f", "v": "\v", "?": "?",
+}
+
+
+def fnv1a(data):
+    token = 2166136261
+    for byte in data:
+        token = ((token ^ byte) * 16777619) & 0xFFFFFFFF
+    return token
+
+
+def unescape(literal):
+    out = []
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        if c != "\\":
+            out.append(c)
+            i += 1
+            continue
+        i += 1
+        c = literal[i]
+        if c == "x":
+            m = re.match(r"[0-9a-fA-F]+", literal[i + 1:])
+            out.append(chr(int(m.group(0), 16) & 0xFF))
+            i += 1 + len(m.group(0))
+        elif c in "01234567":
+            m = re.match(r"[0-7]{1,3}", literal[i:])
+            out.append(chr(int(m.group(0), 8) & 0xFF))
+            i += len(m.group(0))
+        else:
+            out.append(ESCAPES.get(c, c))
+            i += 1
+    return "".join(out)
+
+
+def strip_comments(source):
+    # Keeps string literals intact while removing // and /* */ comments
+    pattern = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)*\'',
+                         re.DOTALL)
+    return pattern.sub(lambda m: " " if m.group(0).startswith("/") else m.group(0), source)
+
+
+def format_strings(source):
+    source = strip_comments(source)
+    pending = None
+    last_end = 0
+    for m in STRING_LITERAL.finditer(source):
+        if pending is not None and source[last_end:m.start()].strip() == "":
+            pending += unescape(m.group(1))
+        else:
+            if pending is not None:
+                yield pending
+            pending = unescape(m.group(1))
+        last_end = m.end()
+    if pending is not None:
+        yield pending
+
+
+def build_dictionary(paths):
+    dictionary = {}
+    for path in paths:
+        # latin-1 maps each source byte to one character, so we hash the same bytes as
+        # the compiler does
+        with open(path, encoding="latin-1") as f:
+            for fmt in format_strings(f.read()):
+                token = "0x%08x" % fnv1a(fmt.encode("latin-1"))
+                if dictionary.get(token, fmt) != fmt:
+                    print("warning: token collision for %r and %r" % (dictionary[token], fmt),
+                          file=sys.stderr)
+                dictionary[token] = fmt
+    return dictionary
+
+
+def decode_args(data):
+    args = []
+    i = 0
+    while i < len(data):
+        tag = data[i]
+        kind, size = tag >> 4, tag & 0xF
+        if kind == KIND_STRING:
+            length = data[i + 1]
+            if size & STRING_NULL_FLAG:
+                args.append("(null)")
+            else:
+                args.append(data[i + 2:i + 2 + length].decode("utf-8", errors="replace"))
+            i += 3 + length
+            continue
+        raw = data[i + 1:i + 1 + size]
+        if kind == KIND_FLOAT:
+            args.append(struct.unpack("<d" if size == 8 else "<f", raw)[0])
+        else:
+            args.append(int.from_bytes(raw, "little", signed=(kind == KIND_SIGNED)))
+        i += 1 + size
+    return args
+
+
+def render(fmt, args):
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else 0
+
+    def convert(m):
+        flags, width, precision, _, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            width = str(take())
+        if precision == "*":
+            precision = str(take())
+        spec = "%" + flags + (width or "") + ("." + precision if precision else "")
+        value = take()
+        if conv == "p":
+            return (spec + "s") % ("0x%x" % value)
+        if conv in "diuxXoc":
+            if isinstance(value, str):
+                return (spec + "s") % value
+            value = int(value)
+            if conv in "xXo" and value < 0:
+                value &= 0xFFFFFFFFFFFFFFFF
+            return (spec + ("d" if conv in "iu" else conv)) % value
+        if conv == "s":
+            return (spec + "s") % value
+        return (spec + conv) % float(value)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, dictionary, out):
+    i = 0
+    while i + RECORD_HEADER_SIZE <= len(stream):
+        if stream[i] != RECORD_SYNC:
+            i += 1
+            continue
+        length = stream[i + 1]
+        if length < RECORD_HEADER_SIZE or i + length > len(stream):
+            i += 1
+            continue
+        level, token, timestamp = struct.unpack_from("<BII", stream, i + 2)
+        args = decode_args(stream[i + RECORD_HEADER_SIZE:i + length])
+        fmt = dictionary.get("0x%08x" % token)
+        if fmt is None:
+            message = "<unknown token 0x%08x> %r\n" % (token, args)
+        else:
+            message = render(fmt.encode("latin-1").decode("utf-8", errors="replace"), args)
+        if level in LEVEL_PREFIX:
+            message = "%s[%u ms] %s" % (LEVEL_PREFIX[level], timestamp, message)
+        out.write(message)
+        i += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    dictionary = commands.add_parser("dictionary", help="generate a token dictionary")
+    dictionary.add_argument("sources", nargs="+", help="source files to scan")
+    dictionary.add_argument("-o", "--output", help="output file (default: stdout)")
+
+    decoder = commands.add_parser("decode", help="decode a tokenized log stream")
+    decoder.add_argument("-d", "--dictionary", required=True, help="token dictionary")
+    decoder.add_argument("input", nargs="?", help="captured log (default: stdin)")
+
+    args = parser.parse_args()
+
+    if args.command == "dictionary":
+        text = json.dumps(build_dictionary(args.sources), indent=2, sort_keys=True)
+        if args.output:
+            with open(args.output, "w", encoding="utf-8") as f:
+                f.write(text + "\n")
+        else:
+            print(text)
+        return
+
+    with open(args.dictionary, encoding="utf-8") as f:
+        tokens = json.load(f)
+    if args.input:
+        with open(args.input, "rb") as f:
+            stream = f.read()
+    else:
+        stream = sys.stdin.buffer.read()
+    decode(stream, tokens, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()